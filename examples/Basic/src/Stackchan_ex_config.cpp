@@ -1,48 +1,59 @@
 
 #include "Stackchan_ex_config.h"
 
+// app_parameters1の項目の表(キーのパス, 型, ex_config_sの中の位置, 初期値, 範囲)
+static constexpr config_field_s ex_config_fields[] = {
+    CONFIG_STRING_FIELD("app_parameters1.item1", CONFIG_REQUIRED, ex_config_s, item1, ""),   // 文字列
+    CONFIG_FIELD("app_parameters1.item2", CONFIG_INT32, 0, ex_config_s, item2, 0, 0, 0),     // 数値(範囲を指定しない場合は0, 0)
+    CONFIG_FIELD("app_parameters1.item3", CONFIG_BOOL, 0, ex_config_s, item3, 0, 0, 0),      // True/False/0/1
+};
+static const config_schema_table_s ex_config_table = CONFIG_TABLE(ex_config_fields);
+
 StackchanExConfig::StackchanExConfig() {};
 StackchanExConfig::~StackchanExConfig() {};
 
 void StackchanExConfig::loadExtendConfig(fs::FS& fs, const char *yaml_filename, uint32_t yaml_size) {
     M5_LOGI("----- StackchanExConfig::loadConfig:%s\n", yaml_filename);
-    File file = fs.open(yaml_filename);
-    if (file) {
-        DynamicJsonDocument doc(yaml_size);
-        auto err = deserializeYml( doc, file);
-        if (err) {
-            M5_LOGE("yaml file read error: %s\n", yaml_filename);
-            M5_LOGE("error%s\n", err.c_str());
-        }
-        serializeJsonPretty(doc, Serial);
-        setExtendSettings(doc);
+    // StackchanSystemConfigの設定ファイルと同じ領域に読み込みます。
+    const JsonDocument *doc = readConfigFile(fs, yaml_filename);
+    if (doc != nullptr) {
+        serializeJsonPretty(*doc, Serial);
+        setExtendSettings(*doc);
     }
 }
 
-void StackchanExConfig::setExtendSettings(DynamicJsonDocument doc) {
-    JsonObject app_param1 = doc["app_parameters1"];
-    _ex_parameters.item1 = doc["app_parameters1"]["item1"].as<String>();            // 文字列はこのように記述
-    _ex_parameters.item2 = app_param1["item2"];                          // 数値
-    _ex_parameters.item3 = app_param1["item3"].as<bool>();              // True/False/0/1 
-    JsonObject app_param2 = doc["app_parameters2"];
+void StackchanExConfig::setExtendSettings(const JsonDocument& doc) {
+    StackchanConfigSchema::load(doc.as<JsonVariantConst>(), &ex_config_table, &_ex_parameters);
+    JsonObjectConst app_param2 = doc["app_parameters2"];
     _item4 = app_param2["item4"].as<String>();
-    JsonArray list_str = app_param2["list_str"];
+    JsonArrayConst list_str = app_param2["list_str"];
     _list_str_count = list_str.size();
     for (int i=0; i<_list_str_count; i++) {
         _list_str[i] = list_str[i].as<String>();
     }
-    JsonArray list_num = app_param2["list_num"];
+    JsonArrayConst list_num = app_param2["list_num"];
     _list_num_count = list_num.size();
     for (int i=0; i<_list_num_count; i++) {
         _list_num[i] = list_num[i];
     }
 }
 
+// reloadConfigで拡張設定が変わったか(CONFIG_CHANGE_EXTEND)を判定するためのハッシュ
+uint32_t StackchanExConfig::hashExtendConfig(void) {
+    uint32_t hash = 2166136261u;
+    hash = StackchanConfigCache::checksum(hash, (const uint8_t *)_ex_parameters.item1.c_str(), _ex_parameters.item1.length());
+    hash = StackchanConfigCache::checksum(hash, (const uint8_t *)&_ex_parameters.item2, sizeof(_ex_parameters.item2));
+    hash = StackchanConfigCache::checksum(hash, (const uint8_t *)&_ex_parameters.item3, sizeof(_ex_parameters.item3));
+    hash = StackchanConfigCache::checksum(hash, (const uint8_t *)_item4.c_str(), _item4.length() + 1);
+    for (int i=0; i<_list_str_count; i++) {
+        hash = StackchanConfigCache::checksum(hash, (const uint8_t *)_list_str[i].c_str(), _list_str[i].length() + 1);
+    }
+    hash = StackchanConfigCache::checksum(hash, (const uint8_t *)_list_num, sizeof(int) * _list_num_count);
+    return hash;
+}
 
 void StackchanExConfig::printExtParameters(void) {
-    M5_LOGI("item1:%s", _ex_parameters.item1.c_str());
-    M5_LOGI("item2:%d", _ex_parameters.item2);
-    M5_LOGI("item3:%s", _ex_parameters.item3 ? "true":"false");
+    StackchanConfigSchema::print(&ex_config_table, &_ex_parameters);
     M5_LOGI("item4:%s", _item4.c_str());
     for (int i=0; i<_list_str_count; i++) {
         M5_LOGI("list_str[%d]: %s", i, _list_str[i].c_str());
@@ -26,8 +26,9 @@ class StackchanExConfig : public StackchanSystemConfig
         ~StackchanExConfig();
 
         void loadExtendConfig(fs::FS& fs, const char *yaml_filename, uint32_t yaml_size) override;
-        void setExtendSettings(DynamicJsonDocument doc) override;
+        void setExtendSettings(const JsonDocument& doc) override;
         void printExtParameters(void) override;
+        uint32_t hashExtendConfig(void) override;
         ex_config_s getExConfig() { return _ex_parameters; }
         uint8_t getListStrCount() { return _list_str_count; }
         String getListStr(uint8_t no) { return _list_str[no]; }
@@ -1,8 +1,13 @@
 #include <Arduino.h>
 #include <M5Unified.h>
 #include <SD.h>
+#include <SPIFFS.h>
 #include "Stackchan_ex_config.h"
 #include <Stackchan_servo.h>
+#include <Stackchan_idle_motion.h>
+#include <Stackchan_servo_calibration.h>
+#include <Stackchan_power_governor.h>
+#include <Stackchan_Takao_Base.hpp>
 #include <Avatar.h>
 
 using namespace m5avatar;
@@ -10,28 +15,74 @@ using namespace m5avatar;
 Avatar avatar;
 
 StackchanSERVO servo;
+StackchanIdleMotion idle_motion;
+StackchanPowerGovernor power_governor;
 StackchanExConfig system_config;
 
+#define POWER_CHECK_INTERVAL 5000  // 給電状態を確認する間隔(msec)
+uint32_t last_power_check_millis = 0;
+
+// 設定を読み込み直した場合に、変わった項目だけを反映します。
+// (モードごとの間隔などのポインタは読み込み直すと変わるので、ここで取得し直します。)
+void onConfigChanged(StackchanSystemConfig *config, uint16_t changes, void *user_data) {
+  if (changes & CONFIG_CHANGE_SERVO) {
+    config->applyServoParam(&servo);
+  }
+  if (changes & CONFIG_CHANGE_INTERVAL) {
+    idle_motion.setInterval(AvatarMode::NORMAL, config->getServoInterval(AvatarMode::NORMAL));
+    idle_motion.setInterval(AvatarMode::SINGING, config->getServoInterval(AvatarMode::SINGING));
+  }
+  if (changes & CONFIG_CHANGE_POWER) {
+    power_governor.setConfig(config->getPowerGovernorConfig());
+  }
+}
+
 void setup() {
   auto cfg = M5.config();
   M5.begin(cfg);
   M5.Log.setLogLevel(m5::log_target_display, ESP_LOG_INFO);
   M5.Log.setEnableColor(m5::log_target_serial, false);
   SD.begin(GPIO_NUM_4, SPI, 25000000);
-  delay(2000);
+  // 解析した設定をSPIFFSにキャッシュし、次回からはYAMLが変わっていなければ解析せずに読み込みます。
+  if (SPIFFS.begin(true)) {
+    system_config.setConfigCache(SPIFFS);
+  }
   system_config.loadConfig(SD, "/yaml/SC_BasicConfig.yaml");
   
-  // servo
-  servo.begin(system_config.getServoInfo(AXIS_X)->pin, system_config.getServoInfo(AXIS_X)->start_degree,
-              system_config.getServoInfo(AXIS_X)->offset,
-              system_config.getServoInfo(AXIS_Y)->pin, system_config.getServoInfo(AXIS_Y)->start_degree,
-              system_config.getServoInfo(AXIS_Y)->offset,
-              (ServoType)system_config.getServoType());
-  delay(2000);
+  // servo(追加の軸(servo.extra_axes)を含む)
+  stackchan_servo_initial_param_s servo_param;
+  system_config.getServoInitialParam(&servo_param);
+  servo.begin(servo_param, (ServoType)system_config.getServoType());
+  for (int i = 0; i < system_config.getServoAxisNum(); i++) {
+    servo_initial_param_s* servo_info = system_config.getServoInfo(i);
+    servo.setMotionLimit((ServoAxis)i, servo_info->max_velocity, servo_info->max_acceleration);
+  }
+  M5.update();
+  if (M5.BtnA.isPressed()) {
+    // ボタンAを押しながら起動すると、機構の端を探して可動範囲とX軸のoffsetを求め、SDに保存します。(XL330, SCS)
+    do {
+      servo.tick();
+      delay(SERVO_TICK_INTERVAL);
+    } while (servo.isMoving());
+    StackchanServoCalibration calibration;
+    if (calibration.calibrate(&servo)) {
+      system_config.saveServoCalibration(SD, &calibration);
+    }
+  }
+  // Takao_Baseを使う場合は、給電状態とバッテリー残量に応じてサーボの速度・同時に動かす軸を制限します。
+  power_governor.begin(&servo, system_config.getPowerGovernorConfig());
+  // サーボの初期位置への移動は待たずにAvatarを表示します。(移動はloop()のservo.tick()で管理します。)
   avatar.init();
   
   servo_interval_s* servo_interval = system_config.getServoInterval(AvatarMode::NORMAL); // ノーマルモード時のサーボインターバル情報を取得
   servo_interval_s* servo_interval_sing = system_config.getServoInterval(AvatarMode::SINGING); // 歌っているときのサーボインターバル情報を取得
+  // 待機中の見回し動作(歌っているときはidle_motion.setAvatarMode(AvatarMode::SINGING)で切り替え)
+  idle_motion.begin(&servo, esp_random());
+  idle_motion.setInterval(AvatarMode::NORMAL, servo_interval);
+  idle_motion.setInterval(AvatarMode::SINGING, servo_interval_sing);
+  // ボタンBまたはシリアルから受け取ったSC_BasicConfig.yamlで設定を読み込み直します。
+  system_config.addChangeCallback(onConfigChanged,
+                                  CONFIG_CHANGE_SERVO | CONFIG_CHANGE_INTERVAL | CONFIG_CHANGE_POWER);
 
   // wifi
   wifi_s*     wifi_info = system_config.getWiFiSetting();
@@ -41,4 +92,19 @@ void setup() {
 
 void loop() {
   // put your main code here, to run repeatedly:
+  M5.update();
+  if (M5.BtnB.wasPressed()) {
+    system_config.reloadConfig();
+  }
+  if (Serial.available()) {
+    system_config.reloadConfig(Serial);
+  }
+  if (system_config.getUseTakaoBase() && (millis() - last_power_check_millis >= POWER_CHECK_INTERVAL)) {
+    last_power_check_millis = millis();
+    PowerStatus power_status = checkTakaoBasePowerStatus(&M5.Power);
+    power_governor.update(power_status, M5.Power.getBatteryLevel());
+  }
+  idle_motion.tick(millis());
+  servo.tick();
+  delay(SERVO_TICK_INTERVAL);
 }
@@ -0,0 +1,8 @@
+// ホストでArduinoJson, YAMLDuinoが読み込む<Arduino.h>の代わりに、ライブラリと同じ代替定義(Stackchan_host_arduino.h)を使います。
+// ここに定義を追加せず、足りないものはStackchan_host_arduino.hに追加してください。
+#ifndef _CONFIG_BENCH_ARDUINO_H_
+#define _CONFIG_BENCH_ARDUINO_H_
+
+#include <Stackchan_platform.h>
+
+#endif // _CONFIG_BENCH_ARDUINO_H_
@@ -0,0 +1,272 @@
+// StackchanSystemConfig::loadConfigをメモリ上のファイルシステム(fs::FS)に置いた設定ファイルで実行し、
+// ファイルの大きさごとに解析時間・ヒープの確保回数・最大使用量を表示します。(Linux)
+// data/yamlの設定ファイルと、セリフ・モード・アプリケーションの項目を増やした設定ファイルを使います。
+#include <chrono>
+#include <new>
+#include <fcntl.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <Stackchan_system_config.h>
+
+#define BENCH_ITERATIONS 20
+
+// malloc/freeを置き換えて(-Wl,--wrap)、確保回数と使用量を数えます。
+extern "C" {
+void *__real_malloc(size_t size);
+void __real_free(void *ptr);
+void *__real_calloc(size_t num, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  void *ptr = __real_malloc(size);
+  if (ptr != nullptr) stackchanHostTrackAlloc(malloc_usable_size(ptr));
+  return ptr;
+}
+
+void __wrap_free(void *ptr) {
+  if (ptr != nullptr) stackchanHostTrackFree(malloc_usable_size(ptr));
+  __real_free(ptr);
+}
+
+void *__wrap_calloc(size_t num, size_t size) {
+  void *ptr = __real_calloc(num, size);
+  if (ptr != nullptr) stackchanHostTrackAlloc(malloc_usable_size(ptr));
+  return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  size_t old_size = (ptr != nullptr) ? malloc_usable_size(ptr) : 0;
+  void *new_ptr = __real_realloc(ptr, size);
+  if (new_ptr == nullptr) return nullptr;
+  if (ptr != nullptr) stackchanHostTrackFree(old_size);
+  stackchanHostTrackAlloc(malloc_usable_size(new_ptr));
+  return new_ptr;
+}
+}
+
+void *operator new(size_t size) {
+  void *ptr = malloc(size);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
+
+// 拡張設定(アプリケーションの項目)も同じ領域に読み込み、最上位のキーの数を数えます。
+class BenchConfig : public StackchanSystemConfig {
+  public:
+    size_t ext_key_num = 0;
+    void loadExtendConfig(fs::FS& fs, const char *yaml_filename, uint32_t yaml_size) override {
+      const JsonDocument *doc = readConfigFile(fs, yaml_filename);
+      ext_key_num = (doc != nullptr) ? doc->as<JsonObjectConst>().size() : 0;
+    }
+};
+
+typedef struct BenchCase {
+  const char *name;
+  std::string basic;
+  std::string ext;
+  uint16_t lyrics_num;                           // 読み込めたか確認する値
+  uint8_t mode_num;
+  size_t ext_key_num;
+  bool cacheable;                                // CONFIG_CACHE_MAX_SIZEに収まり、2回目以降はキャッシュから読み込める
+} bench_case_s;
+
+typedef struct BenchResult {
+  double micros;                                 // 1回あたりの時間(us)
+  uint32_t alloc_count;                          // 1回あたりの確保回数
+  size_t peak_heap;                              // 読み込み前からの最大使用量(byte)
+} bench_result_s;
+
+static fs::FS sd;                                // SDの代わり
+static fs::FS spiffs;                            // キャッシュを保存するファイルシステムの代わり
+static int failures = 0;
+
+static std::string readHostFile(const std::string &path) {
+  std::string data;
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (fp == nullptr) {
+    fprintf(stderr, "file not found: %s\n", path.c_str());
+    failures++;
+    return data;
+  }
+  char buffer[1024];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0) data.append(buffer, n);
+  fclose(fp);
+  return data;
+}
+
+static void putFile(fs::FS &fs, const char *path, const std::string &data) {
+  fs::File file = fs.open(path, FILE_WRITE);
+  file.write((const uint8_t *)data.data(), data.size());
+  file.close();
+}
+
+// SC_BasicConfig.yamlと同じ項目で、モード(servo.speed)とセリフ(balloon.lyrics)をscale倍にします。
+static std::string makeBasicConfig(int scale, uint16_t *lyrics_num, uint8_t *mode_num) {
+  std::string yaml =
+    "servo:\n"
+    "  pin:\n    x: 17\n    y: 18\n"
+    "  offset:\n    x: 0\n    y: 0\n"
+    "  center:\n    x: 90\n    y: 90\n"
+    "  lower_limit:\n    x: 0\n    y: 60\n"
+    "  upper_limit:\n    x: 180\n    y: 90\n"
+    "  speed:\n";
+  char line[128];
+  *mode_num = 2 * scale;
+  for (int i = 0; i < *mode_num; i++) {
+    snprintf(line, sizeof(line), "    mode_%d:\n      interval_min: %d\n      interval_max: %d\n"
+             "      move_min: 500\n      move_max: 1500\n", i, 1000 + i, 2000 + i);
+    yaml += line;
+  }
+  yaml += "takao_base: false\nservo_type: \"PWM\"\n"
+          "bluetooth:\n  device_name: \"M5StackBTSPK\"\n  starting_state: false\n  start_volume: 100\n"
+          "auto_power_off_time: 0\n"
+          "balloon:\n  font_language: \"JA\"\n  lyrics:\n";
+  *lyrics_num = 8 * scale;
+  for (int i = 0; i < *lyrics_num; i++) {
+    snprintf(line, sizeof(line), "  - \"I'm Stack-chan %d\"\n", i);
+    yaml += line;
+  }
+  yaml += "led_lr: 0\nled_pin: 15\n";
+  return yaml;
+}
+
+// アプリケーションの項目(app_parameters)をscale個並べた拡張設定
+static std::string makeExtConfig(int scale) {
+  std::string yaml;
+  char line[256];
+  for (int i = 0; i < scale; i++) {
+    snprintf(line, sizeof(line), "app_parameters%d:\n  item1: \"item %d\"\n  item2: %d\n  item3: true\n"
+             "  list_str:\n  - \"a\"\n  - \"b\"\n  - \"c\"\n  list_num: [ 1, -2, 3, -4 ]\n", i, i, i * 1000);
+    yaml += line;
+  }
+  return yaml;
+}
+
+// loadConfigのログを出さずに計測します。
+static int muteStdout() {
+  fflush(stdout);
+  int saved = dup(STDOUT_FILENO);
+  int null_fd = open("/dev/null", O_WRONLY);
+  dup2(null_fd, STDOUT_FILENO);
+  close(null_fd);
+  return saved;
+}
+
+static void restoreStdout(int saved) {
+  fflush(stdout);
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+}
+
+static void load(BenchConfig *config, const bench_case_s *c) {
+  config->loadConfig(sd, "/yaml/SC_ExtConfig.yaml");
+}
+
+// 1回目(領域の確保を含む)を除いて計測します。
+static bench_result_s measure(BenchConfig *config, const bench_case_s *c) {
+  int saved = muteStdout();
+  load(config, c);
+  const host_heap_stats_s *stats = stackchanHostGetHeapStats();
+  stackchanHostResetHeapPeak();
+  size_t used_before = stats->used;
+  uint32_t alloc_before = stats->alloc_count;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    load(config, c);
+  }
+  auto end = std::chrono::steady_clock::now();
+  restoreStdout(saved);
+  bench_result_s result;
+  result.micros = std::chrono::duration<double, std::micro>(end - start).count() / BENCH_ITERATIONS;
+  result.alloc_count = (stats->alloc_count - alloc_before) / BENCH_ITERATIONS;
+  result.peak_heap = stats->peak - used_before;
+  return result;
+}
+
+static void check(const char *name, const char *item, long value, long expected) {
+  if (value == expected) return;
+  printf("[FAIL] %s %s:%ld expected:%ld\n", name, item, value, expected);
+  failures++;
+}
+
+static void verify(BenchConfig *config, const bench_case_s *c) {
+  check(c->name, "lyrics_num", config->getLyrics_num(), c->lyrics_num);
+  check(c->name, "mode_num", config->getServoIntervals().size, c->mode_num);
+  check(c->name, "ext_key_num", config->ext_key_num, c->ext_key_num);
+  check(c->name, "servo.pin.x", config->getServoInfo(AXIS_X)->pin, 17);
+  check(c->name, "servo.pin.y", config->getServoInfo(AXIS_Y)->pin, 18);
+}
+
+static void runCase(const bench_case_s *c) {
+  putFile(sd, "/yaml/SC_BasicConfig.yaml", c->basic);
+  putFile(sd, "/yaml/SC_ExtConfig.yaml", c->ext);
+  spiffs.remove(SYSTEM_CONFIG_CACHE_FILE);
+
+  BenchConfig parse_config;
+  bench_result_s parse = measure(&parse_config, c);
+  verify(&parse_config, c);
+
+  // 2回目以降はキャッシュから読み込みます。(個人情報と拡張設定は毎回解析します)
+  BenchConfig cache_config;
+  cache_config.setConfigCache(spiffs);
+  bench_result_s cache = measure(&cache_config, c);
+  verify(&cache_config, c);
+  fs::File cache_file = spiffs.open(SYSTEM_CONFIG_CACHE_FILE);
+  size_t cache_size = cache_file.size();
+  bool cache_saved = (bool)cache_file;
+  cache_file.close();
+  // キャッシュを使えない場合、cacheの列は解析の時間になるので失敗にします。
+  // (大きすぎる設定は保存せずに毎回解析することを確認します)
+  if (cache_config.isConfigCacheLoaded() != c->cacheable) {
+    printf("[FAIL] %s cache %s (cache file:%s %u byte, CONFIG_CACHE_MAX_SIZE:%u)\n", c->name,
+           c->cacheable ? "not used" : "used", cache_saved ? "saved" : "none", (unsigned)cache_size,
+           (unsigned)CONFIG_CACHE_MAX_SIZE);
+    failures++;
+  }
+  if (!c->cacheable && cache_saved) {
+    printf("[FAIL] %s cache saved (expected over CONFIG_CACHE_MAX_SIZE)\n", c->name);
+    failures++;
+  }
+
+  printf("%-12s basic:%6u ext:%6u doc peak:%6u | parse:%9.1fus allocs:%5u peak:%7u | ",
+         c->name, (unsigned)c->basic.size(), (unsigned)c->ext.size(), (unsigned)parse_config.getConfigMemoryPeak(),
+         parse.micros, parse.alloc_count, (unsigned)parse.peak_heap);
+  if (c->cacheable) {
+    printf("cache:%6u %9.1fus allocs:%5u peak:%7u\n", (unsigned)cache_size, cache.micros, cache.alloc_count,
+           (unsigned)cache.peak_heap);
+  } else {
+    printf("cache: (over CONFIG_CACHE_MAX_SIZE, not saved)\n");
+  }
+}
+
+int main(int argc, char **argv) {
+  std::string data_dir = (argc > 1) ? argv[1] : "../../data/yaml";
+  putFile(sd, "/yaml/SC_SecConfig.yaml", readHostFile(data_dir + "/SC_SecConfig.yaml"));
+
+  printf("--- StackchanSystemConfig::loadConfig (iterations:%d) ---\n", BENCH_ITERATIONS);
+  // 同梱の設定ファイル(拡張設定のキーはapp_parameters1, app_parameters2)
+  bench_case_s shipped = { "shipped", readHostFile(data_dir + "/SC_BasicConfig.yaml"),
+                           readHostFile(data_dir + "/SC_ExtConfig.yaml"), 8, 2, 2, true };
+  runCase(&shipped);
+  const int scales[] = { 4, 16, 64 };
+  for (int scale : scales) {
+    char name[16];
+    snprintf(name, sizeof(name), "synthetic x%d", scale);
+    bench_case_s c;
+    c.name = name;
+    c.basic = makeBasicConfig(scale, &c.lyrics_num, &c.mode_num);
+    c.ext = makeExtConfig(scale);
+    c.ext_key_num = scale;
+    // x64はセリフ(512個)だけでCONFIG_CACHE_MAX_SIZEを超えます。
+    c.cacheable = (scale <= 16);
+    runCase(&c);
+  }
+  printf("%s\n", (failures == 0) ? "OK" : "FAILED");
+  return (failures == 0) ? 0 : 1;
+}
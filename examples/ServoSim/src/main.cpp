@@ -0,0 +1,295 @@
+// ServoType::SIMでmotion()やmoveXY()を実行し、コマンド数・所要時間・書き込み間隔のばらつきを表示します。
+#include <chrono>
+#include <math.h>
+#include <Stackchan_servo.h>
+#include <Stackchan_servo_sim.h>
+#include <Stackchan_servo_task.h>
+#include <Stackchan_idle_motion.h>
+#include <Stackchan_servo_calibration.h>
+#include <Stackchan_power_governor.h>
+
+StackchanSERVO servo;
+StackchanServoTask servo_task;
+StackchanIdleMotion idle_motion;
+StackchanMotionRecording recording;
+StackchanServoCalibration calibration;
+StackchanPowerGovernor power_governor;
+
+static StackchanServoSIM* getSim() {
+  return (StackchanServoSIM*)servo.getDriver();
+}
+
+// 記録したコマンドから、書き込み間隔の平均と標準偏差(jitter)を表示します。
+static void printReport(const char *name, uint32_t start_micros, double wall_micros) {
+  StackchanServoSIM *sim = getSim();
+  uint32_t num = sim->getLoggedCommandNum();
+  double sum = 0.0, sum2 = 0.0;
+  for (uint32_t i = 1; i < num; i++) {
+    double interval = sim->getCommand(i)->micros - sim->getCommand(i - 1)->micros;
+    sum += interval;
+    sum2 += interval * interval;
+  }
+  double mean = (num > 1) ? sum / (num - 1) : 0.0;
+  double jitter = (num > 1) ? sqrt(sum2 / (num - 1) - mean * mean) : 0.0;
+  printf("%-24s commands:%5u  sim_time:%8.1fms  call:%8.1fus  interval:%7.1fus  jitter:%7.1fus\n",
+         name, sim->getCommandCount(), (micros() - start_micros) / 1000.0, wall_micros, mean, jitter);
+}
+
+template <typename F>
+static void measure(const char *name, F func) {
+  getSim()->clearLog();
+  uint32_t start_micros = micros();
+  auto start = std::chrono::steady_clock::now();
+  func();
+  auto end = std::chrono::steady_clock::now();
+  printReport(name, start_micros, std::chrono::duration<double, std::micro>(end - start).count());
+}
+
+static void runAll(ServoType emulate) {
+  servo.begin(1, 150, 0, 2, 150, 0, ServoType::SIM);
+  getSim()->emulate(emulate);
+  printf("--- emulate ServoType:%d ---\n", emulate);
+
+  // begin()は初期位置への移動を待たずに戻ります。移動の完了はtick()で確認します。
+  measure("startup pose (tick)", [] {
+    do {
+      servo.tick();
+      delay(5);
+    } while (servo.isMoving());
+  });
+  measure("moveXY(1000ms)", [] { servo.moveXY(120, 130, 1000); });
+  measure("moveX/moveY(500ms)", [] { servo.moveX(150, 500); servo.moveY(150, 500); });
+  measure("motion(nod)", [] { servo.motion(nod); });
+  measure("moveXYAsync(1000ms)", [] {
+    servo.moveXYAsync(170, 140, 1000);
+    while (servo.isMoving()) {
+      delay(5);
+      servo.tick();
+    }
+  });
+  measure("moveXYAsync call only", [] { servo.moveXYAsync(150, 150, 1000); });
+  servo.stop();
+  // サーボタスク: ホストではタスクを作らないので、制御周期ごとにprocess()を呼び出します。
+  servo_task.begin(&servo);
+  measure("ServoTask(100Hz)", [] {
+    servo_task.moveXY(120, 130, 1000);
+    do {
+      servo_task.process(millis());
+      delay(SERVO_TASK_INTERVAL);
+    } while (servo_task.isMoving());
+  });
+  // 速度・加速度の上限を設定すると移動時間が延び、台形速度で移動します。
+  servo.setMotionLimit(AXIS_X, 120.0f, 600.0f);
+  servo.setMotionLimit(AXIS_Y, 120.0f, 600.0f);
+  measure("moveXY(limit, 200ms)", [] { servo.moveXY(90, 150, 200); });
+  servo.setMotionLimit(AXIS_X, 0.0f, 0.0f);
+  servo.setMotionLimit(AXIS_Y, 0.0f, 0.0f);
+  if (getSim()->supportsFeedback()) {
+    // 到達確認: Y軸が動かない状態を模擬し、タイムアウトで停止(ストール)を検出します。
+    getSim()->setStall(AXIS_Y, true);
+    measure("moveXY(stall Y)", [] { servo.moveXY(150, 120, 500); });
+    printf("%-24s stalled X:%d Y:%d\n", "", servo.isStalled(AXIS_X), servo.isStalled(AXIS_Y));
+    getSim()->setStall(AXIS_Y, false);
+  }
+  if (getSim()->supportsHealth()) {
+    // 温度などの記録: 停止中に一定間隔で読み出します。Y軸の過熱を模擬して警告を確認します。
+    servo.getHealthLog()->clear();
+    servo.setHealthInterval(500);
+    getSim()->setTemperature(AXIS_Y, 64);
+    uint32_t start = millis();
+    while (millis() - start < 2000) {
+      servo.tick();
+      delay(SERVO_TICK_INTERVAL);
+    }
+    servo.getHealthLog()->dump();
+    printf("%-24s warning X:%d Y:%d\n", "", servo.hasHealthWarning(AXIS_X), servo.hasHealthWarning(AXIS_Y));
+    getSim()->setTemperature(AXIS_Y, SERVO_SIM_TEMPERATURE);
+  }
+}
+
+// 見回し動作: 同じシードなら毎回同じ目標・同じ時刻で動きます。
+static void runIdle() {
+  servo.begin(1, 90, 0, 2, 90, 0, ServoType::SIM);
+  servo.setLimit(AXIS_X, 45, 135);
+  servo.setLimit(AXIS_Y, 60, 90);
+  getSim()->emulate(ServoType::SCS);
+  idle_motion.begin(&servo, 1234);
+  printf("--- idle motion (seed:1234) ---\n");
+  getSim()->clearLog();
+  uint32_t start = millis();
+  while (millis() - start < 30000) {
+    if (millis() - start >= 15000) idle_motion.setAvatarMode(SINGING);
+    idle_motion.tick(millis());
+    servo.tick();
+    delay(SERVO_TICK_INTERVAL);
+  }
+  printf("moves: normal+singing %u, commands: %u, last position X:%.0f Y:%.0f\n", idle_motion.getMoveCount(),
+         getSim()->getCommandCount(), getSim()->getDegree(AXIS_X, micros()), getSim()->getDegree(AXIS_Y, micros()));
+}
+
+// ティーチング: トルクOFFで手で動かした位置(ここでは正弦波)を記録して再生します。
+static float handDegree(ServoAxis axis, uint32_t t) {
+  return (axis == AXIS_X) ? 90.0f + 40.0f * sinf(t * 2.0f * M_PI / 1500.0f) : 75.0f + 10.0f * sinf(t * 2.0f * M_PI / 700.0f);
+}
+
+static void runRecording(ServoType emulate) {
+  servo.begin(1, 90, 0, 2, 75, 0, ServoType::SIM);
+  getSim()->emulate(emulate);
+  printf("--- recording (emulate ServoType:%d) ---\n", emulate);
+  servo.startRecording(&recording);
+  uint32_t start = millis();
+  while (millis() - start < 3000) {
+    getSim()->setHandDegree(AXIS_X, handDegree(AXIS_X, millis() - start));
+    getSim()->setHandDegree(AXIS_Y, handDegree(AXIS_Y, millis() - start));
+    servo.tick();
+    delay(5);
+  }
+  servo.stopRecording();
+  // 復号した値と手で動かした位置の差(記録の分解能は1°)
+  float max_error = 0.0f;
+  int16_t value[2];
+  uint16_t offset = 0;
+  for (uint16_t i = 0; i < recording.getSampleNum(); i++) {
+    offset = recording.readSample(offset, value);
+    for (int axis = AXIS_X; axis <= AXIS_Y; axis++) {
+      max_error = fmaxf(max_error, fabsf(value[axis] - handDegree((ServoAxis)axis, i * recording.getInterval())));
+    }
+  }
+  printf("samples:%u  bytes:%u (%.2f byte/sample)  decode error:%.2fdeg  torque:%d\n", recording.getSampleNum(),
+         recording.getLength(), (float)recording.getLength() / recording.getSampleNum(), max_error, getSim()->getTorque());
+  measure("replay(3000ms)", [] {
+    servo.startReplay(&recording);
+    while (servo.isMoving()) {
+      servo.tick();
+      delay(5);
+    }
+  });
+  printf("%-24s end X:%.1f Y:%.1f (last sample X:%.1f Y:%.1f)\n", "", getSim()->getDegree(AXIS_X, micros()),
+         getSim()->getDegree(AXIS_Y, micros()), (float)value[AXIS_X], (float)value[AXIS_Y]);
+}
+
+// 3軸: X, Yと同じバスの追加の軸(体のロール)をまとめて動かします。1回の送信に3軸分の書き込みが入ります。
+static void runAxes(ServoType emulate) {
+  stackchan_servo_initial_param_s init_param;
+  memset(&init_param, 0, sizeof(init_param));
+  init_param.axis_num = 3;
+  for (int axis = 0; axis < init_param.axis_num; axis++) {
+    init_param.servo[axis].start_degree = 150;
+    init_param.servo[axis].lower_limit  = 0;
+    init_param.servo[axis].upper_limit  = 300;
+    init_param.servo[axis].servo_type   = ServoType::SIM;
+  }
+  init_param.servo[2].lower_limit = 120;
+  init_param.servo[2].upper_limit = 180;
+  servo.begin(init_param, ServoType::SIM);
+  getSim()->emulate(emulate);
+  printf("--- 3 axes (emulate ServoType:%d) ---\n", emulate);
+  do {
+    servo.tick();
+    delay(5);
+  } while (servo.isMoving());
+  measure("moveAxesAsync(3, 1000ms)", [] {
+    const servo_axis_target_s targets[] = { { AXIS_X, 120 }, { AXIS_Y, 170 }, { 2, 200 } };
+    servo.moveAxesAsync(targets, 3, 1000);
+    while (servo.isMoving()) {
+      delay(5);
+      servo.tick();
+    }
+  });
+  uint32_t num = getSim()->getLoggedCommandNum();
+  uint32_t writes = 0;
+  for (uint32_t i = 0; i < num; i++) {
+    writes += getSim()->getCommand(i)->write_num;
+  }
+  printf("%-24s axes/command:%.1f  end X:%.0f Y:%.0f 2:%.0f (limit 180)\n", "", (num > 0) ? (float)writes / num : 0.0f,
+         getSim()->getDegree(AXIS_X, micros()), getSim()->getDegree(AXIS_Y, micros()),
+         getSim()->getDegree((ServoAxis)2, micros()));
+}
+
+// キャリブレーション: 機構の端(X: 40〜270, Y: 120〜200)を模擬し、端から可動範囲とX軸のoffsetを求めます。
+static void runCalibration(ServoType emulate) {
+  servo.begin(1, 150, 0, 2, 150, 0, ServoType::SIM);
+  getSim()->emulate(emulate);
+  getSim()->setMechanicalStop(AXIS_X, 40.0f, 270.0f);
+  getSim()->setMechanicalStop(AXIS_Y, 120.0f, 200.0f);
+  printf("--- calibration (emulate ServoType:%d) ---\n", emulate);
+  measure("calibrate(X, Y)", [] { calibration.calibrate(&servo); });
+  for (int axis = AXIS_X; axis <= AXIS_Y; axis++) {
+    const servo_calibration_s *r = calibration.getResult((ServoAxis)axis);
+    printf("%-24s axis:%d stop:%.1f-%.1f offset:%d limit:%d-%d\n", "", axis, r->lower_stop, r->upper_stop,
+           r->offset, r->lower_limit, r->upper_limit);
+  }
+  // 結果の可動範囲を超える角度を指定しても、端に当たらずに止まります。
+  servo.moveXY(0, 300, 1000);
+  printf("%-24s moveXY(0, 300) X:%.0f Y:%.0f\n", "", getSim()->getDegree(AXIS_X, micros()), getSim()->getDegree(AXIS_Y, micros()));
+}
+
+// 給電状態ごとの制限: X, Y, 追加の軸を少しずつずらして動かし、速度の倍率と電流の上限で移動時間が延びる(遅れる)ことを確認します。
+static void runPowerMove(const char *name, PowerStatus status, int battery_level) {
+  power_governor.update(status, battery_level);
+  measure(name, [] {
+    servo.moveAxisAsync(AXIS_X, 60, 300);
+    servo.tick();
+    servo.moveAxisAsync(AXIS_Y, 60, 300);
+    servo.tick();
+    servo.moveAxisAsync((ServoAxis)2, 60, 300);
+    while (servo.isMoving()) {
+      delay(5);
+      servo.tick();
+    }
+  });
+  // 元の角度へ戻します。
+  const servo_axis_target_s targets[] = { { AXIS_X, 150 }, { AXIS_Y, 150 }, { 2, 150 } };
+  servo.moveAxesAsync(targets, 3, 300);
+  do {
+    servo.tick();
+    delay(5);
+  } while (servo.isMoving());
+}
+
+static void runPower(ServoType emulate) {
+  stackchan_servo_initial_param_s init_param;
+  memset(&init_param, 0, sizeof(init_param));
+  init_param.axis_num = 3;
+  for (int axis = 0; axis < init_param.axis_num; axis++) {
+    init_param.servo[axis].start_degree = 150;
+    init_param.servo[axis].lower_limit  = 0;
+    init_param.servo[axis].upper_limit  = 300;
+    init_param.servo[axis].servo_type   = ServoType::SIM;
+  }
+  servo.begin(init_param, ServoType::SIM);
+  getSim()->emulate(emulate);
+  printf("--- power governor (emulate ServoType:%d) ---\n", emulate);
+  do {
+    servo.tick();
+    delay(5);
+  } while (servo.isMoving());
+  power_governor.begin(&servo);
+  runPowerMove("SidePower", SidePower, 100);
+  runPowerMove("Battery(80%)", Battery, 80);
+  runPowerMove("Battery(10%)", Battery, 10);
+  // 上限を1軸分の電流より小さくすると、2軸目以降は前の軸が止まるまで開始を遅らせます。
+  power_governor_config_s config;
+  StackchanPowerGovernor::setDefaultConfig(&config);
+  config.limit[Battery].velocity_scale = 1.0f;
+  config.limit[Battery].acceleration_scale = 1.0f;
+  config.limit[Battery].current_budget = 400;
+  power_governor.begin(&servo, &config);
+  runPowerMove("Battery(budget 400mA)", Battery, 80);
+}
+
+int main() {
+  runAll(ServoType::SCS);
+  runAll(ServoType::DYN_XL330);
+  runAll(ServoType::PWM);
+  runIdle();
+  runRecording(ServoType::SCS);
+  runRecording(ServoType::DYN_XL330);
+  runAxes(ServoType::SCS);
+  runAxes(ServoType::DYN_XL330);
+  runCalibration(ServoType::SCS);
+  runCalibration(ServoType::DYN_XL330);
+  runPower(ServoType::SCS);
+  runPower(ServoType::DYN_XL330);
+  return 0;
+}
@@ -4,12 +4,7 @@
 
 #include <M5Unified.h>
 #include "Stackchan_servo.h"
-
-enum PowerStatus {
-    SidePower,
-    BackPower,
-    Battery
-};
+#include "Stackchan_power_governor.h"     // PowerStatus
 
 PowerStatus checkTakaoBasePowerStatus(m5::Power_Class* power, int16_t battery_threshold = 3200) {
   if (!power->getExtOutput() && power->getBatteryCurrent() < 0) {
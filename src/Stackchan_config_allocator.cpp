@@ -0,0 +1,47 @@
+// Copyright (c) Takao Akaki
+#include <stdlib.h>
+#include "Stackchan_config_allocator.h"
+
+// 解放するときに大きさが分かるように、確保した領域の先頭に要求された大きさを置きます。
+// (ArduinoJsonに渡す位置のアラインメントはmallocと同じにします)
+typedef union ConfigAllocHeader {
+  size_t size;
+  max_align_t align;
+} config_alloc_header_s;
+
+void* StackchanConfigAllocator::allocate(size_t size) {
+  _alloc_count++;
+  config_alloc_header_s *header = (config_alloc_header_s *)malloc(sizeof(config_alloc_header_s) + size);
+  if (header == nullptr) {
+    _fail_count++;
+    return nullptr;
+  }
+  header->size = size;
+  _used += size;
+  if (_used > _peak) _peak = _used;
+  return header + 1;
+}
+
+void StackchanConfigAllocator::deallocate(void *ptr) {
+  if (ptr == nullptr) return;
+  config_alloc_header_s *header = (config_alloc_header_s *)ptr - 1;
+  _used -= header->size;
+  free(header);
+}
+
+void* StackchanConfigAllocator::reallocate(void *ptr, size_t new_size) {
+  if (ptr == nullptr) return allocate(new_size);
+  _alloc_count++;
+  config_alloc_header_s *header = (config_alloc_header_s *)ptr - 1;
+  size_t old_size = header->size;
+  header = (config_alloc_header_s *)realloc(header, sizeof(config_alloc_header_s) + new_size);
+  if (header == nullptr) {
+    // 元の領域はそのまま残ります。
+    _fail_count++;
+    return nullptr;
+  }
+  header->size = new_size;
+  _used = _used - old_size + new_size;
+  if (_used > _peak) _peak = _used;
+  return header + 1;
+}
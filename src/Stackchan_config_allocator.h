@@ -0,0 +1,31 @@
+// Copyright (c) 2022 Takao Akaki
+
+#ifndef _STACKCHAN_CONFIG_ALLOCATOR_H_
+#define _STACKCHAN_CONFIG_ALLOCATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ArduinoJson.h>
+
+// 設定ファイルを読み込むJsonDocumentに渡し、確保した量を数えるアロケータ(ArduinoJson 7)
+// JsonDocumentは必要なだけ領域を広げるので、使用量と最大値はこちらで測ります。
+class StackchanConfigAllocator : public ArduinoJson::Allocator {
+    protected:
+        size_t _used;                                    // 現在確保している量(byte, 要求された大きさの合計)
+        size_t _peak;                                    // resetPeak()からの最大値
+        uint32_t _alloc_count;                           // allocate/reallocateの回数
+        uint32_t _fail_count;                            // 確保できなかった回数
+    public:
+        StackchanConfigAllocator() : _used(0), _peak(0), _alloc_count(0), _fail_count(0) {}
+        void* allocate(size_t size) override;
+        void deallocate(void *ptr) override;
+        void* reallocate(void *ptr, size_t new_size) override;
+
+        void resetPeak() { _peak = _used; }
+        size_t getUsed() { return _used; }
+        size_t getPeak() { return _peak; }
+        uint32_t getAllocCount() { return _alloc_count; }
+        uint32_t getFailCount() { return _fail_count; }
+};
+
+#endif // _STACKCHAN_CONFIG_ALLOCATOR_H_
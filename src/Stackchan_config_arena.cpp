@@ -0,0 +1,47 @@
+// Copyright (c) Takao Akaki
+#include <stdlib.h>
+#include "Stackchan_config_arena.h"
+
+bool StackchanConfigArena::reserve(size_t size) {
+  release();
+  if (size == 0) return true;
+  _buffer = (uint8_t *)malloc(size);
+  if (_buffer == nullptr) return false;
+  _capacity = size;
+  return true;
+}
+
+void StackchanConfigArena::release() {
+  free(_buffer);
+  _buffer = nullptr;
+  _capacity = 0;
+  _used = 0;
+}
+
+void StackchanConfigArena::swap(StackchanConfigArena& other) {
+  uint8_t *buffer = _buffer;
+  size_t capacity = _capacity;
+  size_t used = _used;
+  _buffer = other._buffer;
+  _capacity = other._capacity;
+  _used = other._used;
+  other._buffer = buffer;
+  other._capacity = capacity;
+  other._used = used;
+}
+
+void* StackchanConfigArena::allocate(size_t size, size_t align) {
+  size_t offset = (_used + align - 1) & ~(align - 1);
+  if ((_buffer == nullptr) || (offset + size > _capacity)) return nullptr;
+  _used = offset + size;
+  return &_buffer[offset];
+}
+
+const char* StackchanConfigArena::copyString(const char *str) {
+  if (str == nullptr) str = "";
+  size_t size = strlen(str) + 1;
+  char *copy = (char *)allocate(size, 1);
+  if (copy == nullptr) return "";
+  memcpy(copy, str, size);
+  return copy;
+}
@@ -0,0 +1,47 @@
+// Copyright (c) 2022 Takao Akaki
+
+#ifndef _STACKCHAN_CONFIG_ARENA_H_
+#define _STACKCHAN_CONFIG_ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// 配列の一部を指す軽量な参照(所有しません)
+template<typename T>
+struct StackchanConfigSpan {
+    const T *data;
+    uint16_t size;
+    const T& operator[](uint16_t i) const { return data[i]; }
+    const T* begin() const { return data; }
+    const T* end() const { return data + size; }
+};
+
+// 設定の文字列とリストを1つの領域に詰めて置くアロケータ(bump arena)
+// 必要なサイズを先に数えてreserve()で1回だけ確保し、個別には解放しません。
+// reserve()/release()で前の内容は全て無効になります。
+class StackchanConfigArena {
+    protected:
+        uint8_t *_buffer;
+        size_t _capacity;
+        size_t _used;
+    public:
+        StackchanConfigArena() : _buffer(nullptr), _capacity(0), _used(0) {}
+        ~StackchanConfigArena() { release(); }
+        // 確保するサイズの見積もり(アラインメントの余白を含みます)
+        static size_t stringSize(const char *str) { return (str != nullptr) ? strlen(str) + 1 : 1; }
+        template<typename T> static size_t arraySize(size_t num) { return sizeof(T) * num + alignof(T) - 1; }
+
+        bool reserve(size_t size);
+        void release();
+        // 確保した領域ごと入れ替えます。(内容を指すポインタはそのまま有効です)
+        void swap(StackchanConfigArena& other);
+        void* allocate(size_t size, size_t align);
+        template<typename T> T* allocateArray(size_t num) { return (T *)allocate(sizeof(T) * num, alignof(T)); }
+        // 文字列をコピーします。領域が足りない場合は""を返します。
+        const char* copyString(const char *str);
+        size_t getUsed() { return _used; }
+        size_t getCapacity() { return _capacity; }
+};
+
+#endif // _STACKCHAN_CONFIG_ARENA_H_
@@ -0,0 +1,158 @@
+// Copyright (c) Takao Akaki
+#include "Stackchan_config_cache.h"
+
+StackchanConfigCache::StackchanConfigCache() : _buffer(nullptr), _size(0), _capacity(0), _pos(0), _error(false) {}
+
+StackchanConfigCache::~StackchanConfigCache() {
+  release();
+}
+
+void StackchanConfigCache::release() {
+  free(_buffer);
+  _buffer = nullptr;
+  _size = 0;
+  _capacity = 0;
+  _pos = 0;
+  _error = false;
+}
+
+// FNV-1a(32bit)
+uint32_t StackchanConfigCache::checksum(uint32_t hash, const uint8_t *data, uint32_t size) {
+  for (uint32_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+void StackchanConfigCache::getSource(fs::FS& fs, const char *filename, config_cache_source_s *source) {
+  source->size = 0;
+  source->last_write = 0;
+  if (!fs.exists(filename)) return;
+  fs::File file = fs.open(filename);
+  if (!file) return;
+  source->size = file.size();
+  source->last_write = (uint32_t)file.getLastWrite();
+  file.close();
+}
+
+bool StackchanConfigCache::reserve(uint32_t size) {
+  if (size <= _capacity) return true;
+  uint32_t capacity = (_capacity == 0) ? 512 : _capacity;
+  while (capacity < size) capacity *= 2;
+  uint8_t *buffer = (uint8_t *)realloc(_buffer, capacity);
+  if (buffer == nullptr) {
+    _error = true;
+    return false;
+  }
+  _buffer = buffer;
+  _capacity = capacity;
+  return true;
+}
+
+void StackchanConfigCache::write(const void *data, uint32_t size) {
+  if (_error || !reserve(_size + size)) return;
+  memcpy(&_buffer[_size], data, size);
+  _size += size;
+}
+
+// 長さ(uint16_t)と終端の'\0'を含めて書き込みます。
+void StackchanConfigCache::putString(const String& value) {
+  uint16_t length = value.length();
+  put(length);
+  write(value.c_str(), length + 1);
+}
+
+bool StackchanConfigCache::save(fs::FS& fs, const char *filename, uint16_t version, uint16_t layout,
+                                const config_cache_source_s *source, uint8_t source_num) {
+  if (_error || (source_num > CONFIG_CACHE_SOURCE_MAX)) return false;
+  if (_size > CONFIG_CACHE_MAX_SIZE) {
+    // load()で読み込めないので保存しません。前のキャッシュも使えないので消しておきます。
+    M5_LOGW("config cache too large: %u byte (CONFIG_CACHE_MAX_SIZE:%u)", (unsigned)_size,
+            (unsigned)CONFIG_CACHE_MAX_SIZE);
+    if (fs.exists(filename)) fs.remove(filename);
+    return false;
+  }
+  config_cache_header_s header;
+  memset(&header, 0, sizeof(header));
+  header.magic = CONFIG_CACHE_MAGIC;
+  header.version = version;
+  header.layout = layout;
+  header.payload_size = _size;
+  memcpy(header.source, source, sizeof(config_cache_source_s) * source_num);
+  header.checksum = checksum(checksum(2166136261u, (const uint8_t *)header.source, sizeof(header.source)), _buffer, _size);
+  fs::File file = fs.open(filename, FILE_WRITE);
+  if (!file) {
+    M5_LOGE("file open error: %s", filename);
+    return false;
+  }
+  bool written = (file.write((const uint8_t *)&header, sizeof(header)) == sizeof(header))
+              && (file.write(_buffer, _size) == _size);
+  file.close();
+  if (!written) {
+    // 途中までしか書けなかったファイルは次回のチェックサムで弾かれますが、残さないようにします。
+    fs.remove(filename);
+  }
+  return written;
+}
+
+bool StackchanConfigCache::load(fs::FS& fs, const char *filename, uint16_t version, uint16_t layout,
+                                const config_cache_source_s *source, uint8_t source_num) {
+  release();
+  if ((source_num > CONFIG_CACHE_SOURCE_MAX) || !fs.exists(filename)) return false;
+  fs::File file = fs.open(filename);
+  if (!file) return false;
+  config_cache_header_s header;
+  bool valid = (file.read((uint8_t *)&header, sizeof(header)) == sizeof(header))
+            && (header.magic == CONFIG_CACHE_MAGIC) && (header.version == version) && (header.layout == layout)
+            && (header.payload_size <= CONFIG_CACHE_MAX_SIZE);
+  for (int i = 0; valid && (i < CONFIG_CACHE_SOURCE_MAX); i++) {
+    // 使っていない分は0です。
+    config_cache_source_s expected = { 0, 0 };
+    if (i < source_num) expected = source[i];
+    valid = (header.source[i].size == expected.size) && (header.source[i].last_write == expected.last_write);
+  }
+  if (valid && reserve(header.payload_size)) {
+    valid = (file.read(_buffer, header.payload_size) == header.payload_size)
+         && (checksum(checksum(2166136261u, (const uint8_t *)header.source, sizeof(header.source)),
+                      _buffer, header.payload_size) == header.checksum);
+  } else {
+    valid = false;
+  }
+  file.close();
+  if (!valid) {
+    release();
+    return false;
+  }
+  _size = header.payload_size;
+  _pos = 0;
+  return true;
+}
+
+bool StackchanConfigCache::read(void *data, uint32_t size) {
+  if (_error || (_pos + size > _size)) {
+    _error = true;
+    return false;
+  }
+  memcpy(data, &_buffer[_pos], size);
+  _pos += size;
+  return true;
+}
+
+const char* StackchanConfigCache::getCString() {
+  uint16_t length;
+  if (!get(&length) || (_pos + length + 1 > _size) || (_buffer[_pos + length] != '\0')) {
+    _error = true;
+    return nullptr;
+  }
+  const char *value = (const char *)&_buffer[_pos];
+  _pos += length + 1;
+  return value;
+}
+
+bool StackchanConfigCache::getString(String *value) {
+  const char *str = getCString();
+  if (str == nullptr) return false;
+  *value = str;
+  return true;
+}
@@ -0,0 +1,68 @@
+// Copyright (c) 2022 Takao Akaki
+
+#ifndef _STACKCHAN_CONFIG_CACHE_H_
+#define _STACKCHAN_CONFIG_CACHE_H_
+
+#include "Stackchan_platform.h"
+#ifdef ARDUINO
+#include <FS.h>
+#endif
+
+#define CONFIG_CACHE_MAGIC       0x46434353   // "SCCF"
+#define CONFIG_CACHE_SOURCE_MAX  4            // キャッシュの元になる設定ファイルの最大数
+#ifndef CONFIG_CACHE_MAX_SIZE
+#define CONFIG_CACHE_MAX_SIZE    8192         // キャッシュの最大サイズ(byte) これより大きい設定は保存せず、大きいファイルは壊れているとみなします
+#endif
+
+// キャッシュの元になった設定ファイルの状態(存在しない場合はどちらも0)
+typedef struct ConfigCacheSource {
+    uint32_t size;
+    uint32_t last_write;
+} config_cache_source_s;
+
+typedef struct ConfigCacheHeader {
+    uint32_t magic;
+    uint16_t version;                                    // 書き込む側の形式のバージョン
+    uint16_t layout;                                     // 書き込む構造体のサイズなど(ビルドで構造体が変わった場合に使わないため)
+    uint32_t payload_size;
+    uint32_t checksum;                                   // sourceとpayloadのFNV-1a
+    config_cache_source_s source[CONFIG_CACHE_SOURCE_MAX];
+} config_cache_header_s;
+
+// 解析した設定をバイナリでファイルに保存し、次回の起動時にそのまま読み込むためのバッファ
+// 値はput()/putString()で書き込んだ順にget()/getString()で読み出します。
+// 元の設定ファイルのサイズ・更新日時、バージョン、チェックサムのどれかが一致しない場合は読み込みません。
+class StackchanConfigCache {
+    protected:
+        uint8_t *_buffer;
+        uint32_t _size;                                  // 書き込んだ(読み込んだ)サイズ
+        uint32_t _capacity;
+        uint32_t _pos;                                   // 読み出し位置
+        bool _error;
+        bool reserve(uint32_t size);
+    public:
+        StackchanConfigCache();
+        ~StackchanConfigCache();
+        static uint32_t checksum(uint32_t hash, const uint8_t *data, uint32_t size);
+        // ファイルのサイズと更新日時を取得します。
+        static void getSource(fs::FS& fs, const char *filename, config_cache_source_s *source);
+
+        void write(const void *data, uint32_t size);
+        template<typename T> void put(const T& value) { write(&value, sizeof(T)); }
+        void putString(const String& value);
+        bool save(fs::FS& fs, const char *filename, uint16_t version, uint16_t layout,
+                  const config_cache_source_s *source, uint8_t source_num);
+
+        bool load(fs::FS& fs, const char *filename, uint16_t version, uint16_t layout,
+                  const config_cache_source_s *source, uint8_t source_num);
+        bool read(void *data, uint32_t size);
+        template<typename T> bool get(T *value) { return read(value, sizeof(T)); }
+        bool getString(String *value);
+        // 読み込んだ領域の中の文字列を返します(コピーしません)。load()/release()まで有効です。失敗した場合はnullptr
+        const char* getCString();
+        // 書き込み・読み出しで領域が足りなかった、またはデータが足りなかった場合にtrue
+        bool isError() { return _error; }
+        void release();
+};
+
+#endif // _STACKCHAN_CONFIG_CACHE_H_
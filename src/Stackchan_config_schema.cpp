@@ -0,0 +1,163 @@
+// Copyright (c) Takao Akaki
+#include "Stackchan_config_schema.h"
+
+#define CONFIG_PATH_MAX 64
+
+// '.'区切りのパスをたどります。途中のキーがない場合はnullを返します。
+JsonVariantConst StackchanConfigSchema::find(JsonVariantConst root, const char *path) {
+  char key[CONFIG_PATH_MAX];
+  JsonVariantConst value = root;
+  while ((*path != '\0') && !value.isNull()) {
+    const char *end = strchr(path, '.');
+    size_t length = (end != nullptr) ? (size_t)(end - path) : strlen(path);
+    if (length >= sizeof(key)) return JsonVariantConst();
+    memcpy(key, path, length);
+    key[length] = '\0';
+    value = value[(const char *)key];
+    path += length;
+    if (*path == '.') path++;
+  }
+  return value;
+}
+
+static double clampValue(const config_field_s *field, double value, bool *clamped) {
+  *clamped = false;
+  if (!(field->min < field->max)) return value;
+  if (value < field->min) {
+    *clamped = true;
+    return field->min;
+  }
+  if (value > field->max) {
+    *clamped = true;
+    return field->max;
+  }
+  return value;
+}
+
+static void setNumber(const config_field_s *field, void *base, double value) {
+  uint8_t *p = (uint8_t *)base + field->offset;
+  switch (field->type) {
+    case CONFIG_BOOL:   *(bool *)p = (value != 0.0); break;
+    case CONFIG_UINT8:  *(uint8_t *)p = (uint8_t)value; break;
+    case CONFIG_INT16:  *(int16_t *)p = (int16_t)value; break;
+    case CONFIG_UINT16: *(uint16_t *)p = (uint16_t)value; break;
+    case CONFIG_INT32:  *(int32_t *)p = (int32_t)value; break;
+    case CONFIG_UINT32: *(uint32_t *)p = (uint32_t)value; break;
+    case CONFIG_FLOAT:  *(float *)p = (float)value; break;
+    default: break;
+  }
+}
+
+void StackchanConfigSchema::setDefaults(const config_schema_table_s *table, void *base) {
+  for (int i = 0; i < table->field_num; i++) {
+    const config_field_s *field = &table->fields[i];
+    if (field->type == CONFIG_STRING) {
+      *(String *)((uint8_t *)base + field->offset) = (field->default_string != nullptr) ? field->default_string : "";
+    } else {
+      setNumber(field, base, field->default_value);
+    }
+  }
+}
+
+uint16_t StackchanConfigSchema::load(JsonVariantConst root, const config_schema_table_s *table, void *base,
+                                     const char *log_prefix) {
+  uint16_t problem_num = 0;
+  for (int i = 0; i < table->field_num; i++) {
+    const config_field_s *field = &table->fields[i];
+    JsonVariantConst value = find(root, field->path);
+    if (value.isNull()) {
+      if (field->flags & CONFIG_REQUIRED) {
+        M5_LOGW("config: %s%s is missing. default value is used.", log_prefix, field->path);
+        problem_num++;
+      }
+      if (field->type == CONFIG_STRING) {
+        *(String *)((uint8_t *)base + field->offset) = (field->default_string != nullptr) ? field->default_string : "";
+      } else {
+        setNumber(field, base, field->default_value);
+      }
+      continue;
+    }
+    if (field->type == CONFIG_STRING) {
+      *(String *)((uint8_t *)base + field->offset) = value.as<String>();
+      continue;
+    }
+    // 32bitの整数もdoubleなら丸めずに範囲を確認できます。
+    double number = value.is<bool>() ? (value.as<bool>() ? 1.0 : 0.0) : value.as<double>();
+    bool clamped;
+    number = clampValue(field, number, &clamped);
+    if (clamped) {
+      M5_LOGW("config: %s%s is out of range (%g-%g). %g is used.", log_prefix, field->path, field->min, field->max,
+              number);
+      problem_num++;
+    }
+    setNumber(field, base, number);
+  }
+  return problem_num;
+}
+
+void StackchanConfigSchema::print(const config_schema_table_s *table, const void *base, const char *log_prefix) {
+  for (int i = 0; i < table->field_num; i++) {
+    const config_field_s *field = &table->fields[i];
+    const uint8_t *p = (const uint8_t *)base + field->offset;
+    switch (field->type) {
+      case CONFIG_BOOL:   M5_LOGI("%s%s:%s", log_prefix, field->path, *(const bool *)p ? "true" : "false"); break;
+      case CONFIG_UINT8:  M5_LOGI("%s%s:%u", log_prefix, field->path, *(const uint8_t *)p); break;
+      case CONFIG_INT16:  M5_LOGI("%s%s:%d", log_prefix, field->path, *(const int16_t *)p); break;
+      case CONFIG_UINT16: M5_LOGI("%s%s:%u", log_prefix, field->path, *(const uint16_t *)p); break;
+      case CONFIG_INT32:  M5_LOGI("%s%s:%d", log_prefix, field->path, *(const int32_t *)p); break;
+      case CONFIG_UINT32: M5_LOGI("%s%s:%u", log_prefix, field->path, *(const uint32_t *)p); break;
+      case CONFIG_FLOAT:  M5_LOGI("%s%s:%f", log_prefix, field->path, *(const float *)p); break;
+      case CONFIG_STRING: M5_LOGI("%s%s:%s", log_prefix, field->path, ((const String *)p)->c_str()); break;
+      default: break;
+    }
+  }
+}
+
+static bool isKnownPath(const char *path, const config_schema_table_s *tables, uint8_t table_num,
+                        const char *const *handled_paths, bool *parent) {
+  size_t length = strlen(path);
+  *parent = false;
+  for (int t = 0; t < table_num; t++) {
+    for (int i = 0; i < tables[t].field_num; i++) {
+      const char *field_path = tables[t].fields[i].path;
+      if (strcmp(field_path, path) == 0) return true;
+      if ((strncmp(field_path, path, length) == 0) && (field_path[length] == '.')) *parent = true;
+    }
+  }
+  for (int i = 0; (handled_paths != nullptr) && (handled_paths[i] != nullptr); i++) {
+    size_t handled_length = strlen(handled_paths[i]);
+    if ((strncmp(handled_paths[i], path, handled_length) == 0)
+        && ((path[handled_length] == '\0') || (path[handled_length] == '.'))) return true;
+    if ((strncmp(handled_paths[i], path, length) == 0) && (handled_paths[i][length] == '.')) *parent = true;
+  }
+  return false;
+}
+
+static uint16_t reportUnknown(JsonObjectConst object, char *path, size_t path_length,
+                              const config_schema_table_s *tables, uint8_t table_num, const char *const *handled_paths) {
+  uint16_t unknown_num = 0;
+  for (JsonPairConst item : object) {
+    const char *key = item.key().c_str();
+    size_t length = path_length + ((path_length > 0) ? 1 : 0) + strlen(key);
+    if (length >= CONFIG_PATH_MAX) continue;
+    if (path_length > 0) path[path_length] = '.';
+    strcpy(&path[path_length + ((path_length > 0) ? 1 : 0)], key);
+    bool parent;
+    if (!isKnownPath(path, tables, table_num, handled_paths, &parent)) {
+      if (parent && item.value().is<JsonObjectConst>()) {
+        unknown_num += reportUnknown(item.value().as<JsonObjectConst>(), path, length, tables, table_num, handled_paths);
+      } else {
+        M5_LOGW("config: unknown key %s is ignored.", path);
+        unknown_num++;
+      }
+    }
+    path[path_length] = '\0';
+  }
+  return unknown_num;
+}
+
+uint16_t StackchanConfigSchema::reportUnknownKeys(JsonObjectConst root, const config_schema_table_s *tables,
+                                                  uint8_t table_num, const char *const *handled_paths) {
+  char path[CONFIG_PATH_MAX] = "";
+  return reportUnknown(root, path, 0, tables, table_num, handled_paths);
+}
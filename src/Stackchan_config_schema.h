@@ -0,0 +1,65 @@
+// Copyright (c) 2022 Takao Akaki
+
+#ifndef _STACKCHAN_CONFIG_SCHEMA_H_
+#define _STACKCHAN_CONFIG_SCHEMA_H_
+
+#include <stddef.h>
+#include "Stackchan_platform.h"
+#include <ArduinoJson.h>
+
+enum ConfigValueType {
+    CONFIG_BOOL,
+    CONFIG_UINT8,
+    CONFIG_INT16,
+    CONFIG_UINT16,
+    CONFIG_INT32,
+    CONFIG_UINT32,
+    CONFIG_FLOAT,
+    CONFIG_STRING                      // String
+};
+
+#define CONFIG_REQUIRED  0x01          // 指定されていない場合にログに出す
+
+// 設定の1項目: キーのパス('.'区切り)と、値を書き込む構造体の中の位置・型・初期値・範囲
+typedef struct ConfigField {
+    const char *path;
+    uint8_t type;                      // ConfigValueType
+    uint8_t flags;
+    uint16_t offset;                   // 構造体の先頭からの位置(offsetof)
+    float default_value;               // 数値の初期値
+    float min;                         // 範囲(min < maxの場合のみ範囲内に収めます)
+    float max;
+    const char *default_string;        // 文字列の初期値
+} config_field_s;
+
+// 1つの構造体に対応する項目の表
+typedef struct ConfigSchemaTable {
+    const config_field_s *fields;
+    uint16_t field_num;
+} config_schema_table_s;
+
+// 項目の表を書くためのマクロ (constexprの表に並べます)
+#define CONFIG_FIELD(path, type, flags, s, member, def, min, max) \
+    { path, type, flags, (uint16_t)offsetof(s, member), (float)(def), (float)(min), (float)(max), nullptr }
+#define CONFIG_STRING_FIELD(path, flags, s, member, def) \
+    { path, CONFIG_STRING, flags, (uint16_t)offsetof(s, member), 0.0f, 0.0f, 0.0f, def }
+#define CONFIG_TABLE(fields) { fields, (uint16_t)(sizeof(fields) / sizeof(fields[0])) }
+
+// 項目の表に従って、JSON(YAML)から構造体へ値を読み込みます。
+// 指定されていない項目は初期値、範囲外の値は範囲内に収めて、どちらもログに出します。
+class StackchanConfigSchema {
+    public:
+        // 読み込んだ値を範囲内に収めた、または必須の項目がなかった数を返します。
+        static uint16_t load(JsonVariantConst root, const config_schema_table_s *table, void *base,
+                             const char *log_prefix = "");
+        static void setDefaults(const config_schema_table_s *table, void *base);
+        // 全ての項目を「パス:値」の形式でログに出力します。
+        static void print(const config_schema_table_s *table, const void *base, const char *log_prefix = "");
+        // どの表にもない(使われない)キーをログに出し、その数を返します。
+        // handled_pathsはnullptr終端のリストで、表の外で読み込むキー(リストなど)とその下のキーは対象外です。
+        static uint16_t reportUnknownKeys(JsonObjectConst root, const config_schema_table_s *tables, uint8_t table_num,
+                                          const char *const *handled_paths);
+        static JsonVariantConst find(JsonVariantConst root, const char *path);
+};
+
+#endif // _STACKCHAN_CONFIG_SCHEMA_H_
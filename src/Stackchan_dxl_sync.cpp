@@ -0,0 +1,127 @@
+// Copyright (c) Takao Akaki
+#include "Stackchan_dxl_sync.h"
+
+#ifdef STACKCHAN_SERVO_USE_DYN_XL330
+
+StackchanDxlSync::StackchanDxlSync() : _dxl(nullptr), _id_num(0) {
+  memset(&_write_info, 0, sizeof(_write_info));
+  memset(&_torque_info, 0, sizeof(_torque_info));
+  memset(&_read_info, 0, sizeof(_read_info));
+  memset(&_health_info, 0, sizeof(_health_info));
+  memset(&_error_info, 0, sizeof(_error_info));
+}
+
+// 全サーボから同じアドレス・長さを読み出すSync Readの設定(dataはサーボ1台あたりaddr_lengthの配列)
+void StackchanDxlSync::initSyncRead(DYNAMIXEL::InfoSyncReadInst_t *info, DYNAMIXEL::XELInfoSyncRead_t *xels,
+                                    uint8_t *buf, uint16_t buf_size, uint16_t addr, uint16_t addr_length, uint8_t *data) {
+  info->packet.p_buf = buf;
+  info->packet.buf_capacity = buf_size;
+  info->packet.is_completed = false;
+  info->addr = addr;
+  info->addr_length = addr_length;
+  info->p_xels = xels;
+  info->xel_count = _id_num;
+  for (int i=0; i<_id_num; i++) {
+    xels[i].id = _ids[i];
+    xels[i].p_recv_buf = data + addr_length * i;
+  }
+  info->is_info_changed = true;
+}
+
+void StackchanDxlSync::begin(Dynamixel2Arduino *dxl, const uint8_t *ids, uint8_t id_num) {
+  _dxl = dxl;
+  _id_num = (id_num > DXL_SYNC_MAX_ID) ? DXL_SYNC_MAX_ID : id_num;
+  for (int i=0; i<_id_num; i++) {
+    _ids[i] = ids[i];
+  }
+
+  _write_info.packet.p_buf = _write_buf;
+  _write_info.packet.buf_capacity = sizeof(_write_buf);
+  _write_info.packet.is_completed = false;
+  _write_info.addr = DXL_ADDR_PROFILE_ACCELERATION;
+  _write_info.addr_length = sizeof(_write_data[0]);
+  _write_info.p_xels = _write_xels;
+  _write_info.xel_count = 0;
+  _write_info.is_info_changed = true;
+
+  _torque_info.packet.p_buf = _torque_buf;
+  _torque_info.packet.buf_capacity = sizeof(_torque_buf);
+  _torque_info.packet.is_completed = false;
+  _torque_info.addr = DXL_ADDR_TORQUE_ENABLE;
+  _torque_info.addr_length = sizeof(_torque_data[0]);
+  _torque_info.p_xels = _torque_xels;
+  _torque_info.xel_count = _id_num;
+  for (int i=0; i<_id_num; i++) {
+    _torque_xels[i].id = _ids[i];
+    _torque_xels[i].p_data = &_torque_data[i];
+  }
+  _torque_info.is_info_changed = true;
+
+  initSyncRead(&_read_info, _read_xels, _read_buf, sizeof(_read_buf),
+               DXL_ADDR_MOVING, sizeof(_read_data[0]), (uint8_t*)_read_data);
+  initSyncRead(&_health_info, _health_xels, _health_buf, sizeof(_health_buf),
+               DXL_ADDR_PRESENT_CURRENT, sizeof(_health_data[0]), (uint8_t*)_health_data);
+  initSyncRead(&_error_info, _error_xels, _error_buf, sizeof(_error_buf),
+               DXL_ADDR_HARDWARE_ERROR_STATUS, sizeof(_error_data[0]), _error_data);
+}
+
+bool StackchanDxlSync::writeProfileAndGoal(const bool *enable, const uint32_t *millis_for_accel,
+                                           const uint32_t *millis_for_move, const int32_t *goal_position) {
+  if (_dxl == nullptr) return false;
+  uint8_t count = 0;
+  for (int i=0; i<_id_num; i++) {
+    if (!enable[i]) continue;
+    _write_data[i][0] = millis_for_accel[i];
+    _write_data[i][1] = millis_for_move[i];
+    _write_data[i][2] = goal_position[i];
+    _write_xels[count].id = _ids[i];
+    _write_xels[count].p_data = (uint8_t*)_write_data[i];
+    count++;
+  }
+  if (count == 0) return true;
+  _write_info.xel_count = count;
+  _write_info.is_info_changed = true;
+  return _dxl->syncWrite(&_write_info);
+}
+
+bool StackchanDxlSync::writeTorque(bool enable) {
+  if (_dxl == nullptr) return false;
+  for (int i=0; i<_id_num; i++) {
+    _torque_data[i] = enable ? 1 : 0;
+  }
+  _torque_info.is_info_changed = true;
+  return _dxl->syncWrite(&_torque_info);
+}
+
+uint8_t StackchanDxlSync::readPresentState(dxl_present_state_s *present_state) {
+  if (_dxl == nullptr) return 0;
+  uint8_t recv_num = _dxl->syncRead(&_read_info);
+  memcpy(present_state, _read_data, sizeof(dxl_present_state_s) * _id_num);
+  return recv_num;
+}
+
+uint8_t StackchanDxlSync::readPresentPosition(int32_t *present_position) {
+  dxl_present_state_s present_state[DXL_SYNC_MAX_ID];
+  uint8_t recv_num = readPresentState(present_state);
+  for (int i=0; i<_id_num; i++) {
+    present_position[i] = present_state[i].present_position;
+  }
+  return recv_num;
+}
+
+uint8_t StackchanDxlSync::readPresentHealth(dxl_present_health_s *present_health, uint8_t *hardware_error) {
+  if (_dxl == nullptr) return 0;
+  uint8_t recv_num = _dxl->syncRead(&_health_info);
+  memcpy(present_health, _health_data, sizeof(dxl_present_health_s) * _id_num);
+  bool alert = false;
+  for (int i=0; i<_id_num; i++) {
+    hardware_error[i] = 0;
+    alert = alert || (_health_xels[i].error & DXL_STATUS_ALERT);
+  }
+  if (alert && (_dxl->syncRead(&_error_info) > 0)) {
+    memcpy(hardware_error, _error_data, _id_num);
+  }
+  return recv_num;
+}
+
+#endif // STACKCHAN_SERVO_USE_DYN_XL330
@@ -0,0 +1,114 @@
+// Copyright (c) 2022 Takao Akaki
+
+#ifndef _STACKCHAN_DXL_SYNC_H_
+#define _STACKCHAN_DXL_SYNC_H_
+
+#include "Stackchan_servo_driver.h"
+
+#ifdef STACKCHAN_SERVO_USE_DYN_XL330
+
+#include <Dynamixel2Arduino.h>
+
+// Dynamixel XL330のControlTable(Protocol 2.0)
+#define DXL_ADDR_TORQUE_ENABLE      64
+#define DXL_ADDR_HARDWARE_ERROR_STATUS 70
+#define DXL_ADDR_PROFILE_ACCELERATION 108
+#define DXL_ADDR_PROFILE_VELOCITY   112
+#define DXL_ADDR_GOAL_POSITION      116
+#define DXL_ADDR_MOVING             122
+#define DXL_ADDR_MOVING_STATUS      123
+#define DXL_ADDR_PRESENT_POSITION   132
+#define DXL_ADDR_PRESENT_CURRENT    126
+#define DXL_ADDR_PRESENT_INPUT_VOLTAGE 144
+#define DXL_ADDR_PRESENT_TEMPERATURE 146
+
+#define DXL_MOVING_STATUS_IN_POSITION       0x01  // 目標位置に到達
+#define DXL_MOVING_STATUS_PROFILE_ONGOING   0x02  // プロファイル実行中
+#define DXL_STATUS_ALERT                    0x80  // Status PacketのErrorのAlertビット(Hardware Errorあり)
+
+#define DXL_SYNC_MAX_ID             SERVO_AXIS_MAX  // 一度に送るサーボの最大数
+#define DXL_SYNC_PACKET_BUF_SIZE    (48 + 13 * DXL_SYNC_MAX_ID)  // SyncWrite/SyncReadのパケットバッファサイズ(2軸で74byte)
+
+// MOVING(122)からPRESENT_POSITION(132)までの連続した領域
+typedef struct __attribute__((packed)) DxlPresentState {
+    uint8_t moving;                    // 1: 移動中
+    uint8_t moving_status;             // DXL_MOVING_STATUS_*
+    int16_t present_pwm;
+    int16_t present_current;
+    int32_t present_velocity;
+    int32_t present_position;
+} dxl_present_state_s;
+
+// PRESENT_CURRENT(126)からPRESENT_TEMPERATURE(146)までの連続した領域
+typedef struct __attribute__((packed)) DxlPresentHealth {
+    int16_t present_current;           // 1mA
+    int32_t present_velocity;
+    int32_t present_position;
+    int32_t velocity_trajectory;
+    int32_t position_trajectory;
+    uint16_t present_input_voltage;    // 0.1V
+    uint8_t present_temperature;       // 1℃
+} dxl_present_health_s;
+
+// 複数のDynamixelへProtocol 2.0のSync Write/Sync Readでまとめて送受信するクラス
+// PROFILE_ACCELERATION(108), PROFILE_VELOCITY(112), GOAL_POSITION(116)は連続したアドレスなので1パケットで書き込みます。
+// (DRIVE_MODEが時間指定の場合、ACCELERATIONは加速時間、VELOCITYは移動時間(msec)です。)
+class StackchanDxlSync {
+    protected:
+        Dynamixel2Arduino *_dxl;
+        uint8_t _id_num;
+        uint8_t _ids[DXL_SYNC_MAX_ID];
+
+        // Sync Write (PROFILE_ACCELERATION + PROFILE_VELOCITY + GOAL_POSITION)
+        int32_t _write_data[DXL_SYNC_MAX_ID][3];
+        DYNAMIXEL::XELInfoSyncWrite_t _write_xels[DXL_SYNC_MAX_ID];
+        DYNAMIXEL::InfoSyncWriteInst_t _write_info;
+        uint8_t _write_buf[DXL_SYNC_PACKET_BUF_SIZE];
+
+        // Sync Write (TORQUE_ENABLE)
+        uint8_t _torque_data[DXL_SYNC_MAX_ID];
+        DYNAMIXEL::XELInfoSyncWrite_t _torque_xels[DXL_SYNC_MAX_ID];
+        DYNAMIXEL::InfoSyncWriteInst_t _torque_info;
+        uint8_t _torque_buf[DXL_SYNC_PACKET_BUF_SIZE];
+
+        // Sync Read (MOVING〜PRESENT_POSITION)
+        dxl_present_state_s _read_data[DXL_SYNC_MAX_ID];
+        DYNAMIXEL::XELInfoSyncRead_t _read_xels[DXL_SYNC_MAX_ID];
+        DYNAMIXEL::InfoSyncReadInst_t _read_info;
+        uint8_t _read_buf[DXL_SYNC_PACKET_BUF_SIZE];
+
+        // Sync Read (PRESENT_CURRENT〜PRESENT_TEMPERATURE)
+        dxl_present_health_s _health_data[DXL_SYNC_MAX_ID];
+        DYNAMIXEL::XELInfoSyncRead_t _health_xels[DXL_SYNC_MAX_ID];
+        DYNAMIXEL::InfoSyncReadInst_t _health_info;
+        uint8_t _health_buf[DXL_SYNC_PACKET_BUF_SIZE];
+
+        // Sync Read (HARDWARE_ERROR_STATUS)
+        uint8_t _error_data[DXL_SYNC_MAX_ID];
+        DYNAMIXEL::XELInfoSyncRead_t _error_xels[DXL_SYNC_MAX_ID];
+        DYNAMIXEL::InfoSyncReadInst_t _error_info;
+        uint8_t _error_buf[DXL_SYNC_PACKET_BUF_SIZE];
+
+        void initSyncRead(DYNAMIXEL::InfoSyncReadInst_t *info, DYNAMIXEL::XELInfoSyncRead_t *xels,
+                          uint8_t *buf, uint16_t buf_size, uint16_t addr, uint16_t addr_length, uint8_t *data);
+
+    public:
+        StackchanDxlSync();
+        void begin(Dynamixel2Arduino *dxl, const uint8_t *ids, uint8_t id_num);
+        // 指定したサーボ(index)の加速時間、移動時間と目標位置を1回のSync Writeで送信します。
+        bool writeProfileAndGoal(const bool *enable, const uint32_t *millis_for_accel,
+                                 const uint32_t *millis_for_move, const int32_t *goal_position);
+        // 全サーボのトルクを1回のSync WriteでON/OFFします。
+        bool writeTorque(bool enable);
+        // 全サーボの移動状態と現在位置を1回のSync Readで取得します。戻り値は応答のあったサーボ数です。
+        uint8_t readPresentState(dxl_present_state_s *present_state);
+        // 全サーボの現在位置を1回のSync Readで取得します。戻り値は応答のあったサーボ数です。
+        uint8_t readPresentPosition(int32_t *present_position);
+        // 全サーボの電流・電圧・温度を1回のSync Readで取得します。
+        // 応答のErrorにAlertビットがあるサーボがある場合のみ、Hardware Error Statusを追加で読み出します。(ない場合は0)
+        uint8_t readPresentHealth(dxl_present_health_s *present_health, uint8_t *hardware_error);
+        uint8_t getIdNum() { return _id_num; }
+};
+
+#endif // STACKCHAN_SERVO_USE_DYN_XL330
+#endif // _STACKCHAN_DXL_SYNC_H_
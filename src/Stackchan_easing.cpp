@@ -0,0 +1,172 @@
+// Copyright (c) Takao Akaki
+#include <string.h>
+#include "Stackchan_easing.h"
+
+// 各カーブのテーブルはコンパイル時(constexpr)に生成し、実行時には浮動小数点の計算を行いません。
+// (C++11のconstexprで書けるように、関数は1つのreturn文にしています。)
+namespace {
+
+constexpr double EASE_PI = 3.14159265358979323846;
+
+// sin(x)のテイラー展開(|x| <= πで使用)
+constexpr double sinSeries(double x2, double term, int n, double sum) {
+  return (n > 25) ? sum : sinSeries(x2, -term * x2 / ((2 * n) * (2 * n + 1)), n + 1, sum + term);
+}
+
+// xを-π〜πに収めてからsinを求めます。
+constexpr double sinReduced(double x) {
+  return sinSeries(x * x, x, 1, 0.0);
+}
+
+constexpr double easeSin(double x) {
+  return sinReduced(x - 2.0 * EASE_PI * (double)(long)(x / (2.0 * EASE_PI) + ((x >= 0.0) ? 0.5 : -0.5)));
+}
+
+// exp(x)のテイラー展開(x >= 0で使用)
+constexpr double expSeries(double x, double term, int n, double sum) {
+  return (n > 40) ? sum : expSeries(x, term * x / n, n + 1, sum + term);
+}
+
+constexpr double easeExp(double x) {
+  return (x >= 0.0) ? expSeries(x, 1.0, 1, 0.0) : 1.0 / expSeries(-x, 1.0, 1, 0.0);
+}
+
+constexpr double easePow2(double x) {
+  return easeExp(x * 0.69314718055994530942);
+}
+
+constexpr double easeQuad(double p) {
+  return (p < 0.5) ? 2.0 * p * p : 1.0 - (2.0 - 2.0 * p) * (2.0 - 2.0 * p) / 2.0;
+}
+
+constexpr double easeCubic(double p) {
+  return (p < 0.5) ? 4.0 * p * p * p : 1.0 - (2.0 - 2.0 * p) * (2.0 - 2.0 * p) * (2.0 - 2.0 * p) / 2.0;
+}
+
+constexpr double easeSine(double p) {
+  return (1.0 - easeSin(EASE_PI * p + EASE_PI / 2.0)) / 2.0;
+}
+
+constexpr double BACK_C2 = 1.70158 * 1.525;
+
+constexpr double easeBack(double p) {
+  return (p < 0.5) ? (2.0 * p) * (2.0 * p) * ((BACK_C2 + 1.0) * 2.0 * p - BACK_C2) / 2.0
+                   : ((2.0 * p - 2.0) * (2.0 * p - 2.0) * ((BACK_C2 + 1.0) * (2.0 * p - 2.0) + BACK_C2) + 2.0) / 2.0;
+}
+
+constexpr double ELASTIC_C5 = (2.0 * EASE_PI) / 4.5;
+
+constexpr double easeElastic(double p) {
+  return (p <= 0.0) ? 0.0
+       : (p >= 1.0) ? 1.0
+       : (p < 0.5)  ? -(easePow2(20.0 * p - 10.0) * easeSin((20.0 * p - 11.125) * ELASTIC_C5)) / 2.0
+                    : (easePow2(-20.0 * p + 10.0) * easeSin((20.0 * p - 11.125) * ELASTIC_C5)) / 2.0 + 1.0;
+}
+
+constexpr double easeCurve(int ease, double p) {
+  return (ease == SERVO_EASE_CUBIC)   ? easeCubic(p)
+       : (ease == SERVO_EASE_SINE)    ? easeSine(p)
+       : (ease == SERVO_EASE_BACK)    ? easeBack(p)
+       : (ease == SERVO_EASE_ELASTIC) ? easeElastic(p)
+       : easeQuad(p);
+}
+
+constexpr int32_t toQ15(double x) {
+  return (int32_t)(x * SERVO_EASE_Q15_ONE + ((x >= 0.0) ? 0.5 : -0.5));
+}
+
+typedef struct EaseTable {
+  int32_t value[SERVO_EASE_TABLE_SEGMENTS + 1];
+} ease_table_s;
+
+template <int... I> struct IndexList {};
+template <int N, int... I> struct MakeIndexList : MakeIndexList<N - 1, N - 1, I...> {};
+template <int... I> struct MakeIndexList<0, I...> { typedef IndexList<I...> type; };
+
+template <int... I>
+constexpr ease_table_s makeTable(int ease, IndexList<I...>) {
+  return ease_table_s{ { toQ15(easeCurve(ease, (double)I / SERVO_EASE_TABLE_SEGMENTS))... } };
+}
+
+typedef MakeIndexList<SERVO_EASE_TABLE_SEGMENTS + 1>::type TableIndex;
+
+// テーブルを持つカーブ(QUAD, CUBIC, SINE, BACK, ELASTIC)の順
+constexpr ease_table_s EASE_TABLES[] = {
+  makeTable(SERVO_EASE_QUAD, TableIndex()),
+  makeTable(SERVO_EASE_CUBIC, TableIndex()),
+  makeTable(SERVO_EASE_SINE, TableIndex()),
+  makeTable(SERVO_EASE_BACK, TableIndex()),
+  makeTable(SERVO_EASE_ELASTIC, TableIndex()),
+};
+
+const char* const EASE_NAMES[SERVO_EASE_NUM] = {
+  "linear", "quad", nullptr, "cubic", "sine", "back", "elastic"
+};
+
+} // namespace
+
+// テーブルを持たないLINEARの場合はnullptr
+static const int32_t* getTable(uint8_t ease) {
+  switch (ease) {
+    case SERVO_EASE_QUAD:
+    case SERVO_EASE_TRAPEZOID: return EASE_TABLES[0].value;
+    case SERVO_EASE_CUBIC:     return EASE_TABLES[1].value;
+    case SERVO_EASE_SINE:      return EASE_TABLES[2].value;
+    case SERVO_EASE_BACK:      return EASE_TABLES[3].value;
+    case SERVO_EASE_ELASTIC:   return EASE_TABLES[4].value;
+    default:                   return nullptr;
+  }
+}
+
+#define SERVO_EASE_FRAC_BITS  (15 - SERVO_EASE_TABLE_BITS)
+
+int32_t servoEaseQ15(uint8_t ease, int32_t p) {
+  if (p <= 0) return 0;
+  if (p >= SERVO_EASE_Q15_ONE) return SERVO_EASE_Q15_ONE;
+  const int32_t *table = getTable(ease);
+  if (table == nullptr) return p;
+  int32_t index = p >> SERVO_EASE_FRAC_BITS;
+  int32_t frac = p & ((1 << SERVO_EASE_FRAC_BITS) - 1);
+  return table[index] + (((table[index + 1] - table[index]) * frac) >> SERVO_EASE_FRAC_BITS);
+}
+
+int32_t servoEaseSlopeQ15(uint8_t ease, int32_t p) {
+  const int32_t *table = getTable(ease);
+  if (table == nullptr) return SERVO_EASE_Q15_ONE;
+  if (p < 0) p = 0;
+  int32_t index = p >> SERVO_EASE_FRAC_BITS;
+  if (index >= SERVO_EASE_TABLE_SEGMENTS) index = SERVO_EASE_TABLE_SEGMENTS - 1;
+  return (table[index + 1] - table[index]) * SERVO_EASE_TABLE_SEGMENTS;
+}
+
+// 加速区間と減速区間は2次式、その間は等速です。(加速時間の割合をrとして、最高速度は1/(1-r))
+int32_t trapezoidEaseQ15(int32_t p, int32_t accel_ratio) {
+  int32_t r = accel_ratio;
+  if (r <= 0) return p;
+  if (r > SERVO_EASE_Q15_ONE / 2) r = SERVO_EASE_Q15_ONE / 2;
+  if (p <= 0) return 0;
+  if (p >= SERVO_EASE_Q15_ONE) return SERVO_EASE_Q15_ONE;
+  int64_t k = 2 * (int64_t)r * (SERVO_EASE_Q15_ONE - r);    // Q30
+  if (p < r) {
+    return (int32_t)(((int64_t)p * p << 15) / k);
+  } else if (p <= SERVO_EASE_Q15_ONE - r) {
+    return (int32_t)(((int64_t)(p - r / 2) << 15) / (SERVO_EASE_Q15_ONE - r));
+  }
+  int64_t q = SERVO_EASE_Q15_ONE - p;
+  return SERVO_EASE_Q15_ONE - (int32_t)((q * q << 15) / k);
+}
+
+int32_t servoEaseProgressQ15(uint32_t elapsed, uint32_t duration) {
+  if ((duration == 0) || (elapsed >= duration)) return SERVO_EASE_Q15_ONE;
+  return (int32_t)(((uint64_t)elapsed << 15) / duration);
+}
+
+uint8_t servoEaseFromName(const char *name, uint8_t default_ease) {
+  if (name == nullptr) return default_ease;
+  for (int i = 0; i < SERVO_EASE_NUM; i++) {
+    if ((EASE_NAMES[i] != nullptr) && (strcmp(name, EASE_NAMES[i]) == 0)) {
+      return i;
+    }
+  }
+  return default_ease;
+}
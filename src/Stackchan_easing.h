@@ -0,0 +1,46 @@
+// Copyright (c) 2022 Takao Akaki
+
+#ifndef _STACKCHAN_EASING_H_
+#define _STACKCHAN_EASING_H_
+
+#include <stdint.h>
+
+// 進み具合と位置はQ15(1.0 = SERVO_EASE_Q15_ONE)の整数で扱います。
+#define SERVO_EASE_Q15_ONE          32768
+#define SERVO_EASE_TABLE_BITS       7                                // テーブルの区間数(2のべき乗)のビット数
+#define SERVO_EASE_TABLE_SEGMENTS   (1 << SERVO_EASE_TABLE_BITS)     // テーブルの区間数(エントリ数は区間数+1)
+
+enum ServoEase {
+    SERVO_EASE_LINEAR,                 // 等速
+    SERVO_EASE_QUAD,                   // quadraticEaseInOut(従来の動き)
+    SERVO_EASE_TRAPEZOID,              // 台形速度(速度・加速度の上限から計画した移動)
+    SERVO_EASE_CUBIC,                  // cubicEaseInOut
+    SERVO_EASE_SINE,                   // sineEaseInOut
+    SERVO_EASE_BACK,                   // backEaseInOut(少し行き過ぎて戻る)
+    SERVO_EASE_ELASTIC,                // elasticEaseInOut(振動しながら止まる)
+    SERVO_EASE_NUM
+};
+
+// 進み具合p(0〜SERVO_EASE_Q15_ONE)に対する位置(Q15)を返します。
+// テーブルの間は直線で補間します。BACKとELASTICは0未満や1.0を超えることがあります。
+// SERVO_EASE_TRAPEZOIDは加速時間の割合がないのでQUAD(加速時間の割合0.5の台形速度と同じ)になります。
+int32_t servoEaseQ15(uint8_t ease, int32_t p);
+
+// 進み具合pでの傾き(d位置/d進み具合, Q15)を返します。速度の計算に使います。
+int32_t servoEaseSlopeQ15(uint8_t ease, int32_t p);
+
+// 台形速度の位置(Q15)を返します。accel_ratioは移動時間に対する加速時間の割合(Q15, 0〜0.5)
+int32_t trapezoidEaseQ15(int32_t p, int32_t accel_ratio);
+
+// 経過時間の割合(Q15)を返します。durationが0または経過済みの場合はSERVO_EASE_Q15_ONE
+int32_t servoEaseProgressQ15(uint32_t elapsed, uint32_t duration);
+
+// fromからtoまでの位置e(Q15)の値を四捨五入して返します。
+static inline int32_t servoEaseLerp(int32_t from, int32_t to, int32_t e) {
+    return from + (((to - from) * e + (SERVO_EASE_Q15_ONE / 2)) >> 15);
+}
+
+// "linear", "quad", "cubic", "sine", "back", "elastic"をServoEaseに変換します。該当しない場合はdefault_ease
+uint8_t servoEaseFromName(const char *name, uint8_t default_ease);
+
+#endif // _STACKCHAN_EASING_H_
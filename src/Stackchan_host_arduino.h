@@ -0,0 +1,212 @@
+// Copyright (c) 2022 Takao Akaki
+
+#ifndef _STACKCHAN_HOST_ARDUINO_H_
+#define _STACKCHAN_HOST_ARDUINO_H_
+
+#ifndef ARDUINO
+// 設定ファイルの読み込み(StackchanSystemConfig)をホストで動かすための、ArduinoのAPIの代替定義です。
+// ライブラリのソースとArduinoJson, YAMLDuinoは全てこのファイルの定義を使います。
+// (ホストの<Arduino.h>はStackchan_platform.hを読み込むだけにしてください。例: examples/ConfigBench/include/Arduino.h)
+// 実装はStackchan_platform_native.cppにあります。
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+class String {
+    protected:
+        std::string _str;
+    public:
+        String() {}
+        String(const char *str) : _str((str != nullptr) ? str : "") {}
+        String(const std::string &str) : _str(str) {}
+        explicit String(int value) : _str(std::to_string(value)) {}
+        const char* c_str() const { return _str.c_str(); }
+        unsigned int length() const { return _str.length(); }
+        bool reserve(unsigned int size) { _str.reserve(size); return true; }
+        bool concat(const char *str) { if (str == nullptr) return false; _str += str; return true; }
+        bool concat(const char *str, unsigned int length) { if (str == nullptr) return false; _str.append(str, length); return true; }
+        bool concat(char c) { _str += c; return true; }
+        bool concat(const String &str) { _str += str._str; return true; }
+        String& operator+=(const String &str) { concat(str); return *this; }
+        String& operator+=(const char *str) { concat(str); return *this; }
+        String& operator+=(char c) { concat(c); return *this; }
+        int compareTo(const String &str) const { return _str.compare(str._str); }
+        bool equals(const String &str) const { return _str == str._str; }
+        bool operator==(const String &str) const { return _str == str._str; }
+        bool operator!=(const String &str) const { return _str != str._str; }
+        bool operator==(const char *str) const { return _str == ((str != nullptr) ? str : ""); }
+        bool operator!=(const char *str) const { return !(*this == str); }
+        char operator[](unsigned int index) const { return (index < _str.length()) ? _str[index] : '\0'; }
+        int indexOf(char c, unsigned int from = 0) const { size_t pos = _str.find(c, from); return (pos == std::string::npos) ? -1 : (int)pos; }
+        int indexOf(const char *str, unsigned int from = 0) const { size_t pos = _str.find(str, from); return (pos == std::string::npos) ? -1 : (int)pos; }
+        bool startsWith(const char *str) const { return _str.compare(0, strlen(str), str) == 0; }
+        String substring(unsigned int begin, unsigned int end = UINT32_MAX) const {
+            return (begin < _str.length()) ? String(_str.substr(begin, (end > begin) ? end - begin : 0)) : String();
+        }
+        long toInt() const { return atol(_str.c_str()); }
+};
+class StringSumHelper : public String {
+    public:
+        StringSumHelper(const String &str) : String(str) {}
+        StringSumHelper(const char *str) : String(str) {}
+};
+inline StringSumHelper operator+(const String &lhs, const String &rhs) { StringSumHelper sum(lhs); sum += rhs; return sum; }
+inline StringSumHelper operator+(const String &lhs, const char *rhs) { StringSumHelper sum(lhs); sum += rhs; return sum; }
+
+class Print {
+    public:
+        virtual ~Print() {}
+        virtual size_t write(uint8_t c) = 0;
+        virtual size_t write(const uint8_t *buffer, size_t size);
+        size_t write(const char *str) { return write((const uint8_t *)str, strlen(str)); }
+        size_t print(const char *str) { return write(str); }
+        size_t print(const String &str) { return write(str.c_str()); }
+        size_t println(const char *str = "") { return write(str) + write("\n"); }
+        size_t println(const String &str) { return println(str.c_str()); }
+        int printf(const char *format, ...);
+        virtual void flush() {}
+};
+
+class Stream : public Print {
+    public:
+        virtual int available() = 0;
+        virtual int read() = 0;
+        virtual int peek() = 0;
+        size_t readBytes(char *buffer, size_t length);
+        size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+};
+
+// 標準出力に書き込みます。入力はありません。
+class StackchanHostSerial : public Stream {
+    public:
+        size_t write(uint8_t c) override { return fwrite(&c, 1, 1, stdout); }
+        size_t write(const uint8_t *buffer, size_t size) override { return fwrite(buffer, 1, size, stdout); }
+        int available() override { return 0; }
+        int read() override { return -1; }
+        int peek() override { return -1; }
+        using Print::write;
+};
+extern StackchanHostSerial Serial;
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+// メモリ上のファイルの内容と更新日時
+typedef struct HostFileData {
+    std::string data;
+    time_t last_write;
+} host_file_data_s;
+
+class File : public Stream {
+    protected:
+        std::shared_ptr<host_file_data_s> _file;
+        size_t _pos;
+        bool _writable;
+    public:
+        File() : _pos(0), _writable(false) {}
+        File(std::shared_ptr<host_file_data_s> file, bool writable) : _file(file), _pos(0), _writable(writable) {}
+        explicit operator bool() const { return (bool)_file; }
+        size_t write(uint8_t c) override { return write(&c, 1); }
+        size_t write(const uint8_t *buffer, size_t size) override;
+        int available() override { return _file ? (int)(_file->data.size() - _pos) : 0; }
+        int read() override { return (available() > 0) ? (uint8_t)_file->data[_pos++] : -1; }
+        int peek() override { return (available() > 0) ? (uint8_t)_file->data[_pos] : -1; }
+        size_t read(uint8_t *buffer, size_t size) { return readBytes(buffer, size); }
+        size_t size() const { return _file ? _file->data.size() : 0; }
+        time_t getLastWrite() const { return _file ? _file->last_write : 0; }
+        void close() { _file.reset(); }
+        using Print::write;
+};
+
+// メモリ上のファイルシステム(SD, SPIFFSの代わりにホストで使用します)
+class FS {
+    protected:
+        std::map<std::string, std::shared_ptr<host_file_data_s>> _files;
+    public:
+        File open(const char *path, const char *mode = FILE_READ, bool create = false);
+        File open(const String &path, const char *mode = FILE_READ, bool create = false) {
+            return open(path.c_str(), mode, create);
+        }
+        bool exists(const char *path) { return _files.count(path) > 0; }
+        bool exists(const String &path) { return exists(path.c_str()); }
+        bool remove(const char *path) { return _files.erase(path) > 0; }
+        bool remove(const String &path) { return remove(path.c_str()); }
+};
+
+} // namespace fs
+using fs::FS;
+using fs::File;
+
+#ifndef STACKCHAN_HOST_HEAP_SIZE
+#define STACKCHAN_HOST_HEAP_SIZE (320 * 1024)   // ESP32の内部RAMのヒープ相当(byte)
+#endif
+
+// ヒープの確保の記録(ホストでmalloc/freeを置き換えた場合にstackchanHostTrackAlloc/Freeで数えます)
+typedef struct HostHeapStats {
+    uint32_t alloc_count;
+    uint32_t free_count;
+    size_t used;
+    size_t peak;                                     // stackchanHostResetHeapPeak()からの最大使用量
+} host_heap_stats_s;
+
+void stackchanHostTrackAlloc(size_t size);
+void stackchanHostTrackFree(size_t size);
+void stackchanHostResetHeapPeak();
+const host_heap_stats_s* stackchanHostGetHeapStats();
+
+// ESP.getFreeHeap()などは、STACKCHAN_HOST_HEAP_SIZEと記録した使用量から求めます。
+class EspClass {
+    public:
+        uint32_t getHeapSize() { return STACKCHAN_HOST_HEAP_SIZE; }
+        uint32_t getFreeHeap();
+        uint32_t getMinFreeHeap();
+        uint32_t getMaxAllocHeap() { return getFreeHeap(); }
+};
+extern EspClass ESP;
+
+namespace lgfx {
+struct IFont {};
+}
+namespace fonts {
+extern const lgfx::IFont Font0;
+extern const lgfx::IFont efontJA_16;
+extern const lgfx::IFont efontCN_16;
+}
+
+// ArduinoJson(ARDUINOJSON_ENABLE_ARDUINO_STRING/STREAM/PRINT)とYAMLDuinoが呼び出すメンバーが、
+// Arduinoと同じ形で使えることをビルド時に確認します。
+namespace stackchan_host_check {
+template<typename T> using StringCStr = decltype(std::declval<const T&>().c_str());
+template<typename T> using StringLength = decltype(std::declval<const T&>().length());
+template<typename T> using StringConcat = decltype(std::declval<T&>().concat(std::declval<const char*>()));
+template<typename T> using StreamReadBytes = decltype(std::declval<T&>().readBytes(std::declval<char*>(), size_t()));
+template<typename T> using PrintWrite = decltype(std::declval<T&>().write(std::declval<const uint8_t*>(), size_t()));
+template<typename T> using PrintWriteByte = decltype(std::declval<T&>().write(uint8_t()));
+
+static_assert(std::is_same<StringCStr<String>, const char*>::value, "String::c_str() const -> const char*");
+static_assert(std::is_unsigned<StringLength<String>>::value, "String::length() const -> unsigned");
+static_assert(std::is_same<StringConcat<String>, bool>::value, "String::concat(const char*) -> bool");
+static_assert(std::is_assignable<String&, const char*>::value, "String = const char* (nullptr is \"\")");
+static_assert(std::is_base_of<String, StringSumHelper>::value, "StringSumHelper : String");
+static_assert(std::is_same<StreamReadBytes<Stream>, size_t>::value, "Stream::readBytes(char*, size_t) -> size_t");
+static_assert(std::is_same<decltype(std::declval<Stream&>().read()), int>::value, "Stream::read() -> int");
+static_assert(std::is_same<decltype(std::declval<Stream&>().available()), int>::value, "Stream::available() -> int");
+static_assert(std::is_same<decltype(std::declval<Stream&>().peek()), int>::value, "Stream::peek() -> int");
+static_assert(std::is_same<PrintWrite<Print>, size_t>::value, "Print::write(const uint8_t*, size_t) -> size_t");
+static_assert(std::is_same<PrintWriteByte<Print>, size_t>::value, "Print::write(uint8_t) -> size_t");
+static_assert(std::is_base_of<Stream, fs::File>::value && std::is_base_of<Print, Stream>::value, "File : Stream : Print");
+}
+
+#endif // ARDUINO
+#endif // _STACKCHAN_HOST_ARDUINO_H_
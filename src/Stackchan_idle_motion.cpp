@@ -0,0 +1,91 @@
+// Copyright (c) Takao Akaki
+#include "Stackchan_idle_motion.h"
+
+StackchanIdleMotion::StackchanIdleMotion() : _servo(nullptr), _mode(NORMAL), _enabled(false), _scheduled(false),
+                                             _next_millis(0), _random_state(1), _move_count(0) {
+  // StackchanSystemConfigの初期値と同じです。
+  _interval[NORMAL]  = { "normal", 5000, 10000, 500, 1500 };
+  _interval[SINGING] = { "sing_mode", 1000, 2000, 500, 1500 };
+  memset(_range_min, 0, sizeof(_range_min));
+  memset(_range_max, 0, sizeof(_range_max));
+}
+
+void StackchanIdleMotion::begin(StackchanSERVO *servo, uint32_t seed) {
+  _servo = servo;
+  for (int axis = AXIS_X; axis <= AXIS_Y; axis++) {
+    const servo_param_s *param = servo->getServoParam((ServoAxis)axis);
+    if (param->lower_limit < param->upper_limit) {
+      setRange((ServoAxis)axis, param->lower_limit, param->upper_limit);
+    } else {
+      setRange((ServoAxis)axis, param->start_degree - IDLE_MOTION_DEFAULT_RANGE, param->start_degree + IDLE_MOTION_DEFAULT_RANGE);
+    }
+  }
+  setSeed(seed);
+  _enabled = true;
+  _scheduled = false;
+}
+
+void StackchanIdleMotion::setSeed(uint32_t seed) {
+  _random_state = (seed == 0) ? 1 : seed;  // xorshiftは0から抜けられないため
+}
+
+uint32_t StackchanIdleMotion::nextRandom() {
+  uint32_t x = _random_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  _random_state = x;
+  return x;
+}
+
+int32_t StackchanIdleMotion::randomRange(int32_t lower, int32_t upper) {
+  if (upper < lower) {
+    int32_t tmp = lower;
+    lower = upper;
+    upper = tmp;
+  }
+  return lower + (int32_t)(nextRandom() % (uint32_t)(upper - lower + 1));
+}
+
+void StackchanIdleMotion::setInterval(AvatarMode mode, const servo_interval_s *interval) {
+  _interval[mode] = *interval;
+  if (mode == _mode) _scheduled = false;
+}
+
+void StackchanIdleMotion::setRange(ServoAxis axis, int16_t range_min, int16_t range_max) {
+  _range_min[axis] = min(range_min, range_max);
+  _range_max[axis] = max(range_min, range_max);
+}
+
+void StackchanIdleMotion::setAvatarMode(AvatarMode mode) {
+  if (mode == _mode) return;
+  _mode = mode;
+  _scheduled = false;
+}
+
+void StackchanIdleMotion::setEnabled(bool enabled) {
+  _enabled = enabled;
+  _scheduled = false;
+}
+
+void StackchanIdleMotion::tick(uint32_t now) {
+  if (!_enabled || (_servo == nullptr)) return;
+  if (_servo->isMoving()) {
+    // 移動中(他のモーションを含む)は、止まってから次の待ち時間を決めます。
+    _scheduled = false;
+    return;
+  }
+  const servo_interval_s *interval = &_interval[_mode];
+  if (!_scheduled) {
+    _next_millis = now + randomRange(interval->interval_min, interval->interval_max);
+    _scheduled = true;
+    return;
+  }
+  if ((int32_t)(now - _next_millis) < 0) return;
+  int x = randomRange(_range_min[AXIS_X], _range_max[AXIS_X]);
+  int y = randomRange(_range_min[AXIS_Y], _range_max[AXIS_Y]);
+  uint32_t millis_for_move = randomRange(interval->move_min, interval->move_max);
+  _servo->moveXYAsync(x, y, millis_for_move);
+  _scheduled = false;
+  _move_count++;
+}
@@ -0,0 +1,62 @@
+// Copyright (c) 2022 Takao Akaki
+
+#ifndef _STACKCHAN_IDLE_MOTION_H_
+#define _STACKCHAN_IDLE_MOTION_H_
+
+#include "Stackchan_servo.h"
+
+#ifndef IDLE_MOTION_DEFAULT_RANGE
+#define IDLE_MOTION_DEFAULT_RANGE   20     // 可動範囲が未設定の場合に初期位置から動かす範囲(+-deg)
+#endif
+#define AVATAR_MODE_NUM             2
+
+typedef struct ServoInterval {
+    // 下記のminとmaxの間でランダムの値を取ります。
+    const char *mode_name;
+    uint32_t interval_min; // サーボが停止する間隔（最小）
+    uint32_t interval_max; // サーボが停止する間隔（最大）
+    uint32_t move_min;     // サーボが移動する時間（最小）
+    uint32_t move_max;     // サーボが移動する時間（最大）
+} servo_interval_s;
+
+enum AvatarMode {
+    NORMAL,
+    SINGING
+};
+
+// 待機中にランダムな方向を見回す動作のスケジューラ
+// AvatarModeごとのservo_interval_sの間隔・移動時間で、可動範囲内のランダムな角度へmoveXYAsyncします。
+// tick()はすぐに戻ります。同じシードなら同じ順序で動くので、ホスト上で動作を確認できます。
+class StackchanIdleMotion {
+    protected:
+        StackchanSERVO *_servo;
+        servo_interval_s _interval[AVATAR_MODE_NUM];
+        int16_t _range_min[2];                           // 軸ごとの見回す範囲
+        int16_t _range_max[2];
+        AvatarMode _mode;
+        bool _enabled;
+        bool _scheduled;                                 // 次に動き出す時刻を決めた状態
+        uint32_t _next_millis;                           // 次に動き出す時刻(msec)
+        uint32_t _random_state;                          // 乱数(xorshift32)の状態
+        uint32_t _move_count;
+        uint32_t nextRandom();
+    public:
+        StackchanIdleMotion();
+        // 見回す範囲はサーボの可動範囲(lower_limit〜upper_limit)、未設定の場合は初期位置から+-IDLE_MOTION_DEFAULT_RANGEです。
+        void begin(StackchanSERVO *servo, uint32_t seed = 1);
+        void setSeed(uint32_t seed);
+        void setInterval(AvatarMode mode, const servo_interval_s *interval);
+        void setRange(ServoAxis axis, int16_t range_min, int16_t range_max);
+        // モードを切り替えた場合は、新しいモードの間隔で次の動作を決め直します。
+        void setAvatarMode(AvatarMode mode);
+        AvatarMode getAvatarMode() { return _mode; }
+        void setEnabled(bool enabled);
+        bool isEnabled() { return _enabled; }
+        // サーボが止まっている間に次の時刻になったら移動を開始します。StackchanSERVO::tick()と同じ周期で呼び出してください。
+        void tick(uint32_t now);
+        uint32_t getMoveCount() { return _move_count; }
+        // lower〜upper(upperを含む)の乱数を返します。
+        int32_t randomRange(int32_t lower, int32_t upper);
+};
+
+#endif // _STACKCHAN_IDLE_MOTION_H_
@@ -0,0 +1,198 @@
+// Copyright (c) Takao Akaki
+#include "Stackchan_motion.h"
+#include "Stackchan_servo_driver.h"
+
+#ifdef ARDUINO
+#include <ArduinoJson.h>
+#include <YAMLDuino.h>
+#endif
+
+// 組み込みのモーション(従来のStackchanSERVO::motion()と同じ動き)
+static const motion_keyframe_s BUILTIN_GREET[] = {
+    {    0, 1000, AXIS_Y, SERVO_EASE_QUAD,  90 },
+    { 1000, 1000, AXIS_Y, SERVO_EASE_QUAD,  75 },
+};
+static const motion_keyframe_s BUILTIN_LAUGH[] = {
+    {    0,  500, AXIS_Y, SERVO_EASE_QUAD,  80 },
+    {  500,  500, AXIS_Y, SERVO_EASE_QUAD,  60 },
+};
+static const motion_keyframe_s BUILTIN_NOD[] = {
+    {    0, 1000, AXIS_Y, SERVO_EASE_QUAD,  90 },
+    { 1000, 1000, AXIS_Y, SERVO_EASE_QUAD,  60 },
+};
+static const motion_keyframe_s BUILTIN_REFUSE[] = {
+    {    0,  500, AXIS_X, SERVO_EASE_QUAD,  70 },
+    {  500,  500, AXIS_X, SERVO_EASE_QUAD, 110 },
+};
+static const motion_keyframe_s BUILTIN_TEST[] = {
+    {    0, 1000, AXIS_X, SERVO_EASE_QUAD,  45 },
+    { 1000, 1000, AXIS_X, SERVO_EASE_QUAD, 135 },
+    { 2000, 1000, AXIS_X, SERVO_EASE_QUAD,  90 },
+    { 3000, 1000, AXIS_Y, SERVO_EASE_QUAD,  50 },
+    { 4000, 1000, AXIS_Y, SERVO_EASE_QUAD,  90 },
+};
+
+#define BUILTIN_MOTION(name, keyframes, period, repeat) \
+    { name, keyframes, sizeof(keyframes) / sizeof(keyframes[0]), period, repeat }
+
+static const motion_entry_s BUILTIN_MOTIONS[] = {
+    BUILTIN_MOTION("greet",  BUILTIN_GREET,  2000, 1),
+    BUILTIN_MOTION("laugh",  BUILTIN_LAUGH,  1000, 5),
+    BUILTIN_MOTION("nod",    BUILTIN_NOD,    2000, 5),
+    BUILTIN_MOTION("refuse", BUILTIN_REFUSE, 1000, 2),
+    BUILTIN_MOTION("test",   BUILTIN_TEST,   5000, 1),
+};
+
+static const motion_settings_s DEFAULT_MOTION_SETTINGS = { 90, 75, 500, 1000, 1000 };
+
+StackchanMotionLibrary::StackchanMotionLibrary() {
+  clear();
+}
+
+void StackchanMotionLibrary::clear() {
+  _keyframe_num = 0;
+  _motion_num = 0;
+  _settings = DEFAULT_MOTION_SETTINGS;
+}
+
+bool StackchanMotionLibrary::addMotion(const char *name, uint8_t repeat, const motion_keyframe_s *keyframes, uint16_t keyframe_num) {
+  // 切り詰めて登録するとfind()で見つからなくなるので、長い名前は登録しません。
+  if ((name == nullptr) || (strlen(name) >= MOTION_NAME_LENGTH)) {
+    M5_LOGE("motion:%s name too long (MOTION_NAME_LENGTH:%d)", (name != nullptr) ? name : "", MOTION_NAME_LENGTH);
+    return false;
+  }
+  // 置き換えた場合も古いキーフレームの領域は再利用しません。(clear()で解放)
+  if (_keyframe_num + keyframe_num > MOTION_KEYFRAME_MAX) {
+    M5_LOGE("motion:%s MOTION_KEYFRAME_MAX(%d) exceeded", name, MOTION_KEYFRAME_MAX);
+    return false;
+  }
+  motion_entry_s *entry = nullptr;
+  for (int i=0; i<_motion_num; i++) {
+    if (strncmp(_motions[i].name, name, MOTION_NAME_LENGTH) == 0) {
+      entry = &_motions[i];
+      break;
+    }
+  }
+  if (entry == nullptr) {
+    if (_motion_num >= MOTION_MAX) {
+      M5_LOGE("motion:%s MOTION_MAX(%d) exceeded", name, MOTION_MAX);
+      return false;
+    }
+    entry = &_motions[_motion_num++];
+  }
+  motion_keyframe_s *dst = &_keyframes[_keyframe_num];
+  uint16_t period = 0;
+  for (int i=0; i<keyframe_num; i++) {
+    // startの昇順に並べて追加します。(挿入ソート, keyframesとdstが同じ領域でも可)
+    motion_keyframe_s kf = keyframes[i];
+    int j = i;
+    while ((j > 0) && (dst[j - 1].start > kf.start)) {
+      dst[j] = dst[j - 1];
+      j--;
+    }
+    dst[j] = kf;
+    period = max(period, (uint16_t)(kf.start + kf.millis_for_move));
+  }
+  _keyframe_num += keyframe_num;
+  strcpy(entry->name, name);
+  entry->keyframes = dst;
+  entry->keyframe_num = keyframe_num;
+  entry->period = period;
+  entry->repeat = (repeat == 0) ? 1 : repeat;
+  return true;
+}
+
+const motion_entry_s* StackchanMotionLibrary::find(const char *name) {
+  for (int i=0; i<_motion_num; i++) {
+    if (strncmp(_motions[i].name, name, MOTION_NAME_LENGTH) == 0) {
+      return &_motions[i];
+    }
+  }
+  return findBuiltin(name);
+}
+
+const motion_entry_s* StackchanMotionLibrary::findBuiltin(const char *name) {
+  for (size_t i=0; i<sizeof(BUILTIN_MOTIONS) / sizeof(BUILTIN_MOTIONS[0]); i++) {
+    if (strncmp(BUILTIN_MOTIONS[i].name, name, MOTION_NAME_LENGTH) == 0) {
+      return &BUILTIN_MOTIONS[i];
+    }
+  }
+  return nullptr;
+}
+
+const motion_settings_s* StackchanMotionLibrary::getDefaultSettings() {
+  return &DEFAULT_MOTION_SETTINGS;
+}
+
+#ifdef ARDUINO
+static uint8_t parseEase(const char *ease) {
+  return servoEaseFromName(ease, SERVO_EASE_QUAD);
+}
+
+// モーションファイル(YAMLまたはJSON)を読み込みます。書式はdata/yaml/SC_Motion.yamlを参照してください。
+bool StackchanMotionLibrary::loadMotionFile(fs::FS& fs, const char *yaml_filename, uint32_t yaml_size) {
+  M5_LOGI("----- StackchanMotionLibrary::loadMotionFile:%s\n", yaml_filename);
+  File file = fs.open(yaml_filename);
+  if (!file) {
+    M5_LOGI("Motion file not found. builtin motions are used.");
+    return false;
+  }
+  // ArduinoJson 7のJsonDocumentは必要なだけ広がるので、yaml_sizeは使用しません。
+  JsonDocument doc;
+  auto err = deserializeYml(doc, file);
+  file.close();
+  if (!err && doc.overflowed()) err = DeserializationError::NoMemory;
+  if (err) {
+    M5_LOGE("yaml file read error: %s\n", yaml_filename);
+    M5_LOGE("error%s\n", err.c_str());
+    return false;
+  }
+  clear();
+  JsonObject settings = doc["motion_settings"];
+  if (!settings.isNull()) {
+    _settings.start_x     = settings["start_pose"]["x"] | DEFAULT_MOTION_SETTINGS.start_x;
+    _settings.start_y     = settings["start_pose"]["y"] | DEFAULT_MOTION_SETTINGS.start_y;
+    _settings.start_time  = settings["start_pose"]["time"] | DEFAULT_MOTION_SETTINGS.start_time;
+    _settings.end_wait    = settings["end_wait"] | DEFAULT_MOTION_SETTINGS.end_wait;
+    _settings.return_time = settings["return_time"] | DEFAULT_MOTION_SETTINGS.return_time;
+  }
+  // キーフレームは「t(msec)の時点でその角度に到達する」という書式なので、
+  // 軸ごとに直前のキーフレームの時刻から開始時刻と移動時間を求めます。
+  // 一時領域を使わず、_keyframesの空き領域に直接展開してからaddMotion()で並べ替えます。
+  for (JsonPair motion : doc["motions"].as<JsonObject>()) {
+    motion_keyframe_s *keyframes = &_keyframes[_keyframe_num];
+    uint16_t keyframe_max = MOTION_KEYFRAME_MAX - _keyframe_num;
+    uint16_t keyframe_num = 0;
+    uint16_t last_time[2] = { 0, 0 };
+    bool overflow = false;
+    for (JsonObject item : motion.value()["keyframes"].as<JsonArray>()) {
+      uint16_t t = item["t"];
+      uint8_t ease = parseEase(item["ease"]);
+      const char *axis_key[2] = { "x", "y" };
+      for (int axis = AXIS_X; axis <= AXIS_Y; axis++) {
+        if (!item[axis_key[axis]].is<int>()) continue;
+        if (keyframe_num >= keyframe_max) {
+          overflow = true;
+          break;
+        }
+        motion_keyframe_s *kf = &keyframes[keyframe_num++];
+        kf->start = last_time[axis];
+        kf->millis_for_move = (t > last_time[axis]) ? t - last_time[axis] : 0;
+        kf->axis = axis;
+        kf->ease = ease;
+        kf->degree = item[axis_key[axis]];
+        last_time[axis] = t;
+      }
+      if (overflow) break;
+    }
+    if (overflow) {
+      // 途中までのキーフレームで再生すると動きが変わるので、このモーションは登録しません。
+      M5_LOGE("motion:%s MOTION_KEYFRAME_MAX(%d) exceeded, skipped", motion.key().c_str(), MOTION_KEYFRAME_MAX);
+      continue;
+    }
+    addMotion(motion.key().c_str(), motion.value()["repeat"] | 1, keyframes, keyframe_num);
+  }
+  M5_LOGI("motions:%d keyframes:%d", _motion_num, _keyframe_num);
+  return true;
+}
+#endif
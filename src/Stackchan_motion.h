@@ -0,0 +1,77 @@
+// Copyright (c) 2022 Takao Akaki
+
+#ifndef _STACKCHAN_MOTION_H_
+#define _STACKCHAN_MOTION_H_
+
+#include "Stackchan_platform.h"
+#include "Stackchan_easing.h"
+#ifdef ARDUINO
+#include <FS.h>
+#endif
+
+#ifndef MOTION_KEYFRAME_MAX
+#define MOTION_KEYFRAME_MAX    256     // ファイルから読み込めるキーフレームの最大数
+#endif
+#ifndef MOTION_MAX
+#define MOTION_MAX             16      // ファイルから読み込めるモーションの最大数
+#endif
+#define MOTION_NAME_LENGTH     16      // モーション名の最大長('\0'を含む)
+
+// キーフレーム(startの時刻からmillis_for_moveかけてaxisをdegreeへ移動)
+// 1つのモーションのキーフレームはstartの昇順に並んでいます。
+typedef struct MotionKeyframe {
+    uint16_t start;                    // 繰り返し1回分の開始からの時刻(msec)
+    uint16_t millis_for_move;          // 移動時間(msec)
+    uint8_t axis;                      // ServoAxis
+    uint8_t ease;                      // ServoEase
+    int16_t degree;                    // 目標角度
+} motion_keyframe_s;
+
+typedef struct MotionEntry {
+    char name[MOTION_NAME_LENGTH];
+    const motion_keyframe_s *keyframes;
+    uint16_t keyframe_num;
+    uint16_t period;                   // 繰り返し1回分の長さ(msec)
+    uint8_t repeat;                    // 繰り返し回数
+} motion_entry_s;
+
+// モーションの前後の動き(全モーション共通)
+typedef struct MotionSettings {
+    int16_t start_x;                   // モーション開始前に移動する角度
+    int16_t start_y;
+    uint16_t start_time;               // 開始位置への移動時間(msec)
+    uint16_t end_wait;                 // モーション終了後、初期位置へ戻るまでの待ち時間(msec)
+    uint16_t return_time;              // 初期位置へ戻る移動時間(msec)
+} motion_settings_s;
+
+// キーフレームで記述したモーションの一覧
+// 組み込みのモーション(greet, laugh, nod, refuse, test)を持ち、YAML(JSON)ファイルから追加・上書きできます。
+// 読み込んだキーフレームはすべてこのクラス内の固定長の配列に格納し、再生時にヒープを使いません。
+class StackchanMotionLibrary {
+    protected:
+        motion_keyframe_s _keyframes[MOTION_KEYFRAME_MAX];
+        motion_entry_s _motions[MOTION_MAX];
+        uint16_t _keyframe_num;
+        uint8_t _motion_num;
+        motion_settings_s _settings;
+    public:
+        StackchanMotionLibrary();
+        void clear();
+        // キーフレームをコピーして追加します。同じ名前のモーションがあれば置き換えます。
+        // 名前がMOTION_NAME_LENGTH-1文字より長い場合と、キーフレームが入りきらない場合は追加せずにfalseを返します。
+        bool addMotion(const char *name, uint8_t repeat, const motion_keyframe_s *keyframes, uint16_t keyframe_num);
+        const motion_entry_s* find(const char *name);
+        const motion_settings_s* getSettings() { return &_settings; }
+        void setSettings(motion_settings_s settings) { _settings = settings; }
+        uint8_t getMotionNum() { return _motion_num; }
+#ifdef ARDUINO
+        // キーフレームが入りきらないモーションと、名前が長すぎるモーションはログに出して読み込みません。(yaml_sizeは使用しません)
+        bool loadMotionFile(fs::FS& fs, const char *yaml_filename = "/yaml/SC_Motion.yaml", uint32_t yaml_size = 8192);
+#endif
+
+        // 組み込みのモーション
+        static const motion_entry_s* findBuiltin(const char *name);
+        static const motion_settings_s* getDefaultSettings();
+};
+
+#endif // _STACKCHAN_MOTION_H_
@@ -0,0 +1,127 @@
+// Copyright (c) Takao Akaki
+#include "Stackchan_motion_recording.h"
+
+// ファイルの先頭に置くヘッダ(続けて_lengthバイトのデータ)
+typedef struct MotionRecordingHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t interval;
+    uint16_t sample_num;
+    uint16_t length;
+} motion_recording_header_s;
+
+StackchanMotionRecording::StackchanMotionRecording() {
+  clear();
+}
+
+void StackchanMotionRecording::clear(uint16_t interval) {
+  _length = 0;
+  _sample_num = 0;
+  _interval = (interval > 0) ? interval : MOTION_RECORDING_INTERVAL;
+  _last[0] = 0;
+  _last[1] = 0;
+}
+
+// ZigZag符号化(0, -1, 1, -2, ... を 0, 1, 2, 3, ... に対応させる)した値を7bitずつ書き込みます。
+bool StackchanMotionRecording::writeVarint(uint16_t *offset, int32_t value) {
+  uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+  do {
+    if (*offset >= MOTION_RECORDING_BUFFER_SIZE) return false;
+    uint8_t byte = zigzag & 0x7F;
+    zigzag >>= 7;
+    _buffer[(*offset)++] = (zigzag != 0) ? (byte | 0x80) : byte;
+  } while (zigzag != 0);
+  return true;
+}
+
+bool StackchanMotionRecording::append(int16_t x, int16_t y) {
+  uint16_t offset = _length;
+  if (_sample_num == 0) {
+    if (offset + 4 > MOTION_RECORDING_BUFFER_SIZE) return false;
+    memcpy(&_buffer[offset], &x, 2);
+    memcpy(&_buffer[offset + 2], &y, 2);
+    offset += 4;
+  } else if (!writeVarint(&offset, x - _last[0]) || !writeVarint(&offset, y - _last[1])) {
+    return false;
+  }
+  _length = offset;
+  _last[0] = x;
+  _last[1] = y;
+  _sample_num++;
+  return true;
+}
+
+uint16_t StackchanMotionRecording::readSample(uint16_t offset, int16_t *value) const {
+  if (offset >= _length) return 0;
+  if (offset == 0) {
+    memcpy(&value[0], &_buffer[0], 2);
+    memcpy(&value[1], &_buffer[2], 2);
+    return 4;
+  }
+  for (int axis = 0; axis < 2; axis++) {
+    uint32_t zigzag = 0;
+    uint8_t shift = 0;
+    uint8_t byte;
+    do {
+      if ((offset >= _length) || (shift > 28)) return 0;
+      byte = _buffer[offset++];
+      zigzag |= (uint32_t)(byte & 0x7F) << shift;
+      shift += 7;
+    } while (byte & 0x80);
+    value[axis] += (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+  }
+  return offset;
+}
+
+#ifdef ARDUINO
+bool StackchanMotionRecording::save(fs::FS& fs, const char *filename) {
+  File file = fs.open(filename, FILE_WRITE);
+  if (!file) {
+    M5_LOGE("recording file open error: %s", filename);
+    return false;
+  }
+  motion_recording_header_s header = { MOTION_RECORDING_MAGIC, MOTION_RECORDING_VERSION, _interval, _sample_num, _length };
+  bool ok = (file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header))
+         && (file.write(_buffer, _length) == _length);
+  file.close();
+  if (!ok) {
+    M5_LOGE("recording file write error: %s", filename);
+  }
+  return ok;
+}
+
+bool StackchanMotionRecording::load(fs::FS& fs, const char *filename) {
+  File file = fs.open(filename);
+  if (!file) {
+    M5_LOGE("recording file not found: %s", filename);
+    return false;
+  }
+  motion_recording_header_s header;
+  bool ok = (file.read((uint8_t*)&header, sizeof(header)) == sizeof(header))
+         && (header.magic == MOTION_RECORDING_MAGIC);
+  if (ok && (header.version != MOTION_RECORDING_VERSION)) {
+    // 0.1°単位で記録した古いファイルは変換しません。記録し直してください。
+    M5_LOGE("recording file version:%d is not supported, record again: %s", header.version, filename);
+    file.close();
+    clear();
+    return false;
+  }
+  ok = ok && (header.length <= MOTION_RECORDING_BUFFER_SIZE)
+          && (file.read(_buffer, header.length) == header.length);
+  file.close();
+  if (!ok) {
+    M5_LOGE("recording file read error: %s", filename);
+    clear();
+    return false;
+  }
+  _interval = header.interval;
+  _sample_num = header.sample_num;
+  _length = header.length;
+  // 続けてappend()できるように最後のサンプルを求めておきます。
+  uint16_t offset = 0;
+  for (uint16_t i = 0; i < _sample_num; i++) {
+    offset = readSample(offset, _last);
+  }
+  return true;
+}
+#endif
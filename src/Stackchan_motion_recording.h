@@ -0,0 +1,49 @@
+// Copyright (c) 2022 Takao Akaki
+
+#ifndef _STACKCHAN_MOTION_RECORDING_H_
+#define _STACKCHAN_MOTION_RECORDING_H_
+
+#include "Stackchan_platform.h"
+#ifdef ARDUINO
+#include <FS.h>
+#endif
+
+#ifndef MOTION_RECORDING_BUFFER_SIZE
+#define MOTION_RECORDING_BUFFER_SIZE  4096    // 記録用バッファのサイズ(byte) 50msec間隔で1分半程度
+#endif
+#ifndef MOTION_RECORDING_INTERVAL
+#define MOTION_RECORDING_INTERVAL     50      // 現在位置を記録する間隔(msec)
+#endif
+#define MOTION_RECORDING_MAGIC        0x43524353  // "SCRC"
+#define MOTION_RECORDING_VERSION      2       // 1: 0.1°単位(読み込めません), 2: 1°単位
+
+// 手で動かした姿勢を一定間隔で記録したもの(ティーチング)
+// 角度は非同期移動の目標と同じ1°単位で、最初のサンプルは絶対値(int16 x 2軸)、以降は前のサンプルとの差分を
+// ZigZag符号化した可変長整数(差分が±63°以内なら1軸1byte)で格納します。
+class StackchanMotionRecording {
+    protected:
+        uint8_t _buffer[MOTION_RECORDING_BUFFER_SIZE];
+        uint16_t _length;                                // 使用しているバイト数
+        uint16_t _sample_num;
+        uint16_t _interval;                              // サンプルの間隔(msec)
+        int16_t _last[2];                                // 最後に追加したサンプル(deg)
+        bool writeVarint(uint16_t *offset, int32_t value);
+    public:
+        StackchanMotionRecording();
+        void clear(uint16_t interval = MOTION_RECORDING_INTERVAL);
+        // サンプル(1°単位の角度)を追加します。バッファが一杯の場合はfalse
+        bool append(int16_t x, int16_t y);
+        uint16_t getSampleNum() const { return _sample_num; }
+        uint16_t getInterval() const { return _interval; }
+        uint16_t getLength() const { return _length; }
+        uint32_t getDuration() const { return (_sample_num > 0) ? (uint32_t)(_sample_num - 1) * _interval : 0; }
+        // offsetの位置のサンプルを読み出してvalue(前のサンプル)に反映し、次の位置を返します。最初のサンプルはoffset=0です。
+        // 読み出せない場合は0を返します。
+        uint16_t readSample(uint16_t offset, int16_t *value) const;
+#ifdef ARDUINO
+        bool save(fs::FS& fs, const char *filename);
+        bool load(fs::FS& fs, const char *filename);
+#endif
+};
+
+#endif // _STACKCHAN_MOTION_RECORDING_H_
@@ -0,0 +1,47 @@
+// Copyright (c) Takao Akaki
+#include "Stackchan_planner.h"
+
+int16_t clampServoDegree(int16_t degree, int16_t lower_limit, int16_t upper_limit) {
+  if (lower_limit >= upper_limit) return degree;
+  if (degree < lower_limit) return lower_limit;
+  if (degree > upper_limit) return upper_limit;
+  return degree;
+}
+
+uint32_t getMinimumMillisForMove(float distance, const servo_motion_limit_s *limit) {
+  float v = limit->max_velocity;
+  float a = limit->max_acceleration;
+  float sec;
+  if (distance <= 0.0f) {
+    return 0;
+  } else if (a <= 0.0f) {
+    // 加速度の制限なし
+    if (v <= 0.0f) return 0;
+    sec = distance / v;
+  } else if ((v <= 0.0f) || (distance <= v * v / a)) {
+    // 最大速度に達しない(三角形)
+    sec = 2.0f * sqrtf(distance / a);
+  } else {
+    // 台形
+    sec = distance / v + v / a;
+  }
+  return (uint32_t)ceilf(sec * 1000.0f);
+}
+
+servo_plan_s planServoMove(int16_t from, int16_t to, uint32_t millis_for_move,
+                           int16_t lower_limit, int16_t upper_limit, const servo_motion_limit_s *limit) {
+  servo_plan_s plan;
+  plan.degree = clampServoDegree(to, lower_limit, upper_limit);
+  float distance = fabsf((float)(plan.degree - from));
+  plan.millis_for_move = max(millis_for_move, getMinimumMillisForMove(distance, limit));
+  plan.millis_for_accel = 0;
+  float a = limit->max_acceleration;
+  if ((a > 0.0f) && (distance > 0.0f) && (plan.millis_for_move > 0)) {
+    // 移動時間T, 距離Dで加速度aのとき、巡航速度 v = (aT - sqrt((aT)^2 - 4aD)) / 2, 加速時間 = v / a
+    float t = plan.millis_for_move / 1000.0f;
+    float d = (a * t) * (a * t) - 4.0f * a * distance;
+    float v = (a * t - sqrtf(max(d, 0.0f))) / 2.0f;
+    plan.millis_for_accel = min((uint32_t)ceilf(v / a * 1000.0f), plan.millis_for_move / 2);
+  }
+  return plan;
+}
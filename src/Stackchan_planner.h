@@ -0,0 +1,32 @@
+// Copyright (c) 2022 Takao Akaki
+
+#ifndef _STACKCHAN_PLANNER_H_
+#define _STACKCHAN_PLANNER_H_
+
+#include "Stackchan_platform.h"
+
+// 軸ごとの速度・加速度の上限
+typedef struct ServoMotionLimit {
+    float max_velocity;                // 最大速度(deg/sec) 0の場合は制限なし
+    float max_acceleration;            // 最大加速度(deg/sec^2) 0の場合は制限なし
+} servo_motion_limit_s;
+
+// 台形速度プロファイルによる移動計画
+typedef struct ServoPlan {
+    int16_t degree;                    // 可動範囲(lower_limit〜upper_limit)に収めた目標角度
+    uint32_t millis_for_move;          // 移動時間(msec) 指定より短くなることはありません
+    uint32_t millis_for_accel;         // 加速(減速)にかける時間(msec) 0の場合は加速度の制限なし
+} servo_plan_s;
+
+// lower_limit < upper_limitの場合のみ範囲内に収めます。(同じ値の場合は制限なし)
+int16_t clampServoDegree(int16_t degree, int16_t lower_limit, int16_t upper_limit);
+
+// distance(deg)を速度・加速度の上限内で移動するのに必要な最短時間(msec)を返します。
+uint32_t getMinimumMillisForMove(float distance, const servo_motion_limit_s *limit);
+
+// fromからtoへの移動を計画します。移動時間は最短時間以上に延ばし、加速時間は加速度が上限以下になるように求めます。
+servo_plan_s planServoMove(int16_t from, int16_t to, uint32_t millis_for_move,
+                           int16_t lower_limit, int16_t upper_limit, const servo_motion_limit_s *limit);
+// 位置の計算はtrapezoidEaseQ15(Stackchan_easing.h)で行います。
+
+#endif // _STACKCHAN_PLANNER_H_
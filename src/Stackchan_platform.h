@@ -0,0 +1,46 @@
+// Copyright (c) 2022 Takao Akaki
+
+#ifndef _STACKCHAN_PLATFORM_H_
+#define _STACKCHAN_PLATFORM_H_
+
+#ifdef ARDUINO
+
+#include <Ticker.h>
+#include <M5Unified.h>
+
+#else
+// ホスト(PlatformIOのnative環境)でサーボ関連と設定ファイルの読み込みのソースをビルドするための代替定義です。
+// 時間は仮想時計で、delay()やvTaskDelay()は待たずに仮想時計を進めます。
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+using std::max;
+using std::min;
+
+typedef uint32_t TickType_t;
+#define portTICK_PERIOD_MS 1
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+void vTaskDelayUntil(TickType_t *previous_wake_time, TickType_t increment);
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+// 仮想時計を進めます。(シミュレータがバスの送信時間などを加算するのに使用します。)
+void stackchanHostAdvanceMicros(uint32_t us);
+
+#define M5_LOGE(format, ...) printf("[E] " format "\n", ##__VA_ARGS__)
+#define M5_LOGW(format, ...) printf("[W] " format "\n", ##__VA_ARGS__)
+#define M5_LOGI(format, ...) printf("[I] " format "\n", ##__VA_ARGS__)
+#define M5_LOGD(format, ...) ((void)0)
+
+// String, Stream, fs::FS, ESPなどArduinoのAPIの代替定義(ArduinoJson, YAMLDuinoからも使います)
+#include "Stackchan_host_arduino.h"
+
+#endif // ARDUINO
+#endif // _STACKCHAN_PLATFORM_H_
@@ -0,0 +1,132 @@
+// Copyright (c) Takao Akaki
+#include "Stackchan_platform.h"
+#include <stdarg.h>
+
+#ifndef ARDUINO
+
+static uint64_t host_micros = 0;
+
+StackchanHostSerial Serial;
+
+uint32_t millis() { return (uint32_t)(host_micros / 1000); }
+
+uint32_t micros() { return (uint32_t)host_micros; }
+
+void delay(uint32_t ms) { host_micros += (uint64_t)ms * 1000; }
+
+void vTaskDelay(TickType_t ticks) { delay(ticks * portTICK_PERIOD_MS); }
+
+TickType_t xTaskGetTickCount() { return millis() / portTICK_PERIOD_MS; }
+
+void vTaskDelayUntil(TickType_t *previous_wake_time, TickType_t increment) {
+  *previous_wake_time += increment;
+  TickType_t now = xTaskGetTickCount();
+  if ((int32_t)(*previous_wake_time - now) > 0) {
+    vTaskDelay(*previous_wake_time - now);
+  }
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+void stackchanHostAdvanceMicros(uint32_t us) { host_micros += us; }
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--) n += write(*buffer++);
+  return n;
+}
+
+int Print::printf(const char *format, ...) {
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if (len < 0) return len;
+  if ((size_t)len < sizeof(buffer)) return write((const uint8_t *)buffer, len);
+  // 長い場合のみ確保します。
+  std::string str(len + 1, '\0');
+  va_start(args, format);
+  vsnprintf(&str[0], str.size(), format, args);
+  va_end(args);
+  return write((const uint8_t *)str.data(), len);
+}
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+  size_t n = 0;
+  while (n < length) {
+    int c = read();
+    if (c < 0) break;
+    buffer[n++] = (char)c;
+  }
+  return n;
+}
+
+namespace fs {
+
+// 更新日時は書き込むたびに必ず進めます。(同じ秒に書き換えてもキャッシュの確認で区別できるように)
+static time_t host_file_time = 0;
+
+size_t File::write(const uint8_t *buffer, size_t size) {
+  if (!_file || !_writable) return 0;
+  _file->data.append((const char *)buffer, size);
+  _file->last_write = host_file_time = max(time(nullptr), host_file_time + 1);
+  return size;
+}
+
+File FS::open(const char *path, const char *mode, bool create) {
+  auto it = _files.find(path);
+  if (mode[0] == 'r') {
+    if (it == _files.end()) return File();
+    return File(it->second, false);
+  }
+  std::shared_ptr<host_file_data_s> file;
+  if ((it != _files.end()) && (mode[0] == 'a')) {
+    file = it->second;
+  } else {
+    // 開いているファイルの内容は変えずに、新しい内容に置き換えます。
+    file = std::make_shared<host_file_data_s>();
+    file->last_write = host_file_time = max(time(nullptr), host_file_time + 1);
+    _files[path] = file;
+  }
+  return File(file, true);
+}
+
+} // namespace fs
+
+static host_heap_stats_s host_heap_stats = {};
+
+EspClass ESP;
+
+void stackchanHostTrackAlloc(size_t size) {
+  host_heap_stats.alloc_count++;
+  host_heap_stats.used += size;
+  if (host_heap_stats.used > host_heap_stats.peak) host_heap_stats.peak = host_heap_stats.used;
+}
+
+void stackchanHostTrackFree(size_t size) {
+  host_heap_stats.free_count++;
+  host_heap_stats.used -= min(size, host_heap_stats.used);
+}
+
+void stackchanHostResetHeapPeak() { host_heap_stats.peak = host_heap_stats.used; }
+
+const host_heap_stats_s* stackchanHostGetHeapStats() { return &host_heap_stats; }
+
+uint32_t EspClass::getFreeHeap() {
+  return (host_heap_stats.used < STACKCHAN_HOST_HEAP_SIZE) ? STACKCHAN_HOST_HEAP_SIZE - host_heap_stats.used : 0;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+  return (host_heap_stats.peak < STACKCHAN_HOST_HEAP_SIZE) ? STACKCHAN_HOST_HEAP_SIZE - host_heap_stats.peak : 0;
+}
+
+namespace fonts {
+const lgfx::IFont Font0 = {};
+const lgfx::IFont efontJA_16 = {};
+const lgfx::IFont efontCN_16 = {};
+}
+
+#endif // ARDUINO
@@ -0,0 +1,68 @@
+// Copyright (c) Takao Akaki
+#include "Stackchan_power_governor.h"
+
+static const char *power_status_name[POWER_STATUS_NUM] = { "SidePower", "BackPower", "Battery" };
+
+StackchanPowerGovernor::StackchanPowerGovernor() : _servo(nullptr), _status(SidePower), _battery_low(false),
+                                                   _applied(false) {
+  setDefaultConfig(&_config);
+}
+
+void StackchanPowerGovernor::setDefaultConfig(power_governor_config_s *config) {
+  for (int i = 0; i < POWER_STATUS_NUM; i++) {
+    config->limit[i].velocity_scale = 1.0f;
+    config->limit[i].acceleration_scale = 1.0f;
+    config->limit[i].current_budget = 0;
+  }
+  config->limit[Battery].velocity_scale = POWER_GOVERNOR_BATTERY_VELOCITY_SCALE;
+  config->limit[Battery].acceleration_scale = POWER_GOVERNOR_BATTERY_ACCELERATION_SCALE;
+  config->limit[Battery].current_budget = POWER_GOVERNOR_BATTERY_CURRENT_BUDGET;
+  config->battery_low.velocity_scale = POWER_GOVERNOR_BATTERY_LOW_VELOCITY_SCALE;
+  config->battery_low.acceleration_scale = POWER_GOVERNOR_BATTERY_LOW_ACCELERATION_SCALE;
+  config->battery_low.current_budget = POWER_GOVERNOR_BATTERY_LOW_CURRENT_BUDGET;
+  config->battery_low_level = POWER_GOVERNOR_BATTERY_LOW_LEVEL;
+}
+
+void StackchanPowerGovernor::begin(StackchanSERVO *servo, const power_governor_config_s *config) {
+  _servo = servo;
+  if (config != nullptr) {
+    _config = *config;
+  } else {
+    setDefaultConfig(&_config);
+  }
+  _status = SidePower;
+  _battery_low = false;
+  _applied = false;
+}
+
+void StackchanPowerGovernor::setConfig(const power_governor_config_s *config) {
+  _config = *config;
+  _applied = false;
+}
+
+const servo_power_limit_s* StackchanPowerGovernor::getLimit() {
+  if ((_status == Battery) && _battery_low) return &_config.battery_low;
+  return &_config.limit[_status];
+}
+
+void StackchanPowerGovernor::update(PowerStatus status, int battery_level) {
+  if (_servo == nullptr) return;
+  bool battery_low = _battery_low;
+  if (_config.battery_low_level == 0) {
+    battery_low = false;
+  } else if (battery_level <= _config.battery_low_level) {
+    battery_low = true;
+  } else if (battery_level > _config.battery_low_level + POWER_GOVERNOR_BATTERY_HYSTERESIS) {
+    // 残量が閾値付近で揺れても切り替わり続けないように、少し戻るまでは残量が少ない状態のままにします。
+    battery_low = false;
+  }
+  if (_applied && (status == _status) && (battery_low == _battery_low)) return;
+  _status = status;
+  _battery_low = battery_low;
+  _applied = true;
+  const servo_power_limit_s *limit = getLimit();
+  _servo->setPowerLimit(limit);
+  M5_LOGI("Power:%s%s battery:%d%% velocity:x%.2f acceleration:x%.2f current_budget:%dmA",
+          power_status_name[status], battery_low ? "(low)" : "", battery_level,
+          limit->velocity_scale, limit->acceleration_scale, limit->current_budget);
+}
@@ -0,0 +1,72 @@
+// Copyright (c) 2022 Takao Akaki
+
+#ifndef _STACKCHAN_POWER_GOVERNOR_H_
+#define _STACKCHAN_POWER_GOVERNOR_H_
+
+#include "Stackchan_servo.h"
+
+#ifndef POWER_GOVERNOR_BATTERY_VELOCITY_SCALE
+#define POWER_GOVERNOR_BATTERY_VELOCITY_SCALE      0.7f   // バッテリー駆動時の最大速度の倍率
+#endif
+#ifndef POWER_GOVERNOR_BATTERY_ACCELERATION_SCALE
+#define POWER_GOVERNOR_BATTERY_ACCELERATION_SCALE  0.5f   // バッテリー駆動時の最大加速度の倍率
+#endif
+#ifndef POWER_GOVERNOR_BATTERY_CURRENT_BUDGET
+#define POWER_GOVERNOR_BATTERY_CURRENT_BUDGET      1000   // バッテリー駆動時に同時に動かす軸の電流の上限(mA)
+#endif
+#ifndef POWER_GOVERNOR_BATTERY_LOW_LEVEL
+#define POWER_GOVERNOR_BATTERY_LOW_LEVEL           20     // バッテリー残量がこれ以下の場合はbattery_lowの制限にする(%)
+#endif
+#ifndef POWER_GOVERNOR_BATTERY_LOW_VELOCITY_SCALE
+#define POWER_GOVERNOR_BATTERY_LOW_VELOCITY_SCALE  0.4f
+#endif
+#ifndef POWER_GOVERNOR_BATTERY_LOW_ACCELERATION_SCALE
+#define POWER_GOVERNOR_BATTERY_LOW_ACCELERATION_SCALE 0.3f
+#endif
+#ifndef POWER_GOVERNOR_BATTERY_LOW_CURRENT_BUDGET
+#define POWER_GOVERNOR_BATTERY_LOW_CURRENT_BUDGET  500
+#endif
+#ifndef POWER_GOVERNOR_BATTERY_HYSTERESIS
+#define POWER_GOVERNOR_BATTERY_HYSTERESIS          5      // battery_lowから戻す残量の幅(%)
+#endif
+
+// Stackchan_Takao_Base.hppのcheckTakaoBasePowerStatusが返す給電状態
+enum PowerStatus {
+    SidePower,
+    BackPower,
+    Battery
+};
+#define POWER_STATUS_NUM 3
+
+typedef struct PowerGovernorConfig {
+    servo_power_limit_s limit[POWER_STATUS_NUM];   // 給電状態(PowerStatus)ごとの制限
+    servo_power_limit_s battery_low;               // バッテリー駆動で残量が少ない場合の制限
+    uint8_t battery_low_level;                     // battery_lowにする残量(%) 0の場合は使用しない
+} power_governor_config_s;
+
+// 給電状態とバッテリー残量に応じて、StackchanSERVOの最大速度・最大加速度の倍率と電流の上限を切り替えます。
+// 電流の上限を超える同時の移動は、StackchanSERVO側で移動時間を延ばすか開始を遅らせます。
+class StackchanPowerGovernor {
+    protected:
+        StackchanSERVO *_servo;
+        power_governor_config_s _config;
+        PowerStatus _status;
+        bool _battery_low;
+        bool _applied;                                   // 一度でも制限を設定した
+    public:
+        StackchanPowerGovernor();
+        // 初期値(SidePower, BackPowerは制限なし)を設定します。
+        static void setDefaultConfig(power_governor_config_s *config);
+        // configがnullptrの場合は初期値を使います。
+        void begin(StackchanSERVO *servo, const power_governor_config_s *config = nullptr);
+        // 給電状態とバッテリー残量(%)を反映します。制限が変わった場合だけStackchanSERVOに設定します。
+        void update(PowerStatus status, int battery_level);
+        // 設定を変更します。(設定を読み込み直した場合など) 次のupdateで制限を設定し直します。
+        void setConfig(const power_governor_config_s *config);
+        PowerStatus getPowerStatus() { return _status; }
+        bool isBatteryLow() { return _battery_low; }
+        const servo_power_limit_s* getLimit();
+        const power_governor_config_s* getConfig() { return &_config; }
+};
+
+#endif // _STACKCHAN_POWER_GOVERNOR_H_
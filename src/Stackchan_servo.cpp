@@ -1,150 +1,133 @@
 // Copyright (c) Takao Akaki
 #include "Stackchan_servo.h"
 
-#include <ServoEasing.hpp>
-
-static long convertSCS0009Pos(int16_t degree) {
-  //Serial.printf("Degree: %d\n", degree);
-  return map(degree, 0, 300, 1023, 0);
+// 加速度の上限がある場合は台形速度、ない場合は指定したカーブで補間します。
+static int32_t planEaseQ15(const servo_plan_s *plan, uint8_t ease, int32_t p) {
+  if ((plan->millis_for_accel == 0) || (plan->millis_for_move == 0)) {
+    return servoEaseQ15(ease, p);
+  }
+  return trapezoidEaseQ15(p, servoEaseProgressQ15(plan->millis_for_accel, plan->millis_for_move));
 }
 
-static long convertDYNIXELXL330(int16_t degree) {
-  M5_LOGI("Degree: %d\n", degree);
-  
-  long ret =  map(degree, 0, 360, 0, 4095);
-  M5_LOGI("Position: %d\n", ret);
-  return ret;
+StackchanSERVO::StackchanSERVO() : _servo_type(PWM), _driver(nullptr), _driver_num(0), _axis_num(SERVO_AXIS_XY_NUM), _isMoving(false),
+                                   _serial_ease_interval(SERIAL_EASE_INTERVAL), _ease(SERVO_EASE_QUAD), _motion_library(nullptr),
+                                   _arrival_tolerance(SERVO_ARRIVAL_TOLERANCE), _arrival_timeout(SERVO_ARRIVAL_TIMEOUT),
+                                   _last_feedback_millis(0), _health_interval(SERVO_HEALTH_POLL_INTERVAL),
+                                   _last_health_millis(0), _recording(nullptr),
+                                   _last_record_millis(0) {
+  memset(&_init_param, 0, sizeof(_init_param));
+  memset(_drivers, 0, sizeof(_drivers));
+  memset(_axis_driver, 0, sizeof(_axis_driver));
+  memset(_driver_write_millis, 0, sizeof(_driver_write_millis));
+  memset(_last_degree, 0, sizeof(_last_degree));
+  memset(_health_warning, 0, sizeof(_health_warning));
+  _power_limit.velocity_scale = 1.0f;
+  _power_limit.acceleration_scale = 1.0f;
+  _power_limit.current_budget = 0;
+  memset(_trajectory, 0, sizeof(_trajectory));
+  memset(_motion_limit, 0, sizeof(_motion_limit));
+  memset(&_motion_player, 0, sizeof(_motion_player));
+  memset(&_replay, 0, sizeof(_replay));
 }
 
-static long convertDYNIXELXL330_RT(int16_t degree) {
-  M5_LOGI("Degree: %d\n", degree);
-  
-  long ret =  map(degree, -360, 720, -4095, 8191);
-  M5_LOGI("Position: %d\n", ret);
-  return ret;
+StackchanSERVO::~StackchanSERVO() {
+  deleteDrivers();
 }
 
-// シリアルサーボ用のEasing関数
-float quadraticEaseInOut(float p) {
-  //return p;
-  if(p < 0.5)
-	{
-		return 2 * p * p;
-	}
-	else
-	{
-		return (-2 * p * p) + (4 * p) - 1;
-	}
+void StackchanSERVO::deleteDrivers() {
+  for (int i = 0; i < _driver_num; i++) {
+    delete _drivers[i];
+    _drivers[i] = nullptr;
+  }
+  _driver_num = 0;
+  _driver = nullptr;
 }
 
-
-StackchanSERVO::StackchanSERVO() {}
-
-StackchanSERVO::~StackchanSERVO() {}
-
 float StackchanSERVO::getPosition(int x){
-  if (_servo_type == RT_DYN_XL330){
-    return _dxl.getPresentPosition(x);;
-  } else {
-    M5_LOGI("getPosition::Command is only supprted in RT_DYN_XL330");
-  }
+  if (_driver == nullptr) return 0.0f;
+  return _driver->getPresentPosition(x);
 };
 
+// 軸をサーボの種類ごとにまとめ、種類ごとに1つのドライバを生成します。(X, Yは同じドライバ)
 void StackchanSERVO::attachServos() {
-  if (_servo_type == ServoType::SCS) {
-    // SCS0009
-    Serial2.begin(1000000, SERIAL_8N1, _init_param.servo[AXIS_X].pin, _init_param.servo[AXIS_Y].pin);
-    delay(500);
-    _sc.pSerial = &Serial2;
-    _sc.WritePos(AXIS_X + 1, convertSCS0009Pos(_init_param.servo[AXIS_X].start_degree + _init_param.servo[AXIS_X].offset), 1000);
-    _sc.WritePos(AXIS_Y + 1, convertSCS0009Pos(_init_param.servo[AXIS_Y].start_degree + _init_param.servo[AXIS_Y].offset), 1000);
-    vTaskDelay(1000/portTICK_PERIOD_MS);
-
-  } else if (_servo_type == ServoType::DYN_XL330) {
-    M5_LOGI("DYN_XL330");
-    Serial2.begin(1000000, SERIAL_8N1, _init_param.servo[AXIS_X].pin, _init_param.servo[AXIS_Y].pin);
-    _dxl = Dynamixel2Arduino(Serial2);
-    _dxl.begin(1000000);
-    _dxl.setPortProtocolVersion(DXL_PROTOCOL_VERSION);
-    _dxl.ping(AXIS_X + 1);
-    _dxl.ping(AXIS_Y + 1);
-    _dxl.setOperatingMode(AXIS_X + 1, OP_POSITION);
-    _dxl.setOperatingMode(AXIS_Y + 1, OP_POSITION);
-    _dxl.writeControlTableItem(DRIVE_MODE, AXIS_X + 1, 4);  // Velocityのパラメータを移動時間(msec)で指定するモードに変更
-    _dxl.writeControlTableItem(DRIVE_MODE, AXIS_Y + 1, 4);  // Velocityのパラメータを移動時間(msec)で指定するモードに変更
-    _dxl.torqueOn(AXIS_X + 1);
-    delay(100); // ここでWaitを入れないと、Y(tilt)サーボが動かない場合がある。
-    _dxl.torqueOn(AXIS_Y + 1);
-    delay(100);
-    _dxl.writeControlTableItem(PROFILE_VELOCITY, AXIS_X + 1, 1000);
-    _dxl.writeControlTableItem(PROFILE_VELOCITY, AXIS_Y + 1, 1000);
-    delay(100);
-    _dxl.setGoalPosition(AXIS_X + 1, 2048);
-    _dxl.setGoalPosition(AXIS_Y + 1, 3073);
-    //_dxl.torqueOff(AXIS_X + 1);
-    //_dxl.torqueOff(AXIS_Y + 1);
-    
-  } else if (_servo_type == ServoType::RT_DYN_XL330){
-    M5_LOGI("RT_DYN_XL330");
-    Serial2.begin(1000000, SERIAL_8N1, _init_param.servo[AXIS_X].pin, _init_param.servo[AXIS_Y].pin);
-    _dxl = Dynamixel2Arduino(Serial2);
-    _dxl.begin(1000000);
-    _dxl.setPortProtocolVersion(DXL_PROTOCOL_VERSION);
-    _dxl.ping(AXIS_X + 1);
-    _dxl.ping(AXIS_Y + 1);
-    _dxl.setOperatingMode(AXIS_X + 1, OP_EXTENDED_POSITION);
-    _dxl.setOperatingMode(AXIS_Y + 1, OP_EXTENDED_POSITION);
-    _dxl.writeControlTableItem(DRIVE_MODE, AXIS_X + 1, 4);  // Velocityのパラメータを移動時間(msec)で指定するモードに変更
-    _dxl.writeControlTableItem(DRIVE_MODE, AXIS_Y + 1, 4);  // Velocityのパラメータを移動時間(msec)で指定するモードに変更
-    _dxl.torqueOn(AXIS_X + 1);
-    delay(10); // ここでWaitを入れないと、Y(tilt)サーボが動かない場合がある。
-    _dxl.torqueOn(AXIS_Y + 1);
-    delay(100);
-    _dxl.writeControlTableItem(PROFILE_VELOCITY, AXIS_X + 1, 1000);
-    _dxl.writeControlTableItem(PROFILE_VELOCITY, AXIS_Y + 1, 1000);
-    delay(100);
-
-    M5_LOGI("CurrentPosition X:%f, Y:%f",  _dxl.getPresentPosition(AXIS_X + 1), _dxl.getPresentPosition(AXIS_Y + 1));
-
-    if (_dxl.getPresentPosition(AXIS_X + 1) > 4096) {
-      _init_param.servo[AXIS_X].offset = _init_param.servo[AXIS_X].offset + 360;
+  deleteDrivers();
+  _axis_num = _init_param.axis_num;
+  if (_axis_num < SERVO_AXIS_XY_NUM) _axis_num = SERVO_AXIS_XY_NUM;
+  if (_axis_num > SERVO_AXIS_MAX) _axis_num = SERVO_AXIS_MAX;
+  uint8_t types[SERVO_AXIS_MAX];
+  for (int axis = 0; axis < _axis_num; axis++) {
+    uint8_t type = (axis < SERVO_AXIS_XY_NUM) ? (uint8_t)_servo_type : _init_param.servo[axis].servo_type;
+    if ((type == ServoType::DYN_XL330) && (_servo_type == ServoType::RT_DYN_XL330)) {
+      // RT版のX, Yと同じバスのXL330は同じドライバで扱います。
+      type = ServoType::RT_DYN_XL330;
     }
-    if ((_dxl.getPresentPosition(AXIS_Y + 1)-convertDYNIXELXL330_RT(_init_param.servo[AXIS_Y].lower_limit + _init_param.servo[AXIS_Y].offset)) > convertDYNIXELXL330_RT(270)) {
-      _init_param.servo[AXIS_Y].offset = _init_param.servo[AXIS_Y].offset + 360;
+    int d = 0;
+    while ((d < _driver_num) && (types[d] != type)) d++;
+    if (d == _driver_num) {
+      types[_driver_num++] = type;
     }
-    //_init_param.servo[AXIS_Y].offset = 360;
-    
-    M5_LOGI("Current Offset X:%d, Y:%d", _init_param.servo[AXIS_X].offset, _init_param.servo[AXIS_Y].offset);
-
-    _dxl.setGoalPosition(AXIS_X + 1, convertDYNIXELXL330_RT(_init_param.servo[AXIS_X].start_degree + _init_param.servo[AXIS_X].offset));
-    _dxl.setGoalPosition(AXIS_Y + 1, convertDYNIXELXL330_RT(_init_param.servo[AXIS_Y].start_degree + _init_param.servo[AXIS_Y].offset));
-    //_dxl.torqueOff(AXIS_X + 1);
-    //_dxl.torqueOff(AXIS_Y + 1);
-
-  } else {
-    // SG90 PWM
-    if (_servo_x.attach(_init_param.servo[AXIS_X].pin, 
-                        _init_param.servo[AXIS_X].start_degree + _init_param.servo[AXIS_X].offset,
-                        DEFAULT_MICROSECONDS_FOR_0_DEGREE,
-                        DEFAULT_MICROSECONDS_FOR_180_DEGREE)) {
-      Serial.print("Error attaching servo x");
+    _axis_driver[axis] = d;
+  }
+  for (int d = 0; d < _driver_num; d++) {
+    uint8_t axes[SERVO_AXIS_MAX];
+    uint8_t axis_num = 0;
+    for (int axis = 0; axis < _axis_num; axis++) {
+      if (_axis_driver[axis] == d) axes[axis_num++] = axis;
     }
-    if (_servo_y.attach(_init_param.servo[AXIS_Y].pin, 
-                        _init_param.servo[AXIS_Y].start_degree + _init_param.servo[AXIS_Y].offset,
-                        DEFAULT_MICROSECONDS_FOR_0_DEGREE,
-                        DEFAULT_MICROSECONDS_FOR_180_DEGREE)) {
-      Serial.print("Error attaching servo y");
+    _drivers[d] = createServoDriver((ServoType)types[d]);
+    if (_drivers[d] == nullptr) {
+      M5_LOGE("ServoType:%d is not built", types[d]);
+      continue;
     }
+    _drivers[d]->setAxes(axes, axis_num);
+    _drivers[d]->attach(&_init_param);
+    _drivers[d]->setEase(_ease);
+  }
+  _driver = _drivers[0];
+  for (int axis = 0; axis < _axis_num; axis++) {
+    _last_degree[axis] = _init_param.servo[axis].start_degree;
+  }
+  startInitialPose(millis());
+}
+
+// 初期位置への移動(attachで開始済み)を非同期移動として記録します。
+// 完了を待たずにAvatarなどの初期化を進められます。完了はtick()で確認します。(XL330はサーボの応答で確認)
+void StackchanSERVO::startInitialPose(uint32_t now) {
+  for (int axis = 0; axis < _axis_num; axis++) {
+    bool attached = (axisDriver(axis) != nullptr);
+    servo_trajectory_s *t = &_trajectory[axis];
+    t->start_degree      = _init_param.servo[axis].start_degree;
+    t->target_degree     = t->start_degree;
+    t->current_degree    = t->start_degree;
+    t->start_millis      = now;
+    t->millis_for_move   = attached ? SERVO_STARTUP_MILLIS_FOR_MOVE : 0;
+    t->last_write_millis = now;
+    t->ease              = _ease;
+    t->accel_ratio       = 0;
+    t->active            = attached;
+    t->arrived           = false;
+    t->stalled           = false;
+    t->deferred          = false;
+  }
+  _last_feedback_millis = now;
+}
 
-    _servo_x.setEasingType(EASE_QUADRATIC_IN_OUT);
-    _servo_y.setEasingType(EASE_QUADRATIC_IN_OUT);
+bool StackchanSERVO::isAnyActive() {
+  for (int axis = 0; axis < _axis_num; axis++) {
+    if (_trajectory[axis].active) return true;
   }
-  _last_degree_x = _init_param.servo[AXIS_X].start_degree;
-  _last_degree_y = _init_param.servo[AXIS_Y].start_degree;
+  return false;
+}
+
+// 完了を待つ移動(moveX等)を始める前に、その軸の非同期移動を打ち切ります。
+void StackchanSERVO::cancelTrajectory(bool cancel_x, bool cancel_y) {
+  if (cancel_x) _trajectory[AXIS_X].active = false;
+  if (cancel_y) _trajectory[AXIS_Y].active = false;
 }
 
-void StackchanSERVO::begin(stackchan_servo_initial_param_s init_param) {
+void StackchanSERVO::begin(stackchan_servo_initial_param_s init_param, ServoType servo_type) {
   _init_param = init_param;
+  _servo_type = servo_type;
   attachServos();
 }
 
@@ -157,44 +140,274 @@ void StackchanSERVO::begin(int servo_pin_x, int16_t start_degree_x, int16_t offs
   _init_param.servo[AXIS_Y].pin          = servo_pin_y;
   _init_param.servo[AXIS_Y].start_degree = start_degree_y;
   _init_param.servo[AXIS_Y].offset       = offset_y;
+  _init_param.axis_num = SERVO_AXIS_XY_NUM;
   _servo_type = servo_type;
   attachServos();
 }
 
-void StackchanSERVO::moveX(int x, uint32_t millis_for_move) {
-  if (_servo_type == SCS) {
-    _sc.WritePos(AXIS_X + 1, convertSCS0009Pos(x + _init_param.servo[AXIS_X].offset), millis_for_move);
-    _isMoving = true;
-    vTaskDelay(millis_for_move/portTICK_PERIOD_MS);
-    _isMoving = false;
-  } else if (_servo_type == ServoType::DYN_XL330) {
-    _dxl.writeControlTableItem(PROFILE_VELOCITY, AXIS_X + 1, millis_for_move);
-    vTaskDelay(10/portTICK_PERIOD_MS);
-    _dxl.setGoalPosition(AXIS_X + 1, convertDYNIXELXL330(x + _init_param.servo[AXIS_X].offset));
-    vTaskDelay(10/portTICK_PERIOD_MS);
-    _isMoving = true;
-    vTaskDelay(millis_for_move/portTICK_PERIOD_MS);
-    _isMoving = false;
-  } else if (_servo_type == ServoType::RT_DYN_XL330) {
-    _dxl.writeControlTableItem(PROFILE_VELOCITY, AXIS_X + 1, millis_for_move);
-    vTaskDelay(10/portTICK_PERIOD_MS);
-    _dxl.setGoalPosition(AXIS_X + 1, convertDYNIXELXL330_RT(x + _init_param.servo[AXIS_X].offset));
-    vTaskDelay(10/portTICK_PERIOD_MS);
-    _isMoving = true;
-    vTaskDelay(millis_for_move/portTICK_PERIOD_MS);
-    _isMoving = false;
-    M5_LOGI("X:%f", getPosition(AXIS_X+1));
-  }else {
-    if (millis_for_move == 0) {
-      _servo_x.easeTo(x + _init_param.servo[AXIS_X].offset);
-    } else {
-      _servo_x.easeToD(x + _init_param.servo[AXIS_X].offset, millis_for_move);
+// 角度にoffsetを加えてドライバへ書き込みます。(待ち時間なし)
+void StackchanSERVO::writeXY(bool move_x, int x, uint32_t millis_for_move_x,
+                             bool move_y, int y, uint32_t millis_for_move_y) {
+  if (_driver == nullptr) return;
+  _driver->writeXY(move_x, x + _init_param.servo[AXIS_X].offset, millis_for_move_x,
+                   move_y, y + _init_param.servo[AXIS_Y].offset, millis_for_move_y);
+}
+
+// writeがtrueの軸の軌道の角度(to_targetがtrueの場合は目標角度と移動時間)にoffsetを加えて書き込みます。
+// ドライバごとに1回の送信(シリアルサーボは1パケット)にまとめます。
+void StackchanSERVO::writeTrajectories(const bool *write, bool to_target, uint32_t millis_for_move) {
+  for (int d = 0; d < _driver_num; d++) {
+    if (_drivers[d] == nullptr) continue;
+    servo_write_s writes[SERVO_AXIS_MAX];
+    uint8_t write_num = 0;
+    for (int axis = 0; axis < _axis_num; axis++) {
+      if (!write[axis] || (_axis_driver[axis] != d)) continue;
+      const servo_trajectory_s *t = &_trajectory[axis];
+      servo_write_s *w = &writes[write_num++];
+      w->axis            = axis;
+      w->degree          = (to_target ? t->target_degree : t->current_degree) + _init_param.servo[axis].offset;
+      w->millis_for_move = to_target ? t->millis_for_move : millis_for_move;
     }
-    _isMoving = true;
-    synchronizeAllServosStartAndWaitForAllServosToStop();
-    _isMoving = false;
+    if (write_num > 0) {
+      _drivers[d]->writeAxes(writes, write_num);
+    }
+  }
+}
+
+// 角度にoffsetを加えてドライバで移動し、移動が終わるまで待ちます。
+void StackchanSERVO::driverMoveXY(bool move_x, int x, uint32_t millis_for_move_x,
+                                  bool move_y, int y, uint32_t millis_for_move_y) {
+  if (_driver == nullptr) return;
+  cancelTrajectory(move_x, move_y);
+  _isMoving = true;
+  if (_driver->supportsFeedback()) {
+    // 移動時間だけ待つのではなく、サーボが目標に到達するまで待ちます。
+    writeXY(move_x, x, millis_for_move_x, move_y, y, millis_for_move_y);
+    waitArrival(move_x, x, move_y, y, max(move_x ? millis_for_move_x : 0, move_y ? millis_for_move_y : 0));
+  } else {
+    _driver->moveXY(move_x, x + _init_param.servo[AXIS_X].offset, millis_for_move_x,
+                    move_y, y + _init_param.servo[AXIS_Y].offset, millis_for_move_y);
   }
-  _last_degree_x = x;
+  _isMoving = false;
+}
+
+// サーボが止まっていて、現在の角度が目標(offset前の角度)から許容範囲内の場合はtrue
+bool StackchanSERVO::isArrived(const servo_feedback_s *feedback, ServoAxis axis, int degree) {
+  float diff = feedback->degree[axis] - (degree + _init_param.servo[axis].offset);
+  return !feedback->moving[axis] && (fabsf(diff) <= _arrival_tolerance);
+}
+
+// 両軸を指定した軸が目標に到達するまで待ちます。タイムアウトした場合はfalse
+bool StackchanSERVO::waitArrival(bool move_x, int x, bool move_y, int y, uint32_t millis_for_move) {
+  const bool check[2] = { move_x, move_y };
+  const int degree[2] = { x, y };
+  bool arrived[2] = { !move_x, !move_y };
+  uint32_t start = millis();
+  TickType_t last_wake_time = xTaskGetTickCount();
+  while (!(arrived[AXIS_X] && arrived[AXIS_Y])) {
+    if (millis() - start >= millis_for_move + _arrival_timeout) break;
+    vTaskDelayUntil(&last_wake_time, SERVO_ARRIVAL_POLL_INTERVAL/portTICK_PERIOD_MS);
+    servo_feedback_s feedback;
+    if (!_driver->readFeedback(&feedback)) continue;
+    for (int axis = AXIS_X; axis <= AXIS_Y; axis++) {
+      if (check[axis] && !arrived[axis]) {
+        arrived[axis] = isArrived(&feedback, (ServoAxis)axis, degree[axis]);
+      }
+    }
+  }
+  for (int axis = AXIS_X; axis <= AXIS_Y; axis++) {
+    _trajectory[axis].stalled = check[axis] && !arrived[axis];
+    if (_trajectory[axis].stalled) {
+      M5_LOGE("Servo axis:%d did not reach %d degree (timeout)", axis, degree[axis]);
+    }
+  }
+  return arrived[AXIS_X] && arrived[AXIS_Y];
+}
+
+// サーボの状態を読み出し(ドライバごとに受け持つ軸を1回の通信で)、目標に到達した軸を記録します。読み出しを行った場合はtrue
+bool StackchanSERVO::pollArrival(uint32_t now) {
+  if (now - _last_feedback_millis < SERVO_ARRIVAL_POLL_INTERVAL) return false;
+  bool polled = false;
+  for (int d = 0; d < _driver_num; d++) {
+    StackchanServoDriver *driver = _drivers[d];
+    if ((driver == nullptr) || !driver->supportsFeedback()) continue;
+    bool waiting = false;
+    for (int axis = 0; axis < _axis_num; axis++) {
+      if ((_axis_driver[axis] == d) && _trajectory[axis].active && !_trajectory[axis].arrived
+          && !_trajectory[axis].deferred) waiting = true;
+    }
+    if (!waiting) continue;
+    polled = true;
+    servo_feedback_s feedback;
+    if (!driver->readFeedback(&feedback)) continue;
+    for (int axis = 0; axis < _axis_num; axis++) {
+      servo_trajectory_s *t = &_trajectory[axis];
+      if ((_axis_driver[axis] == d) && t->active && !t->arrived && !t->deferred) {
+        t->arrived = isArrived(&feedback, (ServoAxis)axis, t->target_degree);
+      }
+    }
+  }
+  if (polled) {
+    _last_feedback_millis = now;
+  }
+  return polled;
+}
+
+// 一定間隔で温度・電流・電圧・ハードウェアエラーを読み出して記録します。
+// 警告の状態になった軸は1回だけログに出力します。
+void StackchanSERVO::pollHealth(uint32_t now) {
+  if ((_health_interval == 0) || (now - _last_health_millis < _health_interval)) return;
+  _last_health_millis = now;
+  servo_health_s health;
+  memset(&health, 0, sizeof(health));
+  bool read = false;
+  for (int d = 0; d < _driver_num; d++) {
+    if ((_drivers[d] != nullptr) && _drivers[d]->supportsHealth()) {
+      read = _drivers[d]->readHealth(&health) || read;
+    }
+  }
+  if (!read) return;
+  health.millis = now;
+  health.axis_num = _axis_num;
+  _health_log.push(&health);
+  for (int axis = 0; axis < _axis_num; axis++) {
+    bool warning = StackchanServoHealthLog::isWarning(&health, (ServoAxis)axis);
+    if (warning && !_health_warning[axis]) {
+      M5_LOGW("Servo axis:%d temperature:%dC hardware error:0x%02X", axis, health.temperature[axis], health.hardware_error[axis]);
+    }
+    _health_warning[axis] = warning;
+  }
+}
+
+void StackchanSERVO::setEase(uint8_t ease) {
+  _ease = (ease < SERVO_EASE_NUM) ? ease : SERVO_EASE_QUAD;
+  for (int d = 0; d < _driver_num; d++) {
+    if (_drivers[d] != nullptr) _drivers[d]->setEase(_ease);
+  }
+}
+
+void StackchanSERVO::setLimit(ServoAxis axis, int16_t lower_limit, int16_t upper_limit) {
+  if (axis >= SERVO_AXIS_MAX) return;
+  _init_param.servo[axis].lower_limit = lower_limit;
+  _init_param.servo[axis].upper_limit = upper_limit;
+}
+
+void StackchanSERVO::setOffset(ServoAxis axis, int16_t offset) {
+  if (axis >= SERVO_AXIS_MAX) return;
+  _init_param.servo[axis].offset = offset;
+}
+
+void StackchanSERVO::setMotionLimit(ServoAxis axis, float max_velocity, float max_acceleration) {
+  if (axis >= SERVO_AXIS_MAX) return;
+  _motion_limit[axis].max_velocity = max_velocity;
+  _motion_limit[axis].max_acceleration = max_acceleration;
+}
+
+int StackchanSERVO::currentDegree(ServoAxis axis) {
+  if (_trajectory[axis].active) {
+    return _trajectory[axis].current_degree;
+  }
+  return _last_degree[axis];
+}
+
+uint32_t StackchanSERVO::getMinimumMillisForMove(ServoAxis axis, int degree) {
+  servo_plan_s plan = planMove(axis, currentDegree(axis), degree, 0);
+  return plan.millis_for_move;
+}
+
+// 目標角度を可動範囲に収め、速度・加速度の上限から移動時間と加速時間を求めます。
+// サーボ側でプロファイルを生成するドライバには加速時間を設定します。
+servo_plan_s StackchanSERVO::planMove(ServoAxis axis, int from, int degree, uint32_t millis_for_move) {
+  servo_motion_limit_s limit = scaledMotionLimit(axis);
+  servo_plan_s plan = planServoMove(from, degree, millis_for_move,
+                                    _init_param.servo[axis].lower_limit, _init_param.servo[axis].upper_limit,
+                                    &limit);
+  if (axisDriver(axis) != nullptr) {
+    axisDriver(axis)->setAccelerationTime(axis, plan.millis_for_accel);
+  }
+  return plan;
+}
+
+// 2軸を同時に動かす場合は、遅い方の軸の最短時間に合わせます。
+// 電流の上限がある場合は、2軸の電流の見積もりが上限に収まるように移動時間を延ばします。
+uint32_t StackchanSERVO::planMillisXY(int from_x, int x, int from_y, int y, uint32_t millis_for_move) {
+  servo_motion_limit_s limit_x = scaledMotionLimit(AXIS_X);
+  servo_motion_limit_s limit_y = scaledMotionLimit(AXIS_Y);
+  uint32_t millis_x = planServoMove(from_x, x, millis_for_move, _init_param.servo[AXIS_X].lower_limit,
+                                    _init_param.servo[AXIS_X].upper_limit, &limit_x).millis_for_move;
+  uint32_t millis_y = planServoMove(from_y, y, millis_for_move, _init_param.servo[AXIS_Y].lower_limit,
+                                    _init_param.servo[AXIS_Y].upper_limit, &limit_y).millis_for_move;
+  millis_for_move = max(millis_x, millis_y);
+  uint32_t budget = _power_limit.current_budget;
+  uint32_t current = estimateCurrent(from_x, x, millis_for_move) + estimateCurrent(from_y, y, millis_for_move);
+  if ((budget > 0) && (current > budget)) {
+    millis_for_move = (uint32_t)((uint64_t)millis_for_move * current / budget);
+  }
+  return millis_for_move;
+}
+
+// 給電状態に応じて最大速度・最大加速度に倍率を掛けます。上限が未設定の軸は基準の速度・加速度に倍率を掛けます。
+servo_motion_limit_s StackchanSERVO::scaledMotionLimit(uint8_t axis) {
+  servo_motion_limit_s limit = _motion_limit[axis];
+  if (_power_limit.velocity_scale < 1.0f) {
+    float velocity = (limit.max_velocity > 0.0f) ? limit.max_velocity : SERVO_POWER_BASE_VELOCITY;
+    limit.max_velocity = velocity * _power_limit.velocity_scale;
+  }
+  if (_power_limit.acceleration_scale < 1.0f) {
+    float acceleration = (limit.max_acceleration > 0.0f) ? limit.max_acceleration : SERVO_POWER_BASE_ACCELERATION;
+    limit.max_acceleration = acceleration * _power_limit.acceleration_scale;
+  }
+  return limit;
+}
+
+// 平均速度から1軸の電流(mA)を見積もります。(速度に比例するとみなします)
+uint32_t StackchanSERVO::estimateCurrent(int from, int to, uint32_t millis_for_move) {
+  if (from == to) return 0;
+  if (millis_for_move == 0) return SERVO_POWER_CURRENT_AT_BASE;
+  float velocity = abs(to - from) * 1000.0f / millis_for_move;
+  return (uint32_t)(SERVO_POWER_CURRENT_AT_BASE * velocity / SERVO_POWER_BASE_VELOCITY);
+}
+
+// 動いている他の軸と合わせた電流の見積もりが上限を超える場合は移動時間を延ばします。
+// 上限の残りがSERVO_POWER_MIN_CURRENT未満の場合は、他の軸が止まる時刻(*start)まで開始を遅らせます。
+uint32_t StackchanSERVO::governMove(const servo_axis_target_s *targets, uint8_t target_num, uint32_t millis_for_move,
+                                    uint32_t now, uint32_t *start) {
+  *start = now;
+  uint32_t budget = _power_limit.current_budget;
+  if (budget == 0) return millis_for_move;
+  bool target_axis[SERVO_AXIS_MAX] = {};
+  uint32_t move_current = 0;
+  for (int i = 0; i < target_num; i++) {
+    uint8_t axis = targets[i].axis;
+    if (axis >= _axis_num) continue;
+    target_axis[axis] = true;
+    move_current += estimateCurrent(currentDegree((ServoAxis)axis), targets[i].degree, millis_for_move);
+  }
+  uint32_t active_current = 0;
+  uint32_t active_end = now;
+  for (int axis = 0; axis < _axis_num; axis++) {
+    const servo_trajectory_s *t = &_trajectory[axis];
+    if (!t->active || target_axis[axis]) continue;
+    active_current += estimateCurrent(t->start_degree, t->target_degree, t->millis_for_move);
+    uint32_t end = t->start_millis + t->millis_for_move;
+    if ((int32_t)(end - active_end) > 0) active_end = end;
+  }
+  if (move_current == 0) return millis_for_move;
+  if (active_current + SERVO_POWER_MIN_CURRENT > budget) {
+    *start = active_end;
+    active_current = 0;
+  }
+  uint32_t available = budget - active_current;
+  if (move_current > available) {
+    millis_for_move = (uint32_t)((uint64_t)millis_for_move * move_current / available);
+  }
+  return millis_for_move;
+}
+
+void StackchanSERVO::moveX(int x, uint32_t millis_for_move) {
+  servo_plan_s plan = planMove(AXIS_X, _last_degree[AXIS_X], x, millis_for_move);
+  driverMoveXY(true, plan.degree, plan.millis_for_move, false, 0, 0);
+  _last_degree[AXIS_X] = plan.degree;
 }
 
 void StackchanSERVO::moveX(servo_param_s servo_param_x) {
@@ -203,39 +416,9 @@ void StackchanSERVO::moveX(servo_param_s servo_param_x) {
 }
 
 void StackchanSERVO::moveY(int y, uint32_t millis_for_move) {
-  if (_servo_type == ServoType::SCS) {
-    _sc.WritePos(AXIS_Y + 1, convertSCS0009Pos(y + _init_param.servo[AXIS_Y].offset), millis_for_move);
-    _isMoving = true;
-    vTaskDelay(millis_for_move/portTICK_PERIOD_MS);
-    _isMoving = false;
-  } else if (_servo_type == ServoType::DYN_XL330) {
-    _dxl.writeControlTableItem(PROFILE_VELOCITY, AXIS_Y + 1, millis_for_move);
-    vTaskDelay(10/portTICK_PERIOD_MS);
-    _dxl.setGoalPosition(AXIS_Y + 1, convertDYNIXELXL330(y + _init_param.servo[AXIS_Y].offset)); // RT版に合わせて+180°しています。
-    vTaskDelay(10/portTICK_PERIOD_MS);
-    _isMoving = true;
-    vTaskDelay(millis_for_move/portTICK_PERIOD_MS);
-    _isMoving = false;
-  } else if (_servo_type == ServoType::RT_DYN_XL330) {
-    _dxl.writeControlTableItem(PROFILE_VELOCITY, AXIS_Y + 1, millis_for_move);
-    vTaskDelay(10/portTICK_PERIOD_MS);
-    _dxl.setGoalPosition(AXIS_Y + 1, convertDYNIXELXL330_RT(y + _init_param.servo[AXIS_Y].offset)); // RT版に合わせて+180°しています。
-    vTaskDelay(10/portTICK_PERIOD_MS);
-    _isMoving = true;
-    vTaskDelay(millis_for_move/portTICK_PERIOD_MS);
-    _isMoving = false;
-    M5_LOGI("Y:%f", getPosition(AXIS_Y+1));
-  } else {
-    if (millis_for_move == 0) {
-      _servo_y.easeTo(y + _init_param.servo[AXIS_Y].offset);
-    } else {
-      _servo_y.easeToD(y + _init_param.servo[AXIS_Y].offset, millis_for_move);
-    }
-    _isMoving = true;
-    synchronizeAllServosStartAndWaitForAllServosToStop();
-    _isMoving = false;
-  }
-  _last_degree_y = y;
+  servo_plan_s plan = planMove(AXIS_Y, _last_degree[AXIS_Y], y, millis_for_move);
+  driverMoveXY(false, 0, 0, true, plan.degree, plan.millis_for_move);
+  _last_degree[AXIS_Y] = plan.degree;
 }
 
 void StackchanSERVO::moveY(servo_param_s servo_param_y) {
@@ -243,132 +426,427 @@ void StackchanSERVO::moveY(servo_param_s servo_param_y) {
   moveY(servo_param_y.degree, servo_param_y.millis_for_move);
 }
 void StackchanSERVO::moveXY(int x, int y, uint32_t millis_for_move) {
-  if (_servo_type == ServoType::SCS) {
-    int increase_degree_x = x - _last_degree_x;
-    int increase_degree_y = y - _last_degree_y;
-    uint32_t division_time = millis_for_move / SERIAL_EASE_DIVISION;
+  millis_for_move = planMillisXY(_last_degree[AXIS_X], x, _last_degree[AXIS_Y], y, millis_for_move);
+  servo_plan_s plan_x = planMove(AXIS_X, _last_degree[AXIS_X], x, millis_for_move);
+  servo_plan_s plan_y = planMove(AXIS_Y, _last_degree[AXIS_Y], y, millis_for_move);
+  if ((_driver != nullptr) && _driver->needsSoftwareEasing()) {
+    uint32_t division = millis_for_move / _serial_ease_interval;
+    if (division < SERIAL_EASE_DIVISION) division = SERIAL_EASE_DIVISION;
+    uint32_t division_time = millis_for_move / division;
+    cancelTrajectory(true, true);
     _isMoving = true;
-    //M5_LOGI("SCS: %d, %d, %d", increase_degree_x, increase_degree_y, division_time);
-    for (float f=0.0f; f<1.0f; f=f+(1.0f/SERIAL_EASE_DIVISION)) {
-      int x_pos = _last_degree_x + increase_degree_x * quadraticEaseInOut(f);
-      int y_pos = _last_degree_y + increase_degree_y * quadraticEaseInOut(f);
-      _sc.WritePos(AXIS_X + 1, convertSCS0009Pos(x_pos + _init_param.servo[AXIS_X].offset), division_time);
-      _sc.WritePos(AXIS_Y + 1, convertSCS0009Pos(y_pos + _init_param.servo[AXIS_Y].offset), division_time);
-      vTaskDelay(division_time);
+    //M5_LOGI("SCS: %d, %d, %d", plan_x.degree, plan_y.degree, division_time);
+    // 各ステップでX,Yを1パケット(SyncWritePos)で送るので両軸が同時に動きます。
+    TickType_t last_wake_time = xTaskGetTickCount();
+    for (uint32_t i=1; i<=division; i++) {
+      int32_t p = (int32_t)(i * SERVO_EASE_Q15_ONE / division);
+      int x_pos = servoEaseLerp(_last_degree[AXIS_X], plan_x.degree, planEaseQ15(&plan_x, _ease, p));
+      int y_pos = servoEaseLerp(_last_degree[AXIS_Y], plan_y.degree, planEaseQ15(&plan_y, _ease, p));
+      writeXY(true, x_pos, division_time, true, y_pos, division_time);
+      vTaskDelayUntil(&last_wake_time, division_time/portTICK_PERIOD_MS);
     }
     _isMoving = false;
-  } else if (_servo_type == ServoType::DYN_XL330) {
-    _isMoving = true;
-    _dxl.setGoalPosition(AXIS_X + 1, convertDYNIXELXL330(x + _init_param.servo[AXIS_X].offset)); 
-    _dxl.setGoalPosition(AXIS_Y + 1, convertDYNIXELXL330(y + _init_param.servo[AXIS_Y].offset)); // RT版に合わせて+180°しています。
-    _isMoving = false;
-  } else if (_servo_type == ServoType::RT_DYN_XL330) {
-    _isMoving = true;
-    _dxl.setGoalPosition(AXIS_X + 1, convertDYNIXELXL330_RT(x + _init_param.servo[AXIS_X].offset)); 
-    _dxl.setGoalPosition(AXIS_Y + 1, convertDYNIXELXL330_RT(y + _init_param.servo[AXIS_Y].offset)); // RT版に合わせて+180°しています。
-    _isMoving = false;
-    M5_LOGI("X:%f, Y:%f", getPosition(AXIS_X+1), getPosition(AXIS_Y+1));
   } else {
-    _servo_x.setEaseToD(x + _init_param.servo[AXIS_X].offset, millis_for_move);
-    _servo_y.setEaseToD(y + _init_param.servo[AXIS_Y].offset, millis_for_move);
-    _isMoving = true;
-    synchronizeAllServosStartAndWaitForAllServosToStop();
-    _isMoving = false;
+    driverMoveXY(true, plan_x.degree, millis_for_move, true, plan_y.degree, millis_for_move);
   }
-  _last_degree_x = x;
-  _last_degree_y = y;
-  //M5_LOGI("SCS: %d, %d", _last_degree_x, _last_degree_y);
+  _last_degree[AXIS_X] = plan_x.degree;
+  _last_degree[AXIS_Y] = plan_y.degree;
+  //M5_LOGI("SCS: %d, %d", _last_degree[AXIS_X], _last_degree[AXIS_Y]);
 }
 
 void StackchanSERVO::moveXY(servo_param_s servo_param_x, servo_param_s servo_param_y) {
-  if (_servo_type == ServoType::SCS) {
-    _sc.WritePos(AXIS_X + 1, convertSCS0009Pos(servo_param_x.degree + servo_param_x.offset), servo_param_x.millis_for_move);
-    _sc.WritePos(AXIS_Y + 1, convertSCS0009Pos(servo_param_y.degree + servo_param_y.offset), servo_param_y.millis_for_move);
-    _isMoving = true;
-    vTaskDelay(max(servo_param_x.millis_for_move, servo_param_y.millis_for_move)/portTICK_PERIOD_MS);
-    _isMoving = false;
-  } else if (_servo_type == ServoType::DYN_XL330) {
-    _isMoving = true;
-    _dxl.setGoalPosition(AXIS_X + 1, convertDYNIXELXL330(servo_param_x.degree + _init_param.servo[AXIS_X].offset)); 
-    _dxl.setGoalPosition(AXIS_Y + 1, convertDYNIXELXL330(servo_param_y.degree + _init_param.servo[AXIS_Y].offset)); // RT版に合わせて+180°しています。
-    _isMoving = false;
-  } else if (_servo_type == ServoType::RT_DYN_XL330) {
-    _isMoving = true;
-    _dxl.setGoalPosition(AXIS_X + 1, convertDYNIXELXL330_RT(servo_param_x.degree + _init_param.servo[AXIS_X].offset)); 
-    _dxl.setGoalPosition(AXIS_Y + 1, convertDYNIXELXL330_RT(servo_param_y.degree + _init_param.servo[AXIS_Y].offset)); // RT版に合わせて+180°しています。
-    _isMoving = false;
-    M5_LOGI("X:%f, Y:%f", getPosition(AXIS_X+1), getPosition(AXIS_Y+1));
-  } else {
-    if (servo_param_x.degree != 0) {
-      _servo_x.setEaseToD(servo_param_x.degree + servo_param_x.offset, servo_param_x.millis_for_move);
-    }
-    if (servo_param_y.degree != 0) {
-      _servo_y.setEaseToD(servo_param_y.degree + servo_param_y.offset, servo_param_y.millis_for_move);
-    }
-    _isMoving = true;
-    synchronizeAllServosStartAndWaitForAllServosToStop();
-    _isMoving = false;
+  // 渡されたoffsetは従来どおりSCSでは保存し、PWMではこの移動だけに使います。
+  // XL330は無視します。(RT_DYN_XL330はattach()で補正したoffsetを上書きしないように)
+  bool is_pwm = (_servo_type == ServoType::PWM);
+  int16_t saved_offset[2] = { _init_param.servo[AXIS_X].offset, _init_param.servo[AXIS_Y].offset };
+  if (is_pwm || (_servo_type == ServoType::SCS)) {
+    _init_param.servo[AXIS_X].offset = servo_param_x.offset;
+    _init_param.servo[AXIS_Y].offset = servo_param_y.offset;
+  }
+  // PWMは従来どおり0°を指定した軸は動かしません。
+  bool move_x = !is_pwm || (servo_param_x.degree != 0);
+  bool move_y = !is_pwm || (servo_param_y.degree != 0);
+  servo_plan_s plan_x = planMove(AXIS_X, _last_degree[AXIS_X], servo_param_x.degree, servo_param_x.millis_for_move);
+  servo_plan_s plan_y = planMove(AXIS_Y, _last_degree[AXIS_Y], servo_param_y.degree, servo_param_y.millis_for_move);
+  driverMoveXY(move_x, plan_x.degree, plan_x.millis_for_move, move_y, plan_y.degree, plan_y.millis_for_move);
+  if (move_x) _last_degree[AXIS_X] = plan_x.degree;
+  if (move_y) _last_degree[AXIS_Y] = plan_y.degree;
+  if (is_pwm) {
+    _init_param.servo[AXIS_X].offset = saved_offset[AXIS_X];
+    _init_param.servo[AXIS_Y].offset = saved_offset[AXIS_Y];
   }
-  _last_degree_x = servo_param_x.degree;
-  _last_degree_y = servo_param_y.degree;
 }
 
 // @uint32_t speed 0〜1000
 void StackchanSERVO::turnX(uint32_t speed, bool is_cw, uint32_t millis_for_move) {
-    if (speed >= 1000) {
-      speed = 1000;
-    }
-    if (is_cw) {
-      speed += 1000; // 逆回転時は+1000
-    }
-    Serial.printf("speed: %d\n", speed);
-    _sc.PWMMode(1, true); // 回転モード
-    _isMoving = true;
-    _sc.WritePWM(1, speed);
-    vTaskDelay(millis_for_move/portTICK_PERIOD_MS);
-    _isMoving = false;
-    _sc.PWMMode(1, false); // 位置決めモードへ戻す 
-  return;
+  if (_driver == nullptr) return;
+  _isMoving = true;
+  _driver->turn(AXIS_X + 1, speed, is_cw, millis_for_move);
+  _isMoving = false;
 }
 
+static const char* getMotionName(Motion motion_number) {
+  switch(motion_number) {
+    case greet:  return "greet";
+    case laugh:  return "laugh";
+    case nod:    return "nod";
+    case refuse: return "refuse";
+    case test:   return "test";
+    default:     return nullptr;
+  }
+}
+
+// モーションを再生し、終わるまで待ちます。
 void StackchanSERVO::motion(Motion motion_number) {
     if (motion_number == nomove) return; 
-    moveXY(90, 75, 500);
-    switch(motion_number) {
-        case greet: 
-            moveY(90, 1000);
-            moveY(75, 1000);
-            break;
-        case laugh:
-            for (int i=0; i<5; i++) {
-                moveY(80, 500);
-                moveY(60, 500);
-            }
-            break;
-        case nod:
-            for (int i=0; i<5; i++) {
-                moveY(90, 1000);
-                moveY(60, 1000);
+    if (!startMotion(motion_number)) {
+        Serial.printf("invalid motion number: %d\n", motion_number);
+        return;
+    }
+    while (isPlayingMotion()) {
+        tick();
+        vTaskDelay(SERVO_TICK_INTERVAL/portTICK_PERIOD_MS);
+    }
+}
+
+void StackchanSERVO::motion(const char *motion_name) {
+    if (!startMotion(motion_name)) {
+        Serial.printf("invalid motion name: %s\n", motion_name);
+        return;
+    }
+    while (isPlayingMotion()) {
+        tick();
+        vTaskDelay(SERVO_TICK_INTERVAL/portTICK_PERIOD_MS);
+    }
+}
+
+bool StackchanSERVO::startMotion(Motion motion_number) {
+    const char *motion_name = getMotionName(motion_number);
+    if (motion_name == nullptr) return false;
+    return startMotion(motion_name);
+}
+
+bool StackchanSERVO::startMotion(const char *motion_name) {
+    const motion_entry_s *entry;
+    if (_motion_library != nullptr) {
+        entry = _motion_library->find(motion_name);
+        _motion_player.settings = _motion_library->getSettings();
+    } else {
+        entry = StackchanMotionLibrary::findBuiltin(motion_name);
+        _motion_player.settings = StackchanMotionLibrary::getDefaultSettings();
+    }
+    if (entry == nullptr) return false;
+    _motion_player.motion = entry;
+    _motion_player.phase = MOTION_PREPARE;
+    _motion_player.repeat_count = 0;
+    _motion_player.index = 0;
+    _motion_player.phase_start = millis();
+    _replay.phase = MOTION_IDLE;
+    moveXYAsync(_motion_player.settings->start_x, _motion_player.settings->start_y, _motion_player.settings->start_time);
+    return true;
+}
+
+// モーションのキーフレーム表を時刻順にたどり、開始時刻になったキーフレームの移動を開始します。
+void StackchanSERVO::updateMotion(uint32_t now) {
+    motion_player_s *p = &_motion_player;
+    if (p->phase == MOTION_PREPARE) {
+        // 開始位置への移動が終わったら(サーボの応答で確認できる場合は到達したら)キーフレームを開始します。
+        if (isAnyActive()) return;
+        p->phase = MOTION_KEYFRAME;
+        p->phase_start = now;
+    }
+    if (p->phase == MOTION_KEYFRAME) {
+        bool write[SERVO_AXIS_MAX] = {};
+        const motion_entry_s *m = p->motion;
+        while (p->phase == MOTION_KEYFRAME) {
+            uint32_t elapsed = now - p->phase_start;
+            while ((p->index < m->keyframe_num) && (m->keyframes[p->index].start <= elapsed)) {
+                const motion_keyframe_s *kf = &m->keyframes[p->index++];
+                startTrajectory((ServoAxis)kf->axis, kf->degree, kf->millis_for_move, p->phase_start + kf->start, kf->ease);
+                write[kf->axis] = (axisDriver(kf->axis) != nullptr) && axisDriver(kf->axis)->generatesProfile();
             }
-            break;
-        case refuse:
-            for (int i=0; i<2; i++) {
-                moveX(70,  500);
-                moveX(110, 500);
+            if ((p->index < m->keyframe_num) || (elapsed < m->period)) break;
+            // 繰り返し1回分が終了
+            p->phase_start += m->period;
+            p->index = 0;
+            if (++p->repeat_count >= m->repeat) {
+                p->phase = MOTION_END_WAIT;
             }
-            break;
-        case test:
-            moveX(45,  1000);
-            moveX(135, 1000);
-            moveX(90, 1000);
-            moveY(50, 1000);
-            moveY(90, 1000);
-            break;
-        default:
-            Serial.printf("invalid motion number: %d\n", motion_number);
-            break;
+        }
+        writeTrajectories(write, true, 0);
+    }
+    if (p->phase == MOTION_END_WAIT) {
+        if (now - p->phase_start < p->settings->end_wait) return;
+        p->phase = MOTION_RETURN;
+        p->phase_start = now;
+        moveXYAsync(_init_param.servo[AXIS_X].start_degree, _init_param.servo[AXIS_Y].start_degree, p->settings->return_time);
+    }
+    if (p->phase == MOTION_RETURN) {
+        if (isAnyActive()) return;
+        p->phase = MOTION_IDLE;
     }
-    delay(1000);
-    moveXY(_init_param.servo[AXIS_X].start_degree, _init_param.servo[AXIS_Y].degree, 1000);
 }
 
+bool StackchanSERVO::startRecording(StackchanMotionRecording *recording, uint16_t interval) {
+  if ((_driver == nullptr) || (recording == nullptr)) return false;
+  stop();
+  float degree[SERVO_AXIS_MAX];
+  if (!_driver->readPosition(degree) || !_driver->setTorque(false)) {
+    M5_LOGE("Recording is not supported by ServoType:%d", _servo_type);
+    return false;
+  }
+  recording->clear(interval);
+  _recording = recording;
+  _last_record_millis = millis() - recording->getInterval();
+  recordSample(millis());
+  return true;
+}
+
+// 一定間隔で両軸の現在位置を読み出して記録します。
+void StackchanSERVO::recordSample(uint32_t now) {
+  if (now - _last_record_millis < _recording->getInterval()) return;
+  _last_record_millis += _recording->getInterval();
+  if (now - _last_record_millis >= _recording->getInterval()) {
+    // tick()が遅れた場合は間隔を詰めずに現在の時刻から数え直します。
+    _last_record_millis = now;
+  }
+  float degree[SERVO_AXIS_MAX];
+  if (!_driver->readPosition(degree)) return;
+  // 非同期移動の目標と同じ1°単位で記録します。(再生時に丸めずにそのまま目標にできるように)
+  int16_t x = lroundf(degree[AXIS_X]) - _init_param.servo[AXIS_X].offset;
+  int16_t y = lroundf(degree[AXIS_Y]) - _init_param.servo[AXIS_Y].offset;
+  if (!_recording->append(x, y)) {
+    M5_LOGI("Recording buffer is full: %d samples", _recording->getSampleNum());
+    stopRecording();
+  }
+}
+
+void StackchanSERVO::stopRecording() {
+  if (_recording == nullptr) return;
+  _recording = nullptr;
+  // 目標位置を現在の位置にしてからトルクをONにします。(記録前の目標へ急に戻らないように)
+  float degree[SERVO_AXIS_MAX];
+  if (_driver->readPosition(degree)) {
+    _last_degree[AXIS_X] = lroundf(degree[AXIS_X]) - _init_param.servo[AXIS_X].offset;
+    _last_degree[AXIS_Y] = lroundf(degree[AXIS_Y]) - _init_param.servo[AXIS_Y].offset;
+    writeXY(true, _last_degree[AXIS_X], 0, true, _last_degree[AXIS_Y], 0);
+  }
+  _driver->setTorque(true);
+}
+
+bool StackchanSERVO::startReplay(const StackchanMotionRecording *recording, uint32_t millis_for_prepare) {
+  if ((_driver == nullptr) || (recording == nullptr) || (recording->getSampleNum() == 0) || isRecording()) return false;
+  stop();
+  _replay.recording = recording;
+  _replay.offset = recording->readSample(0, _replay.value);
+  _replay.index = 1;
+  _replay.phase = MOTION_PREPARE;
+  moveXYAsync(_replay.value[AXIS_X], _replay.value[AXIS_Y], millis_for_prepare);
+  return true;
+}
+
+// サンプルの時刻になったら、次のサンプルへサンプルの間隔で移動する非同期移動を開始します。
+void StackchanSERVO::updateReplay(uint32_t now) {
+  motion_replay_s *r = &_replay;
+  if (r->phase == MOTION_PREPARE) {
+    if (_trajectory[AXIS_X].active || _trajectory[AXIS_Y].active) return;
+    r->phase = MOTION_KEYFRAME;
+    r->start_millis = now;
+  }
+  if (r->phase != MOTION_KEYFRAME) return;
+  uint32_t interval = r->recording->getInterval();
+  bool write = false;
+  while ((r->index < r->recording->getSampleNum()) && ((uint32_t)(r->index - 1) * interval <= now - r->start_millis)) {
+    r->offset = r->recording->readSample(r->offset, r->value);
+    if (r->offset == 0) {
+      r->index = r->recording->getSampleNum();
+      break;
+    }
+    uint32_t start = r->start_millis + (uint32_t)(r->index - 1) * interval;
+    startTrajectory(AXIS_X, r->value[AXIS_X], interval, start, SERVO_EASE_LINEAR);
+    startTrajectory(AXIS_Y, r->value[AXIS_Y], interval, start, SERVO_EASE_LINEAR);
+    r->index++;
+    write = true;
+  }
+  if (write && _driver->generatesProfile()) {
+    writeXY(true, _trajectory[AXIS_X].target_degree, _trajectory[AXIS_X].millis_for_move,
+            true, _trajectory[AXIS_Y].target_degree, _trajectory[AXIS_Y].millis_for_move);
+  }
+  if ((r->index >= r->recording->getSampleNum()) && !_trajectory[AXIS_X].active && !_trajectory[AXIS_Y].active) {
+    r->phase = MOTION_IDLE;
+  }
+}
+
+void StackchanSERVO::startTrajectory(ServoAxis axis, int degree, uint32_t millis_for_move, uint32_t now, uint8_t ease) {
+  servo_trajectory_s *t = &_trajectory[axis];
+  if (!t->active) {
+    t->current_degree = _last_degree[axis];
+  }
+  // 移動中に再指示された場合は現在の角度から新しい目標へ移動します。
+  servo_plan_s plan = planMove(axis, t->current_degree, degree, millis_for_move);
+  t->start_degree      = t->current_degree;
+  t->target_degree     = plan.degree;
+  t->start_millis      = now;
+  t->millis_for_move   = plan.millis_for_move;
+  t->last_write_millis = now;
+  t->ease              = (plan.millis_for_accel > 0) ? SERVO_EASE_TRAPEZOID : ease;
+  t->accel_ratio       = servoEaseProgressQ15(plan.millis_for_accel, plan.millis_for_move);
+  t->active            = true;
+  t->arrived           = false;
+  t->stalled           = false;
+  t->deferred          = false;
+  _isMoving = true;
+}
+
+void StackchanSERVO::moveXAsync(int x, uint32_t millis_for_move) {
+  moveAxisAsync(AXIS_X, x, millis_for_move);
+}
+
+void StackchanSERVO::moveYAsync(int y, uint32_t millis_for_move) {
+  moveAxisAsync(AXIS_Y, y, millis_for_move);
+}
+
+void StackchanSERVO::moveXYAsync(int x, int y, uint32_t millis_for_move) {
+  const servo_axis_target_s targets[SERVO_AXIS_XY_NUM] = { { AXIS_X, (int16_t)x }, { AXIS_Y, (int16_t)y } };
+  moveAxesAsync(targets, SERVO_AXIS_XY_NUM, millis_for_move);
+}
+
+void StackchanSERVO::moveAxisAsync(ServoAxis axis, int degree, uint32_t millis_for_move) {
+  const servo_axis_target_s target = { (uint8_t)axis, (int16_t)degree };
+  moveAxesAsync(&target, 1, millis_for_move);
+}
+
+void StackchanSERVO::moveAxesAsync(const servo_axis_target_s *targets, uint8_t target_num, uint32_t millis_for_move) {
+  uint32_t now = millis();
+  // 複数の軸を同時に動かす場合は、最も遅い軸の最短時間に合わせます。
+  uint32_t millis_for_all = millis_for_move;
+  for (int i = 0; i < target_num; i++) {
+    uint8_t axis = targets[i].axis;
+    if (axis >= _axis_num) continue;
+    servo_motion_limit_s limit = scaledMotionLimit(axis);
+    uint32_t m = planServoMove(currentDegree((ServoAxis)axis), targets[i].degree, millis_for_move,
+                               _init_param.servo[axis].lower_limit, _init_param.servo[axis].upper_limit,
+                               &limit).millis_for_move;
+    if (m > millis_for_all) millis_for_all = m;
+  }
+  uint32_t start;
+  millis_for_move = governMove(targets, target_num, millis_for_all, now, &start);
+  bool write[SERVO_AXIS_MAX] = {};
+  for (int i = 0; i < target_num; i++) {
+    uint8_t axis = targets[i].axis;
+    if (axis >= _axis_num) continue;
+    startTrajectory((ServoAxis)axis, targets[i].degree, millis_for_move, start, _ease);
+    _trajectory[axis].deferred = (start != now);
+    StackchanServoDriver *driver = axisDriver(axis);
+    // サーボ側でプロファイルを生成する場合は目標値を1回送るだけです。(開始を遅らせる場合は開始時にtick()で送ります。)
+    write[axis] = (driver != nullptr) && !_trajectory[axis].deferred
+               && (driver->generatesProfile() || (_trajectory[axis].millis_for_move == 0));
+  }
+  writeTrajectories(write, true, 0);
+}
+
+// 非同期移動を進めます。loop()等から定期的に呼び出してください。
+void StackchanSERVO::tick(uint32_t now) {
+  if (_driver_num == 0) return;
+  if (_recording != nullptr) {
+    // 記録中はトルクがOFFなので移動は行いません。
+    recordSample(now);
+    return;
+  }
+  bool moving = false;
+  bool write[SERVO_AXIS_MAX] = {};
+  bool start_write[SERVO_AXIS_MAX] = {};
+  bool bus_used = pollArrival(now);
+  for (int axis = 0; axis < _axis_num; axis++) {
+    servo_trajectory_s *t = &_trajectory[axis];
+    if (!t->active) continue;
+    StackchanServoDriver *driver = axisDriver(axis);
+    if (driver == nullptr) {
+      t->active = false;
+      continue;
+    }
+    bool profile = driver->generatesProfile();
+    bool feedback = driver->supportsFeedback();
+    if (t->deferred) {
+      // 電流の上限で開始を遅らせている移動は、開始時刻に目標を送ります。
+      moving = true;
+      if ((int32_t)(now - t->start_millis) < 0) continue;
+      t->deferred = false;
+      t->arrived = false;
+      start_write[axis] = profile || (t->millis_for_move == 0);
+    }
+    uint32_t elapsed = now - t->start_millis;
+    bool done = (elapsed >= t->millis_for_move);
+    if (feedback) {
+      // 移動時間ではなく、サーボが目標に到達した時点(またはタイムアウト)で完了とします。
+      done = t->arrived || (elapsed >= t->millis_for_move + _arrival_timeout);
+      if (done && !t->arrived) {
+        t->stalled = true;
+        M5_LOGE("Servo axis:%d did not reach %d degree (timeout)", axis, t->target_degree);
+      }
+    }
+    if (done) {
+      if (t->current_degree != t->target_degree) {
+        t->current_degree = t->target_degree;
+        write[axis] = !profile;
+      }
+      t->active = false;
+      _last_degree[axis] = t->target_degree;
+      continue;
+    }
+    moving = true;
+    if (elapsed >= t->millis_for_move) {
+      // 到達待ち
+      t->current_degree = t->target_degree;
+      continue;
+    }
+    // テーブルを引くだけで、tickでは浮動小数点の計算を行いません。
+    int32_t p = servoEaseProgressQ15(elapsed, t->millis_for_move);
+    int32_t e = (t->ease == SERVO_EASE_TRAPEZOID) ? trapezoidEaseQ15(p, t->accel_ratio) : servoEaseQ15(t->ease, p);
+    int16_t degree = servoEaseLerp(t->start_degree, t->target_degree, e);
+    if (profile) {
+      // サーボ側で補間中なので角度の記録のみ行います。
+      t->current_degree = degree;
+      continue;
+    }
+    // 書き込みの間隔はドライバ(バス)ごとに数え、同じドライバの軸は同じtickでまとめて書き込みます。
+    if ((degree != t->current_degree) && (now - _driver_write_millis[_axis_driver[axis]] >= SERVO_TICK_INTERVAL)) {
+      t->current_degree = degree;
+      t->last_write_millis = now;
+      write[axis] = true;
+    }
+  }
+  // 同じtickで更新する軸は、ドライバごとに1回の送信にまとめます。
+  for (int axis = 0; axis < _axis_num; axis++) {
+    if (write[axis]) _driver_write_millis[_axis_driver[axis]] = now;
+  }
+  writeTrajectories(start_write, true, 0);
+  writeTrajectories(write, false, SERVO_TICK_INTERVAL);
+  for (int axis = 0; axis < _axis_num; axis++) {
+    bus_used = bus_used || write[axis] || start_write[axis];
+  }
+  // 移動の完了を反映してからモーションを進めるので、到達後すぐに次のフェーズへ移れます。
+  updateMotion(now);
+  updateReplay(now);
+  // 温度などの読み出しはバスを使わなかった回に行い、移動の書き込みを遅らせないようにします。
+  if (!bus_used) {
+    pollHealth(now);
+  }
+  _isMoving = moving || isPlayingMotion() || isReplaying() || isAnyActive();
+}
+
+// 非同期移動とモーションの再生を現在の位置で中断します。
+void StackchanSERVO::stop() {
+  _motion_player.phase = MOTION_IDLE;
+  _replay.phase = MOTION_IDLE;
+  bool write[SERVO_AXIS_MAX] = {};
+  for (int axis = 0; axis < _axis_num; axis++) {
+    servo_trajectory_s *t = &_trajectory[axis];
+    if (!t->active) continue;
+    t->active = false;
+    write[axis] = (axisDriver(axis) != nullptr) && axisDriver(axis)->generatesProfile();
+    _last_degree[axis] = t->current_degree;
+  }
+  writeTrajectories(write, false, 0);
+  _isMoving = false;
+}
@@ -3,19 +3,46 @@
 #ifndef _STACKCHAN_SERVO_H_
 #define _STACKCHAN_SERVO_H_
 
-// コンパイル時にServoEasing.hppをIncludeしてくださいという警告が出ますが、hppにすると二重定義のリンクエラーが出ます。
-// その対処でStackchan_servo.hはh, Stackchan_servo.cppはhppをincludeしています。
-#define SUPPRESS_HPP_WARNING
-#include <Ticker.h>
-#include <ESP32Servo.h>
-#include <ServoEasing.h>
-#include <SCServo.h>
-#include <M5Unified.h>
-#include <Dynamixel2Arduino.h>
+#include "Stackchan_platform.h"
+#include "Stackchan_servo_driver.h"
+#include "Stackchan_motion.h"
+#include "Stackchan_planner.h"
+#include "Stackchan_servo_health.h"
+#include "Stackchan_motion_recording.h"
 
-using namespace ControlTableItem;
-
-#define SERIAL_EASE_DIVISION  5      // シリアルサーボのEasing分割数
+#ifndef SERIAL_EASE_DIVISION
+#define SERIAL_EASE_DIVISION  5      // シリアルサーボのEasing分割数(最小値)
+#endif
+#ifndef SERIAL_EASE_INTERVAL
+#define SERIAL_EASE_INTERVAL  20     // シリアルサーボのEasing更新周期(msec) 20msec = 50Hz
+#endif
+#ifndef SERVO_TICK_INTERVAL
+#define SERVO_TICK_INTERVAL   20     // 非同期移動時にサーボへ書き込む最小間隔(msec)
+#endif
+#ifndef SERVO_REPLAY_PREPARE_TIME
+#define SERVO_REPLAY_PREPARE_TIME   1000   // 記録の再生前に最初の姿勢へ移動する時間(msec)
+#endif
+#ifndef SERVO_ARRIVAL_TOLERANCE
+#define SERVO_ARRIVAL_TOLERANCE     2.0f   // 目標に到達したとみなす角度の差(deg)
+#endif
+#ifndef SERVO_ARRIVAL_POLL_INTERVAL
+#define SERVO_ARRIVAL_POLL_INTERVAL 20     // 到達確認でサーボの状態を読み出す最小間隔(msec)
+#endif
+#ifndef SERVO_ARRIVAL_TIMEOUT
+#define SERVO_ARRIVAL_TIMEOUT       500    // 移動時間を過ぎてからこの時間内に到達しない場合は停止(ストール)とみなす(msec)
+#endif
+#ifndef SERVO_POWER_BASE_VELOCITY
+#define SERVO_POWER_BASE_VELOCITY       360.0f  // 最大速度が未設定の軸に倍率(velocity_scale)を掛ける基準の速度(deg/sec)
+#endif
+#ifndef SERVO_POWER_BASE_ACCELERATION
+#define SERVO_POWER_BASE_ACCELERATION   3600.0f // 最大加速度が未設定の軸に倍率を掛ける基準の加速度(deg/sec^2)
+#endif
+#ifndef SERVO_POWER_CURRENT_AT_BASE
+#define SERVO_POWER_CURRENT_AT_BASE     500     // 基準の速度で移動する1軸の電流の見積もり(mA) 電流は速度に比例するとみなします
+#endif
+#ifndef SERVO_POWER_MIN_CURRENT
+#define SERVO_POWER_MIN_CURRENT         50      // 電流の上限の残りがこれ未満の場合は、他の軸が止まるまで開始を遅らせる(mA)
+#endif
 
 enum Motion {
     nomove,    // 動かない
@@ -26,55 +53,127 @@ enum Motion {
     test = 99,      // テスト用
 };
 
-enum ServoAxis {
-    AXIS_X,
-    AXIS_Y
-};
+// 複数の軸をまとめて移動する場合(moveAxesAsync)の1軸分の目標
+typedef struct ServoAxisTarget {
+    uint8_t axis;                      // ServoAxis
+    int16_t degree;                    // 目標角度
+} servo_axis_target_s;
 
-enum ServoType {
-    PWM,             // SG90 PWM
-    SCS,             // Feetech SCS0009
-    DYN_XL330,        // Dynamixel XL330
-    RT_DYN_XL330     // Dynamixel XL330 on RT version stackchan
-};
+// 給電状態に応じた移動の制限(StackchanPowerGovernorが設定します)
+typedef struct ServoPowerLimit {
+    float velocity_scale;              // 最大速度の倍率(1.0で制限なし)
+    float acceleration_scale;          // 最大加速度の倍率(1.0で制限なし)
+    uint16_t current_budget;           // 同時に動かす軸の電流の見積もりの上限(mA) 0の場合は制限なし
+} servo_power_limit_s;
 
-typedef struct ServoParam {
-    int pin;                    // サーボのピン番号
-    int16_t start_degree;              // 初期角度
-    int16_t offset;                    // オフセット（90°からの+-）
-    int16_t degree;                    // 角度
-    uint32_t millis_for_move;         // 移動時間(msec)
-    int16_t lower_limit;              // サーボ角度の下限
-    int16_t upper_limit;              // サーボ角度の上限
-} servo_param_s;
+// 非同期移動(moveXYAsync)用の軸ごとの軌道
+typedef struct ServoTrajectory {
+    int16_t start_degree;              // 移動開始時の角度
+    int16_t target_degree;             // 目標角度
+    int16_t current_degree;            // 最後に書き込んだ角度
+    uint32_t start_millis;             // 移動開始時刻(msec)
+    uint32_t millis_for_move;          // 移動時間(msec)
+    uint32_t last_write_millis;        // 最後にサーボへ書き込んだ時刻(msec)
+    uint8_t ease;                      // ServoEase
+    int32_t accel_ratio;               // 移動時間に対する加速時間の割合(Q15, SERVO_EASE_TRAPEZOIDの場合)
+    bool active;                       // 移動中かどうか
+    bool deferred;                     // 電流の上限で開始を遅らせている(start_millisに開始)
+    bool arrived;                      // サーボの応答で目標への到達を確認済み
+    bool stalled;                      // タイムアウトまでに目標へ到達しなかった
+} servo_trajectory_s;
 
+enum MotionPhase {
+    MOTION_IDLE,
+    MOTION_PREPARE,                    // 開始位置へ移動中
+    MOTION_KEYFRAME,                   // キーフレームを再生中
+    MOTION_END_WAIT,                   // 終了後の待ち時間
+    MOTION_RETURN                      // 初期位置へ移動中
+};
 
-typedef struct  StackchanServo{
-    servo_param_s servo[2];
-} stackchan_servo_initial_param_s;
-
+// モーション再生の状態
+typedef struct MotionPlayer {
+    const motion_entry_s *motion;
+    const motion_settings_s *settings;
+    uint8_t phase;                     // MotionPhase
+    uint8_t repeat_count;              // 再生が終わった繰り返し回数
+    uint16_t index;                    // 次に開始するキーフレーム
+    uint32_t phase_start;              // 現在のフェーズ(繰り返し)の開始時刻(msec)
+} motion_player_s;
 
-const float DXL_PROTOCOL_VERSION = 2.0f;
+// 記録(StackchanMotionRecording)の再生の状態
+typedef struct MotionReplay {
+    const StackchanMotionRecording *recording;
+    uint8_t phase;                     // MOTION_IDLE, MOTION_PREPARE(最初の姿勢へ移動中), MOTION_KEYFRAME(再生中)
+    uint16_t index;                    // 次に目標とするサンプル
+    uint16_t offset;                   // 次に目標とするサンプルの位置(byte)
+    int16_t value[2];                  // 最後に読み出したサンプル(deg)
+    uint32_t start_millis;             // 再生開始時刻(msec)
+} motion_replay_s;
 
 class StackchanSERVO {
     protected:
         ServoType _servo_type;
-        SCSCL _sc;
-        Dynamixel2Arduino _dxl;
-        ServoEasing _servo_x;
-        ServoEasing _servo_y;
+        StackchanServoDriver *_driver;                   // X, Yのドライバ
+        StackchanServoDriver *_drivers[SERVO_AXIS_MAX];  // サーボの種類ごとのドライバ(_drivers[0]がX, Y)
+        uint8_t _driver_num;
+        uint8_t _axis_driver[SERVO_AXIS_MAX];            // 軸ごとのドライバ(_driversの番号)
+        uint32_t _driver_write_millis[SERVO_AXIS_MAX];   // ドライバごとに最後に非同期移動で書き込んだ時刻(msec)
+        uint8_t _axis_num;                               // 使用する軸の数
+        StackchanServoDriver* axisDriver(uint8_t axis) { return _drivers[_axis_driver[axis]]; }
+        void deleteDrivers();
         void attachServos();
+        void startInitialPose(uint32_t now);
+        void cancelTrajectory(bool cancel_x, bool cancel_y);
         stackchan_servo_initial_param_s _init_param;
         bool _isMoving;
-        int _last_degree_x;                              // 前回のX軸の角度
-        int _last_degree_y;                              // 前回のY軸の角度
+        int _last_degree[SERVO_AXIS_MAX];                // 軸ごとの前回の角度
+        uint32_t _serial_ease_interval;                  // シリアルサーボのEasing更新周期(msec)
+        uint8_t _ease;                                   // moveX/moveY/moveXYで使うカーブ(ServoEase)
+        servo_trajectory_s _trajectory[SERVO_AXIS_MAX];  // 非同期移動の軌道
+        servo_motion_limit_s _motion_limit[SERVO_AXIS_MAX]; // 軸ごとの速度・加速度の上限
+        bool isAnyActive();
+        servo_power_limit_s _power_limit;                // 給電状態に応じた移動の制限
+        servo_motion_limit_s scaledMotionLimit(uint8_t axis);
+        uint32_t estimateCurrent(int from, int to, uint32_t millis_for_move);
+        uint32_t governMove(const servo_axis_target_s *targets, uint8_t target_num, uint32_t millis_for_move,
+                            uint32_t now, uint32_t *start);
+        int currentDegree(ServoAxis axis);
+        servo_plan_s planMove(ServoAxis axis, int from, int degree, uint32_t millis_for_move);
+        uint32_t planMillisXY(int from_x, int x, int from_y, int y, uint32_t millis_for_move);
+        StackchanMotionLibrary *_motion_library;         // nullptrの場合は組み込みのモーションを使用
+        motion_player_s _motion_player;
+        void startTrajectory(ServoAxis axis, int degree, uint32_t millis_for_move, uint32_t now,
+                             uint8_t ease = SERVO_EASE_QUAD);
+        void updateMotion(uint32_t now);
+        float _arrival_tolerance;                        // 到達とみなす角度の差(deg)
+        uint32_t _arrival_timeout;                       // 到達確認のタイムアウト(msec)
+        uint32_t _last_feedback_millis;                  // 最後にサーボの状態を読み出した時刻(msec)
+        bool isArrived(const servo_feedback_s *feedback, ServoAxis axis, int degree);
+        bool pollArrival(uint32_t now);
+        StackchanServoHealthLog _health_log;             // 温度・電流・電圧の記録
+        uint32_t _health_interval;                       // 温度・電流・電圧を読み出す間隔(msec)
+        uint32_t _last_health_millis;                    // 最後に温度・電流・電圧を読み出した時刻(msec)
+        bool _health_warning[SERVO_AXIS_MAX];            // 警告中の軸(温度が警告値以上またはハードウェアエラー)
+        void pollHealth(uint32_t now);
+        StackchanMotionRecording *_recording;            // 記録中のバッファ(記録中でない場合はnullptr)
+        uint32_t _last_record_millis;                    // 最後に現在位置を記録した時刻(msec)
+        motion_replay_s _replay;
+        void recordSample(uint32_t now);
+        void updateReplay(uint32_t now);
+        bool waitArrival(bool move_x, int x, bool move_y, int y, uint32_t millis_for_move);
+        void writeXY(bool move_x, int x, uint32_t millis_for_move_x,
+                     bool move_y, int y, uint32_t millis_for_move_y);
+        void writeTrajectories(const bool *write, bool to_target, uint32_t millis_for_move);
+        void driverMoveXY(bool move_x, int x, uint32_t millis_for_move_x,
+                          bool move_y, int y, uint32_t millis_for_move_y);
     public:
         StackchanSERVO();
         ~StackchanSERVO();
         
         float getPosition(int x);
 
-        void begin(stackchan_servo_initial_param_s init_params);
+        // init_params.axis_numで追加の軸を使用します。追加の軸のサーボの種類はservo[].servo_typeで指定します。
+        void begin(stackchan_servo_initial_param_s init_params, ServoType servo_type=PWM);
         void begin(int servo_pin_x, int16_t start_degree_x, int16_t offset_x, 
                    int servo_pin_y, int16_t start_degree_y, int16_t offset_y,
                    ServoType servo_type=PWM);
@@ -85,7 +184,68 @@ class StackchanSERVO {
         void moveY(servo_param_s servo_param_y);
         void moveXY(servo_param_s servo_param_x, servo_param_s servo_param_y);
         void motion(Motion motion_no);
+        void motion(const char *motion_name);
+        // モーションの再生を開始してすぐに戻ります。再生はtick()で進みます。
+        bool startMotion(Motion motion_no);
+        bool startMotion(const char *motion_name);
+        bool isPlayingMotion() { return _motion_player.phase != MOTION_IDLE; }
+        // 記録(ティーチング)を開始します。トルクをOFFにし、手で動かした両軸の位置をintervalごとに記録します。(XL330, SCS)
+        // 記録はtick()で行い、バッファが一杯になると終了します。トルクをOFFにできない場合はfalse
+        bool startRecording(StackchanMotionRecording *recording, uint16_t interval = MOTION_RECORDING_INTERVAL);
+        // 記録を終了し、現在の位置でトルクをONにします。
+        void stopRecording();
+        bool isRecording() { return _recording != nullptr; }
+        // 記録を再生します。最初の姿勢へ移動してから、サンプルの間を非同期移動でつないで再生します。再生はtick()で進みます。
+        bool startReplay(const StackchanMotionRecording *recording, uint32_t millis_for_prepare = SERVO_REPLAY_PREPARE_TIME);
+        bool isReplaying() { return _replay.phase != MOTION_IDLE; }
+        void setMotionLibrary(StackchanMotionLibrary *motion_library) { _motion_library = motion_library; }
         void turnX(uint32_t speed, bool is_cw, uint32_t millis_for_move);
+        // 可動範囲(lower_limit〜upper_limit)を設定します。範囲外の角度は範囲内に収めて移動します。
+        void setLimit(ServoAxis axis, int16_t lower_limit, int16_t upper_limit);
+        // offset(サーボ上の角度 = 角度 + offset)を設定します。キャリブレーションの結果を反映する場合などに使います。
+        void setOffset(ServoAxis axis, int16_t offset);
+        // 最大速度(deg/sec)と最大加速度(deg/sec^2)を設定します。0の場合は制限なし
+        // 設定すると移動時間は最短時間以上に延び、台形速度で移動します。
+        void setMotionLimit(ServoAxis axis, float max_velocity, float max_acceleration);
+        // 給電状態に応じて最大速度・最大加速度に倍率を掛け、同時に動かす軸の電流を制限します。
+        // 電流の見積もりが上限を超える非同期移動は移動時間を延ばし、余裕がない場合は他の軸が止まるまで開始を遅らせます。
+        void setPowerLimit(const servo_power_limit_s *power_limit) { _power_limit = *power_limit; }
+        const servo_power_limit_s* getPowerLimit() { return &_power_limit; }
+        // 現在の角度からdegreeへ移動するのに必要な最短時間(msec)を返します。
+        uint32_t getMinimumMillisForMove(ServoAxis axis, int degree);
+        // moveX/moveY/moveXY(非同期版を含む)で使うカーブ(ServoEase)を設定します。初期値はSERVO_EASE_QUAD
+        void setEase(uint8_t ease);
+        // シリアルサーボ(SCS)でmoveXYのEasingを分割して送る周期(msec)を設定します。
+        void setSerialEaseInterval(uint32_t interval) { _serial_ease_interval = (interval == 0) ? 1 : interval; }
+        // 非同期移動。目標を登録してすぐに戻るので、loop()等からtick()を呼び出してください。
+        void moveXAsync(int x, uint32_t millis_for_move = 0);
+        void moveYAsync(int y, uint32_t millis_for_move = 0);
+        void moveXYAsync(int x, int y, uint32_t millis_for_move);
+        // 追加の軸を含む任意の軸の非同期移動。複数の軸は遅い軸の最短時間に合わせ、ドライバごとに1回の送信にまとめます。
+        void moveAxisAsync(ServoAxis axis, int degree, uint32_t millis_for_move = 0);
+        void moveAxesAsync(const servo_axis_target_s *targets, uint8_t target_num, uint32_t millis_for_move);
+        // 使用する軸の数(X, Yと追加の軸)
+        uint8_t getAxisNum() { return _axis_num; }
+        // 軸の現在の角度(非同期移動中は最後に書き込んだ角度)
+        int getDegree(ServoAxis axis) { return currentDegree(axis); }
+        void tick(uint32_t now);
+        void tick() { tick(millis()); }
+        void stop();
         bool isMoving() { return _isMoving; }
+        // サーボの現在位置を読み出せる場合(XL330)の到達判定の許容角度(deg)とタイムアウト(msec)を設定します。
+        void setArrivalCheck(float tolerance, uint32_t timeout) { _arrival_tolerance = tolerance; _arrival_timeout = timeout; }
+        // 直前の移動でタイムアウトまでに目標へ到達しなかった場合はtrue
+        bool isStalled(ServoAxis axis) { return _trajectory[axis].stalled; }
+        // 温度・電流・電圧・ハードウェアエラーを読み出す間隔(msec)を設定します。(XL330のみ, 0の場合は読み出さない)
+        // 読み出しはtick()の中で、サーボへの書き込みや到達確認を行わなかった回にのみ行います。
+        void setHealthInterval(uint32_t interval) { _health_interval = interval; }
+        StackchanServoHealthLog* getHealthLog() { return &_health_log; }
+        // 最後に読み出した値で、温度がSERVO_HEALTH_TEMPERATURE_WARNING以上またはハードウェアエラーがある場合はtrue
+        bool hasHealthWarning(ServoAxis axis) { return _health_warning[axis]; }
+        StackchanServoDriver* getDriver() { return _driver; }
+        // 軸を受け持つドライバを返します。
+        StackchanServoDriver* getDriver(ServoAxis axis) { return (axis < _axis_num) ? axisDriver(axis) : nullptr; }
+        // 軸の初期位置、offset、可動範囲を返します。
+        const servo_param_s* getServoParam(ServoAxis axis) { return &_init_param.servo[axis]; }
 };
-#endif // _STACKCHAN_SERVO_H_
\ No newline at end of file
+#endif // _STACKCHAN_SERVO_H_
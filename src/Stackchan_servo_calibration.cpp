@@ -0,0 +1,150 @@
+// Copyright (c) Takao Akaki
+#include "Stackchan_servo_calibration.h"
+
+StackchanServoCalibration::StackchanServoCalibration() : _servo(nullptr), _axis_mask(0), _center_mask(0), _axis(0),
+                                                         _phase(CALIBRATION_IDLE), _command(0.0f), _start(0.0f),
+                                                         _degree(0), _phase_millis(0) {
+  memset(_result, 0, sizeof(_result));
+}
+
+bool StackchanServoCalibration::start(StackchanSERVO *servo, uint8_t axis_mask, uint8_t center_mask) {
+  if (servo == nullptr) return false;
+  servo->stop();
+  for (int axis = 0; axis < servo->getAxisNum(); axis++) {
+    if (!(axis_mask & (1 << axis))) continue;
+    StackchanServoDriver *driver = servo->getDriver((ServoAxis)axis);
+    float degree[SERVO_AXIS_MAX];
+    if ((driver == nullptr) || !driver->readPosition(degree)) {
+      M5_LOGE("Calibration is not supported by axis:%d", axis);
+      return false;
+    }
+  }
+  for (int axis = 0; axis < SERVO_AXIS_MAX; axis++) {
+    const servo_param_s *param = servo->getServoParam((ServoAxis)axis);
+    servo_calibration_s *r = &_result[axis];
+    memset(r, 0, sizeof(servo_calibration_s));
+    r->offset      = param->offset;
+    r->lower_limit = param->lower_limit;
+    r->upper_limit = param->upper_limit;
+  }
+  _servo = servo;
+  _axis_mask = axis_mask;
+  _center_mask = center_mask;
+  _axis = 0;
+  startAxis(millis());
+  return true;
+}
+
+bool StackchanServoCalibration::calibrate(StackchanSERVO *servo, uint8_t axis_mask, uint8_t center_mask) {
+  if (!start(servo, axis_mask, center_mask)) return false;
+  while (isRunning()) {
+    tick();
+    vTaskDelay(SERVO_TICK_INTERVAL/portTICK_PERIOD_MS);
+  }
+  return isDone();
+}
+
+// 次に調べる軸の現在の角度から下側の端を探し始めます。調べる軸がない場合は終了します。
+void StackchanServoCalibration::startAxis(uint32_t now) {
+  while ((_axis < _servo->getAxisNum()) && !(_axis_mask & (1 << _axis))) _axis++;
+  if (_axis >= _servo->getAxisNum()) {
+    apply();
+    _phase = CALIBRATION_DONE;
+    return;
+  }
+  float degree[SERVO_AXIS_MAX];
+  _servo->getDriver((ServoAxis)_axis)->readPosition(degree);
+  _degree       = _servo->getDegree((ServoAxis)_axis);
+  _start        = degree[_axis];
+  _command      = _start;
+  _phase        = CALIBRATION_LOWER;
+  _phase_millis = now;
+}
+
+// 角度(offset込み)をドライバへ直接書き込みます。(StackchanSERVOの可動範囲で制限しないように)
+void StackchanServoCalibration::write(float degree, uint32_t millis_for_move) {
+  servo_write_s w;
+  w.axis            = _axis;
+  w.degree          = lroundf(degree);
+  w.millis_for_move = millis_for_move;
+  _servo->getDriver((ServoAxis)_axis)->writeAxes(&w, 1);
+}
+
+// 現在の角度を読み出し、電流(XL330)または指示した角度からの遅れで端に当たったかどうかを判定します。
+bool StackchanServoCalibration::readStop(float *present) {
+  StackchanServoDriver *driver = _servo->getDriver((ServoAxis)_axis);
+  float degree[SERVO_AXIS_MAX];
+  if (!driver->readPosition(degree)) return false;
+  *present = degree[_axis];
+  if (driver->supportsHealth()) {
+    servo_health_s health;
+    if (driver->readHealth(&health) && (abs(health.current[_axis]) >= SERVO_CALIBRATION_CURRENT_LIMIT)) {
+      return true;
+    }
+  }
+  float dir = (_phase == CALIBRATION_LOWER) ? -1.0f : 1.0f;
+  return (_command - *present) * dir >= SERVO_CALIBRATION_LAG;
+}
+
+void StackchanServoCalibration::tick(uint32_t now) {
+  if (!isRunning()) return;
+  if (_phase == CALIBRATION_RETURN) {
+    if (now - _phase_millis < SERVO_CALIBRATION_RETURN_TIME) return;
+    _axis++;
+    startAxis(now);
+    return;
+  }
+  if (now - _phase_millis < SERVO_CALIBRATION_STEP_INTERVAL) return;
+  _phase_millis = now;
+  servo_calibration_s *r = &_result[_axis];
+  float dir = (_phase == CALIBRATION_LOWER) ? -1.0f : 1.0f;
+  float present = _command;
+  bool stop = readStop(&present);
+  bool out_of_range = ((_command - _start) * dir >= SERVO_CALIBRATION_RANGE);
+  if (stop || out_of_range) {
+    if (_phase == CALIBRATION_LOWER) {
+      r->found_lower = stop;
+      r->lower_stop  = present;
+      // 端から反対側へ向かって上側の端を探します。
+      _phase   = CALIBRATION_UPPER;
+      _command = present;
+      write(_command, SERVO_CALIBRATION_STEP_INTERVAL);
+    } else {
+      r->found_upper = stop;
+      r->upper_stop  = present;
+      finishAxis(now);
+    }
+    return;
+  }
+  _command += dir * SERVO_CALIBRATION_STEP;
+  write(_command, SERVO_CALIBRATION_STEP_INTERVAL);
+}
+
+// 見つかった端から可動範囲とoffsetを求め、調べる前の角度へ戻ります。
+void StackchanServoCalibration::finishAxis(uint32_t now) {
+  const servo_param_s *param = _servo->getServoParam((ServoAxis)_axis);
+  servo_calibration_s *r = &_result[_axis];
+  if ((_center_mask & (1 << _axis)) && r->found_lower && r->found_upper) {
+    r->offset = lroundf((r->lower_stop + r->upper_stop) / 2.0f) - param->start_degree;
+  }
+  if (r->found_lower) {
+    r->lower_limit = (int16_t)ceilf(r->lower_stop) + SERVO_CALIBRATION_MARGIN - r->offset;
+  }
+  if (r->found_upper) {
+    r->upper_limit = (int16_t)floorf(r->upper_stop) - SERVO_CALIBRATION_MARGIN - r->offset;
+  }
+  M5_LOGI("Calibration axis:%d stop:%.1f(%d)-%.1f(%d) offset:%d limit:%d-%d", _axis, r->lower_stop, r->found_lower,
+          r->upper_stop, r->found_upper, r->offset, r->lower_limit, r->upper_limit);
+  write(_degree + r->offset, SERVO_CALIBRATION_RETURN_TIME);
+  _phase = CALIBRATION_RETURN;
+  _phase_millis = now;
+}
+
+void StackchanServoCalibration::apply() {
+  for (int axis = 0; axis < _servo->getAxisNum(); axis++) {
+    if (!(_axis_mask & (1 << axis))) continue;
+    const servo_calibration_s *r = &_result[axis];
+    _servo->setOffset((ServoAxis)axis, r->offset);
+    _servo->setLimit((ServoAxis)axis, r->lower_limit, r->upper_limit);
+  }
+}
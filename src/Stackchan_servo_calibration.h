@@ -0,0 +1,84 @@
+// Copyright (c) 2022 Takao Akaki
+
+#ifndef _STACKCHAN_SERVO_CALIBRATION_H_
+#define _STACKCHAN_SERVO_CALIBRATION_H_
+
+#include "Stackchan_servo.h"
+
+#ifndef SERVO_CALIBRATION_STEP
+#define SERVO_CALIBRATION_STEP          1      // 1回に進める角度(deg)
+#endif
+#ifndef SERVO_CALIBRATION_STEP_INTERVAL
+#define SERVO_CALIBRATION_STEP_INTERVAL 40     // 角度を進める間隔(msec) 1deg/40msec = 25deg/sec
+#endif
+#ifndef SERVO_CALIBRATION_RANGE
+#define SERVO_CALIBRATION_RANGE         180    // 探し始めた角度から端を探す最大の角度(deg)
+#endif
+#ifndef SERVO_CALIBRATION_CURRENT_LIMIT
+#define SERVO_CALIBRATION_CURRENT_LIMIT 300    // 端に当たったとみなす電流(mA, XL330)
+#endif
+#ifndef SERVO_CALIBRATION_LAG
+#define SERVO_CALIBRATION_LAG           5.0f   // 指示した角度から現在の角度がこれ以上遅れた場合も端に当たったとみなす(deg)
+#endif
+#ifndef SERVO_CALIBRATION_MARGIN
+#define SERVO_CALIBRATION_MARGIN        5      // 可動範囲を端から内側に取る角度(deg)
+#endif
+#ifndef SERVO_CALIBRATION_RETURN_TIME
+#define SERVO_CALIBRATION_RETURN_TIME   1000   // 端を調べた後に元の角度へ戻る時間(msec)
+#endif
+
+// 1軸分のキャリブレーションの結果
+typedef struct ServoCalibration {
+    bool found_lower;                  // 下側の端が見つかった
+    bool found_upper;                  // 上側の端が見つかった
+    float lower_stop;                  // 下側の端の角度(サーボ上の角度, offset込み)
+    float upper_stop;                  // 上側の端の角度(サーボ上の角度, offset込み)
+    int16_t offset;                    // 求めたoffset
+    int16_t lower_limit;               // 求めた可動範囲(offset前の角度) 端が見つからなかった側は元の値
+    int16_t upper_limit;
+} servo_calibration_s;
+
+enum ServoCalibrationPhase {
+    CALIBRATION_IDLE,
+    CALIBRATION_LOWER,                 // 下側の端を探している
+    CALIBRATION_UPPER,                 // 上側の端を探している
+    CALIBRATION_RETURN,                // 元の角度へ戻っている
+    CALIBRATION_DONE
+};
+
+// 機構の端(メカストッパー)を探して、可動範囲とoffsetを求めます。(XL330, SCS)
+// 軸を1つずつゆっくり動かし、電流(XL330)または指示した角度からの遅れで端に当たったことを検出します。
+// 調べている間はサーボのドライバへ直接書き込むので、StackchanSERVOで移動しないでください。
+class StackchanServoCalibration {
+    protected:
+        StackchanSERVO *_servo;
+        uint8_t _axis_mask;                              // 調べる軸(bit0: X, bit1: Y, ...)
+        uint8_t _center_mask;                            // 両端の中央を初期位置としてoffsetを求める軸
+        uint8_t _axis;                                   // 調べている軸
+        uint8_t _phase;                                  // ServoCalibrationPhase
+        float _command;                                  // 指示している角度(offset込み)
+        float _start;                                    // 端を探し始めた角度(offset込み)
+        int _degree;                                     // 調べる前の角度(offset前)
+        uint32_t _phase_millis;                          // 最後に角度を進めた(戻り始めた)時刻(msec)
+        servo_calibration_s _result[SERVO_AXIS_MAX];
+        void write(float degree, uint32_t millis_for_move);
+        bool readStop(float *present);
+        void startAxis(uint32_t now);
+        void finishAxis(uint32_t now);
+        void apply();
+    public:
+        StackchanServoCalibration();
+        // キャリブレーションを開始します。center_maskの軸(左右に対称なX軸など)はoffsetも求めます。
+        // 終了時に結果のoffsetと可動範囲をStackchanSERVOに設定します。現在の角度を読み出せないサーボ(PWM)の場合はfalse
+        bool start(StackchanSERVO *servo, uint8_t axis_mask = 0x03, uint8_t center_mask = 0x01);
+        // キャリブレーションを進めます。loop()等から定期的に呼び出してください。
+        void tick(uint32_t now);
+        void tick() { tick(millis()); }
+        // キャリブレーションを行い、終わるまで待ちます。
+        bool calibrate(StackchanSERVO *servo, uint8_t axis_mask = 0x03, uint8_t center_mask = 0x01);
+        bool isRunning() { return (_phase != CALIBRATION_IDLE) && (_phase != CALIBRATION_DONE); }
+        bool isDone() { return _phase == CALIBRATION_DONE; }
+        const servo_calibration_s* getResult(ServoAxis axis) { return &_result[axis]; }
+};
+
+#endif // _STACKCHAN_SERVO_CALIBRATION_H_
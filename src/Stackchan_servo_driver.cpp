@@ -0,0 +1,82 @@
+// Copyright (c) Takao Akaki
+#include "Stackchan_servo_driver.h"
+#include "Stackchan_servo_pwm.h"
+#include "Stackchan_servo_scs.h"
+#include "Stackchan_servo_dxl.h"
+#include "Stackchan_servo_sim.h"
+
+void StackchanServoDriver::setAxes(const uint8_t *axes, uint8_t axis_num) {
+  _axis_num = (axis_num > SERVO_AXIS_MAX) ? SERVO_AXIS_MAX : axis_num;
+  for (int i = 0; i < _axis_num; i++) {
+    _axes[i] = axes[i];
+  }
+}
+
+int StackchanServoDriver::indexOf(uint8_t axis) {
+  for (int i = 0; i < _axis_num; i++) {
+    if (_axes[i] == axis) return i;
+  }
+  return -1;
+}
+
+void StackchanServoDriver::writeXY(bool move_x, int x, uint32_t millis_for_move_x,
+                                   bool move_y, int y, uint32_t millis_for_move_y) {
+  servo_write_s writes[SERVO_AXIS_XY_NUM];
+  uint8_t write_num = 0;
+  if (move_x) writes[write_num++] = { AXIS_X, (int16_t)x, millis_for_move_x };
+  if (move_y) writes[write_num++] = { AXIS_Y, (int16_t)y, millis_for_move_y };
+  if (write_num == 0) return;
+  writeAxes(writes, write_num);
+}
+
+void StackchanServoDriver::moveXY(bool move_x, int x, uint32_t millis_for_move_x,
+                                  bool move_y, int y, uint32_t millis_for_move_y) {
+  writeXY(move_x, x, millis_for_move_x, move_y, y, millis_for_move_y);
+  uint32_t millis_for_move = max(move_x ? millis_for_move_x : 0, move_y ? millis_for_move_y : 0);
+  vTaskDelay(millis_for_move/portTICK_PERIOD_MS);
+}
+
+float StackchanServoDriver::getPresentPosition(uint8_t id) {
+  M5_LOGI("getPosition::Command is only supprted in RT_DYN_XL330");
+  return 0.0f;
+}
+
+// 現在位置を読み出せるドライバ(readFeedback)はその角度を使います。
+bool StackchanServoDriver::readPosition(float *degree) {
+  servo_feedback_s feedback;
+  if (!readFeedback(&feedback)) return false;
+  for (int i = 0; i < _axis_num; i++) {
+    degree[_axes[i]] = feedback.degree[_axes[i]];
+  }
+  return true;
+}
+
+void StackchanServoDriver::turn(uint8_t id, uint32_t speed, bool is_cw, uint32_t millis_for_move) {
+  M5_LOGI("turn::Command is only supported in SCS");
+}
+
+StackchanServoDriver* createServoDriver(ServoType servo_type) {
+  switch (servo_type) {
+#ifdef STACKCHAN_SERVO_USE_PWM
+    case ServoType::PWM:
+      return new StackchanServoPWM();
+#endif
+#ifdef STACKCHAN_SERVO_USE_SCS
+    case ServoType::SCS:
+      return new StackchanServoSCS();
+#endif
+#ifdef STACKCHAN_SERVO_USE_DYN_XL330
+    case ServoType::DYN_XL330:
+      return new StackchanServoDXL(false);
+    case ServoType::RT_DYN_XL330:
+      return new StackchanServoDXL(true);
+#endif
+#ifdef STACKCHAN_SERVO_USE_SIM
+    case ServoType::SIM:
+      return new StackchanServoSIM();
+#endif
+    default:
+      M5_LOGE("ServoType:%d is not enabled in this build.", servo_type);
+      return nullptr;
+  }
+}
@@ -0,0 +1,150 @@
+// Copyright (c) 2022 Takao Akaki
+
+#ifndef _STACKCHAN_SERVO_DRIVER_H_
+#define _STACKCHAN_SERVO_DRIVER_H_
+
+#include "Stackchan_platform.h"
+
+// 使用するサーボのドライバをビルドフラグで選択します。(例: -DSTACKCHAN_SERVO_USE_PWM)
+// 何も指定しない場合はすべてのドライバをビルドします。
+// ホスト上で動作確認するシミュレータ(SIM)は-DSTACKCHAN_SERVO_USE_SIMを指定したときのみビルドします。
+// 使わないドライバを外すと、そのサーボ用ライブラリはリンクされません。
+#if !defined(STACKCHAN_SERVO_USE_PWM) && !defined(STACKCHAN_SERVO_USE_SCS) && !defined(STACKCHAN_SERVO_USE_DYN_XL330) \
+    && !defined(STACKCHAN_SERVO_USE_SIM)
+#define STACKCHAN_SERVO_USE_PWM
+#define STACKCHAN_SERVO_USE_SCS
+#define STACKCHAN_SERVO_USE_DYN_XL330
+#endif
+
+#ifndef SERVO_READY_TIMEOUT
+#define SERVO_READY_TIMEOUT         500    // 起動時にサーボの応答(Ping)を待つ最大時間(msec)
+#endif
+#ifndef SERVO_READY_POLL_INTERVAL
+#define SERVO_READY_POLL_INTERVAL   5      // 起動時にPingを再送する間隔(msec)
+#endif
+#ifndef SERVO_STARTUP_MILLIS_FOR_MOVE
+#define SERVO_STARTUP_MILLIS_FOR_MOVE 1000 // 起動時に初期位置へ移動する時間(msec)
+#endif
+
+#ifndef SERVO_AXIS_MAX
+#define SERVO_AXIS_MAX              4      // 扱える軸の最大数(X, Yと追加の軸)
+#endif
+#define SERVO_AXIS_XY_NUM           2      // 従来のX, Yの2軸
+
+// 軸の番号。X, Y以降(2〜SERVO_AXIS_MAX-1)は追加の軸(体のロール、耳など)で、(ServoAxis)2のように指定します。
+enum ServoAxis {
+    AXIS_X,
+    AXIS_Y
+};
+
+enum ServoType {
+    PWM,             // SG90 PWM
+    SCS,             // Feetech SCS0009
+    DYN_XL330,        // Dynamixel XL330
+    RT_DYN_XL330,    // Dynamixel XL330 on RT version stackchan
+    SIM              // ホスト上のシミュレータ(実機なし)
+};
+
+typedef struct ServoParam {
+    int pin;                    // サーボのピン番号
+    int16_t start_degree;              // 初期角度
+    int16_t offset;                    // オフセット（90°からの+-）
+    int16_t degree;                    // 角度
+    uint32_t millis_for_move;         // 移動時間(msec)
+    int16_t lower_limit;              // サーボ角度の下限
+    int16_t upper_limit;              // サーボ角度の上限
+    uint8_t id;                       // シリアルサーボのID(0の場合は軸の番号+1)
+    uint8_t servo_type;               // 追加の軸のサーボの種類(ServoType) X, Yはbegin()で指定した種類
+} servo_param_s;
+
+
+typedef struct  StackchanServo{
+    servo_param_s servo[SERVO_AXIS_MAX];
+    uint8_t axis_num;                 // 使用する軸の数(0の場合はX, Yの2軸)
+} stackchan_servo_initial_param_s;
+
+// 1軸分の書き込み(writeAxes)
+typedef struct ServoWrite {
+    uint8_t axis;                      // ServoAxis
+    int16_t degree;                    // 角度(offset込み)
+    uint32_t millis_for_move;          // 移動時間(msec)
+} servo_write_s;
+
+// サーボから読み出した各軸の状態(readFeedback) ドライバが受け持つ軸のみ設定します。
+typedef struct ServoFeedback {
+    float degree[SERVO_AXIS_MAX];      // 現在の角度(offset込み)
+    bool moving[SERVO_AXIS_MAX];       // サーボ側で移動中の場合はtrue
+} servo_feedback_s;
+
+// サーボから読み出した各軸の状態(温度・電流・電圧・ハードウェアエラー)
+typedef struct ServoHealth {
+    uint32_t millis;                   // 読み出した時刻(msec)
+    uint8_t axis_num;                  // 記録した軸の数
+    int16_t current[SERVO_AXIS_MAX];   // 電流(mA)
+    uint16_t voltage[SERVO_AXIS_MAX];  // 入力電圧(0.1V)
+    uint8_t temperature[SERVO_AXIS_MAX];    // 温度(℃)
+    uint8_t hardware_error[SERVO_AXIS_MAX]; // Hardware Error Status(0: エラーなし)
+} servo_health_s;
+
+// 軸のシリアルサーボのIDを返します。
+inline uint8_t servoAxisId(const stackchan_servo_initial_param_s *init_param, uint8_t axis) {
+  return (init_param->servo[axis].id != 0) ? init_param->servo[axis].id : axis + 1;
+}
+
+// サーボドライバの共通インターフェース
+// 角度はすべてoffsetを加えたサーボ上の角度で受け渡します。
+// 1つのドライバが同じ種類(同じバス)の複数の軸を受け持ち、軸の番号(ServoAxis)で指定します。
+class StackchanServoDriver {
+    protected:
+        uint8_t _axis_num;                               // 受け持つ軸の数
+        uint8_t _axes[SERVO_AXIS_MAX];                   // 受け持つ軸(昇順)
+    public:
+        StackchanServoDriver() : _axis_num(0) {}
+        virtual ~StackchanServoDriver() {}
+        virtual ServoType getServoType() = 0;
+        // 受け持つ軸を設定します。(attachの前に呼び出します。)
+        void setAxes(const uint8_t *axes, uint8_t axis_num);
+        uint8_t getAxisNum() { return _axis_num; }
+        uint8_t getAxis(uint8_t index) { return _axes[index]; }
+        // 受け持つ軸の中での順番を返します。受け持たない軸の場合は-1
+        int indexOf(uint8_t axis);
+        bool hasAxis(uint8_t axis) { return indexOf(axis) >= 0; }
+        // 受け持つ軸を初期化して初期位置への移動を開始します。(RT版はここでoffsetを補正します。)
+        // 移動の完了は待たずに戻ります。(SERVO_STARTUP_MILLIS_FOR_MOVEで移動します。)
+        virtual void attach(stackchan_servo_initial_param_s *init_param) = 0;
+        // 指定した軸へ角度を書き込み、待たずに戻ります。複数の軸は1回の送信(シリアルサーボは1パケット)にまとめます。
+        virtual void writeAxes(const servo_write_s *writes, uint8_t write_num) = 0;
+        // X, Yの指定した軸へ角度を書き込みます。(writeAxesを呼び出します。)
+        void writeXY(bool move_x, int x, uint32_t millis_for_move_x,
+                     bool move_y, int y, uint32_t millis_for_move_y);
+        // 指定した軸を移動し、移動が終わるまで待ちます。
+        virtual void moveXY(bool move_x, int x, uint32_t millis_for_move_x,
+                            bool move_y, int y, uint32_t millis_for_move_y);
+        // moveXYで使うカーブ(ServoEase)を設定します。(ドライバ側で補間する場合のみ)
+        virtual void setEase(uint8_t ease) {}
+        // サーボ側でプロファイルを生成する場合に、次のwriteAxes/moveXYで使う加速時間(msec)を設定します。
+        virtual void setAccelerationTime(ServoAxis axis, uint32_t millis_for_accel) {}
+        // サーボ側で移動時間どおりにプロファイルを生成する場合はtrue(目標値を1回送るだけで良い)
+        virtual bool generatesProfile() { return false; }
+        // moveXYでソフトウェアによる分割Easingが必要な場合はtrue
+        virtual bool needsSoftwareEasing() { return false; }
+        // 現在の角度と移動中かどうかを読み出せる場合はtrue(移動の完了をサーボの応答で判定します)
+        virtual bool supportsFeedback() { return false; }
+        // 受け持つ軸の現在の角度と移動中かどうかを1回の通信で読み出します。読み出せなかった場合はfalse
+        virtual bool readFeedback(servo_feedback_s *feedback) { return false; }
+        // 受け持つ軸のトルクをON/OFFします。(OFFにすると手で動かせます。)対応していない場合はfalse
+        virtual bool setTorque(bool enable) { return false; }
+        // 受け持つ軸の現在の角度(offset込み)を読み出します。トルクがOFFでも読み出せます。読み出せなかった場合はfalse
+        virtual bool readPosition(float *degree);
+        // 温度・電流・電圧・ハードウェアエラーを読み出せる場合はtrue
+        virtual bool supportsHealth() { return false; }
+        // 受け持つ軸の温度・電流・電圧・ハードウェアエラーをまとめて読み出します。読み出せなかった場合はfalse
+        virtual bool readHealth(servo_health_s *health) { return false; }
+        virtual float getPresentPosition(uint8_t id);
+        virtual void turn(uint8_t id, uint32_t speed, bool is_cw, uint32_t millis_for_move);
+};
+
+// ServoTypeに対応するドライバを生成します。ビルドから外したドライバの場合はnullptrを返します。
+StackchanServoDriver* createServoDriver(ServoType servo_type);
+
+#endif // _STACKCHAN_SERVO_DRIVER_H_
@@ -0,0 +1,187 @@
+// Copyright (c) Takao Akaki
+#include "Stackchan_servo_dxl.h"
+
+#ifdef STACKCHAN_SERVO_USE_DYN_XL330
+
+static long convertDYNIXELXL330(int16_t degree) {
+  M5_LOGI("Degree: %d\n", degree);
+  
+  long ret =  map(degree, 0, 360, 0, 4095);
+  M5_LOGI("Position: %d\n", ret);
+  return ret;
+}
+
+static long convertDYNIXELXL330_RT(int16_t degree) {
+  M5_LOGI("Degree: %d\n", degree);
+  
+  long ret =  map(degree, -360, 720, -4095, 8191);
+  M5_LOGI("Position: %d\n", ret);
+  return ret;
+}
+
+long StackchanServoDXL::convertPosition(int16_t degree) {
+  return _is_rt ? convertDYNIXELXL330_RT(degree) : convertDYNIXELXL330(degree);
+}
+
+// convertPositionの逆変換(Positionから角度へ)
+float StackchanServoDXL::convertDegree(int32_t position) {
+  if (_is_rt) {
+    return (position + 4095) * 1080.0f / 12286.0f - 360.0f;
+  }
+  return position * 360.0f / 4095.0f;
+}
+
+// 受け持つ軸のサーボがPingに応答するまで待ちます。(固定時間待つ代わりに、応答があればすぐに戻ります。)
+bool StackchanServoDXL::waitReady() {
+  bool ready[SERVO_AXIS_MAX] = { false };
+  uint8_t ready_num = 0;
+  uint32_t start = millis();
+  while (true) {
+    for (int i = 0; i < _axis_num; i++) {
+      if (!ready[i] && _dxl.ping(_ids[i])) {
+        ready[i] = true;
+        ready_num++;
+      }
+    }
+    if (ready_num == _axis_num) break;
+    if (millis() - start >= SERVO_READY_TIMEOUT) {
+      for (int i = 0; i < _axis_num; i++) {
+        if (!ready[i]) M5_LOGE("Dynamixel not responding axis:%d id:%d", _axes[i], _ids[i]);
+      }
+      return false;
+    }
+    delay(SERVO_READY_POLL_INTERVAL);
+  }
+  M5_LOGI("Dynamixel ready: %dms", millis() - start);
+  return true;
+}
+
+void StackchanServoDXL::attach(stackchan_servo_initial_param_s *init_param) {
+  // バスのピンはX軸の設定を使います。
+  Serial2.begin(1000000, SERIAL_8N1, init_param->servo[AXIS_X].pin, init_param->servo[AXIS_Y].pin);
+  _dxl = Dynamixel2Arduino(Serial2);
+  _dxl.begin(1000000);
+  _dxl.setPortProtocolVersion(DXL_PROTOCOL_VERSION);
+  for (int i = 0; i < _axis_num; i++) {
+    _ids[i] = servoAxisId(init_param, _axes[i]);
+  }
+  waitReady();
+  _dxl_sync.begin(&_dxl, _ids, _axis_num);
+  uint8_t operating_mode = _is_rt ? OP_EXTENDED_POSITION : OP_POSITION;
+  M5_LOGI(_is_rt ? "RT_DYN_XL330" : "DYN_XL330");
+  // OperatingMode、DriveModeはEEPROM領域なのでトルクONの前に設定します。
+  for (int i = 0; i < _axis_num; i++) {
+    _dxl.setOperatingMode(_ids[i], operating_mode);
+    _dxl.writeControlTableItem(DRIVE_MODE, _ids[i], 4);  // Velocityのパラメータを移動時間(msec)で指定するモードに変更
+  }
+  // 受け持つ軸のトルクを1回のSync WriteでONにします。(1軸ずつ送る場合のようにWaitを入れる必要はありません。)
+  if (!_dxl_sync.writeTorque(true)) {
+    M5_LOGE("Dynamixel torque on failed");
+  }
+
+  int x = indexOf(AXIS_X);
+  int y = indexOf(AXIS_Y);
+  if (_is_rt && (x >= 0) && (y >= 0)) {
+    // 現在位置(受け持つ軸を1回のSync Readで取得)から何回転目にいるかを判定してoffsetを補正します。
+    int32_t position[SERVO_AXIS_MAX];
+    if (_dxl_sync.readPresentPosition(position) == _axis_num) {
+      M5_LOGI("CurrentPosition X:%d, Y:%d", position[x], position[y]);
+      if (position[x] > 4096) {
+        init_param->servo[AXIS_X].offset = init_param->servo[AXIS_X].offset + 360;
+      }
+      if ((position[y] - convertDYNIXELXL330_RT(init_param->servo[AXIS_Y].lower_limit + init_param->servo[AXIS_Y].offset)) > convertDYNIXELXL330_RT(270)) {
+        init_param->servo[AXIS_Y].offset = init_param->servo[AXIS_Y].offset + 360;
+      }
+    } else {
+      M5_LOGE("Dynamixel SyncRead failed");
+    }
+    M5_LOGI("Current Offset X:%d, Y:%d", init_param->servo[AXIS_X].offset, init_param->servo[AXIS_Y].offset);
+  }
+
+  // 初期位置への移動は待たずに戻ります。(StackchanSERVO側でサーボの応答から到達を確認します。)
+  servo_write_s writes[SERVO_AXIS_MAX];
+  for (int i = 0; i < _axis_num; i++) {
+    uint8_t axis = _axes[i];
+    writes[i] = { axis, (int16_t)(init_param->servo[axis].start_degree + init_param->servo[axis].offset),
+                  SERVO_STARTUP_MILLIS_FOR_MOVE };
+  }
+  writeAxes(writes, _axis_num);
+}
+
+// 加速時間(PROFILE_ACCELERATION)、移動時間(PROFILE_VELOCITY)と目標位置を指定した軸まとめて1回のSync Writeで送信します。
+void StackchanServoDXL::writeAxes(const servo_write_s *writes, uint8_t write_num) {
+  bool enable[SERVO_AXIS_MAX] = { false };
+  uint32_t millis_for_accel[SERVO_AXIS_MAX];
+  uint32_t millis_for_move[SERVO_AXIS_MAX];
+  int32_t goal[SERVO_AXIS_MAX];
+  for (int i = 0; i < write_num; i++) {
+    int index = indexOf(writes[i].axis);
+    if (index < 0) continue;
+    enable[index] = true;
+    millis_for_move[index] = writes[i].millis_for_move;
+    goal[index] = convertPosition(writes[i].degree);
+    // 加速時間は移動時間の半分までです。
+    millis_for_accel[index] = min(_millis_for_accel[writes[i].axis], writes[i].millis_for_move / 2);
+  }
+  if (!_dxl_sync.writeProfileAndGoal(enable, millis_for_accel, millis_for_move, goal)) {
+    M5_LOGE("Dynamixel SyncWrite failed");
+  }
+}
+
+void StackchanServoDXL::moveXY(bool move_x, int x, uint32_t millis_for_move_x,
+                               bool move_y, int y, uint32_t millis_for_move_y) {
+  StackchanServoDriver::moveXY(move_x, x, millis_for_move_x, move_y, y, millis_for_move_y);
+  logPresentPosition();
+}
+
+// 受け持つ軸の現在位置を1回のSync Readで取得してログに出力します。
+void StackchanServoDXL::logPresentPosition() {
+  if (!_is_rt) return;
+  int32_t position[SERVO_AXIS_MAX];
+  if (_dxl_sync.readPresentPosition(position) == _axis_num) {
+    for (int i = 0; i < _axis_num; i++) {
+      M5_LOGI("axis:%d position:%d", _axes[i], position[i]);
+    }
+  }
+}
+
+// 受け持つ軸のMoving、Moving Statusと現在位置を1回のSync Readで取得します。
+bool StackchanServoDXL::readFeedback(servo_feedback_s *feedback) {
+  dxl_present_state_s state[SERVO_AXIS_MAX];
+  if (_dxl_sync.readPresentState(state) != _axis_num) {
+    return false;
+  }
+  for (int i = 0; i < _axis_num; i++) {
+    uint8_t axis = _axes[i];
+    feedback->degree[axis] = convertDegree(state[i].present_position);
+    feedback->moving[axis] = (state[i].moving != 0)
+                          || (state[i].moving_status & DXL_MOVING_STATUS_PROFILE_ONGOING);
+  }
+  return true;
+}
+
+// 受け持つ軸の電流・電圧・温度を1回のSync Readで取得します。(Hardware Errorがある場合のみもう1回読み出します。)
+bool StackchanServoDXL::readHealth(servo_health_s *health) {
+  dxl_present_health_s state[SERVO_AXIS_MAX];
+  uint8_t hardware_error[SERVO_AXIS_MAX];
+  if (_dxl_sync.readPresentHealth(state, hardware_error) != _axis_num) {
+    return false;
+  }
+  for (int i = 0; i < _axis_num; i++) {
+    uint8_t axis = _axes[i];
+    health->current[axis] = state[i].present_current;
+    health->voltage[axis] = state[i].present_input_voltage;
+    health->temperature[axis] = state[i].present_temperature;
+    health->hardware_error[axis] = hardware_error[i];
+  }
+  return true;
+}
+
+float StackchanServoDXL::getPresentPosition(uint8_t id) {
+  if (!_is_rt) {
+    return StackchanServoDriver::getPresentPosition(id);
+  }
+  return _dxl.getPresentPosition(id);
+}
+
+#endif // STACKCHAN_SERVO_USE_DYN_XL330
@@ -0,0 +1,47 @@
+// Copyright (c) 2022 Takao Akaki
+
+#ifndef _STACKCHAN_SERVO_DXL_H_
+#define _STACKCHAN_SERVO_DXL_H_
+
+#include "Stackchan_servo_driver.h"
+
+#ifdef STACKCHAN_SERVO_USE_DYN_XL330
+
+#include <Dynamixel2Arduino.h>
+#include "Stackchan_dxl_sync.h"
+
+using namespace ControlTableItem;
+
+const float DXL_PROTOCOL_VERSION = 2.0f;
+
+// Dynamixel XL330用ドライバ(DYN_XL330, RT_DYN_XL330)
+class StackchanServoDXL : public StackchanServoDriver {
+    protected:
+        bool _is_rt;                                     // RT版の場合はtrue(Extended Position Mode)
+        Dynamixel2Arduino _dxl;
+        StackchanDxlSync _dxl_sync;                      // Sync Write/Sync Read
+        uint8_t _ids[SERVO_AXIS_MAX];                    // 受け持つ軸(_axesと同じ順)のID
+        uint32_t _millis_for_accel[SERVO_AXIS_MAX];      // 軸ごとの加速時間(msec)
+        long convertPosition(int16_t degree);
+        float convertDegree(int32_t position);
+        void logPresentPosition();
+        bool waitReady();
+    public:
+        StackchanServoDXL(bool is_rt) : _is_rt(is_rt), _ids{ 0 }, _millis_for_accel{ 0 } {}
+        ServoType getServoType() override { return _is_rt ? ServoType::RT_DYN_XL330 : ServoType::DYN_XL330; }
+        void attach(stackchan_servo_initial_param_s *init_param) override;
+        void writeAxes(const servo_write_s *writes, uint8_t write_num) override;
+        void moveXY(bool move_x, int x, uint32_t millis_for_move_x,
+                    bool move_y, int y, uint32_t millis_for_move_y) override;
+        void setAccelerationTime(ServoAxis axis, uint32_t millis_for_accel) override { _millis_for_accel[axis] = millis_for_accel; }
+        bool generatesProfile() override { return true; }
+        bool supportsFeedback() override { return true; }
+        bool readFeedback(servo_feedback_s *feedback) override;
+        bool setTorque(bool enable) override { return _dxl_sync.writeTorque(enable); }
+        bool supportsHealth() override { return true; }
+        bool readHealth(servo_health_s *health) override;
+        float getPresentPosition(uint8_t id) override;
+};
+
+#endif // STACKCHAN_SERVO_USE_DYN_XL330
+#endif // _STACKCHAN_SERVO_DXL_H_
@@ -0,0 +1,38 @@
+// Copyright (c) Takao Akaki
+#include "Stackchan_servo_health.h"
+
+void StackchanServoHealthLog::push(const servo_health_s *health) {
+  _log[_count % SERVO_HEALTH_LOG_SIZE] = *health;
+  _count++;
+}
+
+const servo_health_s* StackchanServoHealthLog::get(uint32_t index) {
+  uint32_t num = size();
+  if (index >= num) return nullptr;
+  uint32_t first = _count - num;
+  return &_log[(first + index) % SERVO_HEALTH_LOG_SIZE];
+}
+
+void StackchanServoHealthLog::dump() {
+  uint32_t num = size();
+  for (uint32_t i = 0; i < num; i++) {
+    const servo_health_s *h = get(i);
+    Serial.printf("%u", (unsigned)h->millis);
+    // X, Yは名前、追加の軸は軸の番号で出力します。
+    for (int axis = 0; axis < h->axis_num; axis++) {
+      if (axis < SERVO_AXIS_XY_NUM) {
+        Serial.printf(" %c:", (axis == AXIS_X) ? 'X' : 'Y');
+      } else {
+        Serial.printf(" %d:", axis);
+      }
+      Serial.printf("%uC %u.%uV %dmA E%02X", h->temperature[axis], h->voltage[axis] / 10, h->voltage[axis] % 10,
+                    h->current[axis], h->hardware_error[axis]);
+    }
+    Serial.printf("\n");
+  }
+}
+
+// 温度が警告値以上、またはハードウェアエラーがある場合はtrue
+bool StackchanServoHealthLog::isWarning(const servo_health_s *health, ServoAxis axis) {
+  return (health->temperature[axis] >= SERVO_HEALTH_TEMPERATURE_WARNING) || (health->hardware_error[axis] != 0);
+}
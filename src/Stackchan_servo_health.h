@@ -0,0 +1,39 @@
+// Copyright (c) 2022 Takao Akaki
+
+#ifndef _STACKCHAN_SERVO_HEALTH_H_
+#define _STACKCHAN_SERVO_HEALTH_H_
+
+#include "Stackchan_servo_driver.h"
+
+#ifndef SERVO_HEALTH_LOG_SIZE
+#define SERVO_HEALTH_LOG_SIZE           32     // 記録する回数(超えた場合は古いものから上書き)
+#endif
+#ifndef SERVO_HEALTH_POLL_INTERVAL
+#define SERVO_HEALTH_POLL_INTERVAL      1000   // 温度・電流・電圧を読み出す間隔(msec) 0の場合は読み出さない
+#endif
+#ifndef SERVO_HEALTH_TEMPERATURE_WARNING
+#define SERVO_HEALTH_TEMPERATURE_WARNING 60    // この温度(℃)以上で警告(XL330のTemperature Limitの初期値は70℃)
+#endif
+
+// サーボの温度・電流・電圧・ハードウェアエラーを一定回数分記録するリングバッファ
+// 書き込みはサーボを制御するタスク(tick()を呼び出すタスク)からのみ行います。
+class StackchanServoHealthLog {
+    protected:
+        servo_health_s _log[SERVO_HEALTH_LOG_SIZE];
+        uint32_t _count;                                 // 記録した総数(上書きしたものも含む)
+    public:
+        StackchanServoHealthLog() : _count(0) {}
+        void push(const servo_health_s *health);
+        void clear() { _count = 0; }
+        uint32_t getCount() { return _count; }
+        uint32_t size() { return (_count < SERVO_HEALTH_LOG_SIZE) ? _count : SERVO_HEALTH_LOG_SIZE; }
+        // index番目(0が最も古い)に記録されている値を返します。
+        const servo_health_s* get(uint32_t index);
+        // 最新の値を返します。まだ読み出していない場合はnullptr
+        const servo_health_s* latest() { return (_count == 0) ? nullptr : get(size() - 1); }
+        // 記録をシリアルへ1回1行で出力します。(例: "12000 X:45C 5.0V 120mA E00 Y:52C 5.0V 310mA E00")
+        void dump();
+        static bool isWarning(const servo_health_s *health, ServoAxis axis);
+};
+
+#endif // _STACKCHAN_SERVO_HEALTH_H_
@@ -0,0 +1,64 @@
+// Copyright (c) Takao Akaki
+#include "Stackchan_servo_pwm.h"
+#include "Stackchan_easing.h"
+
+#ifdef STACKCHAN_SERVO_USE_PWM
+#include <ServoEasing.hpp>
+
+void StackchanServoPWM::attach(stackchan_servo_initial_param_s *init_param) {
+  // SG90 PWM
+  for (int i = 0; i < _axis_num; i++) {
+    uint8_t axis = _axes[i];
+    if (_servo[axis].attach(init_param->servo[axis].pin,
+                            init_param->servo[axis].start_degree + init_param->servo[axis].offset,
+                            DEFAULT_MICROSECONDS_FOR_0_DEGREE,
+                            DEFAULT_MICROSECONDS_FOR_180_DEGREE)) {
+      Serial.printf("Error attaching servo axis:%d", axis);
+    }
+    _servo[axis].setEasingType(EASE_QUADRATIC_IN_OUT);
+  }
+}
+
+// ServoEaseを同じ形のServoEasingのカーブに合わせます。
+void StackchanServoPWM::setEase(uint8_t ease) {
+  uint8_t easing_type;
+  switch (ease) {
+    case SERVO_EASE_LINEAR:  easing_type = EASE_LINEAR;           break;
+    case SERVO_EASE_CUBIC:   easing_type = EASE_CUBIC_IN_OUT;     break;
+    case SERVO_EASE_SINE:    easing_type = EASE_SINE_IN_OUT;      break;
+    case SERVO_EASE_BACK:    easing_type = EASE_BACK_IN_OUT;      break;
+    case SERVO_EASE_ELASTIC: easing_type = EASE_ELASTIC_IN_OUT;   break;
+    default:                 easing_type = EASE_QUADRATIC_IN_OUT; break;
+  }
+  for (int i = 0; i < _axis_num; i++) {
+    _servo[_axes[i]].setEasingType(easing_type);
+  }
+}
+
+void StackchanServoPWM::writeAxes(const servo_write_s *writes, uint8_t write_num) {
+  // PWMは移動時間を指定できないので即座に書き込みます。
+  for (int i = 0; i < write_num; i++) {
+    _servo[writes[i].axis].write(writes[i].degree);
+  }
+}
+
+void StackchanServoPWM::moveXY(bool move_x, int x, uint32_t millis_for_move_x,
+                               bool move_y, int y, uint32_t millis_for_move_y) {
+  if (move_x) {
+    if (millis_for_move_x == 0) {
+      _servo[AXIS_X].setEaseTo(x);
+    } else {
+      _servo[AXIS_X].setEaseToD(x, millis_for_move_x);
+    }
+  }
+  if (move_y) {
+    if (millis_for_move_y == 0) {
+      _servo[AXIS_Y].setEaseTo(y);
+    } else {
+      _servo[AXIS_Y].setEaseToD(y, millis_for_move_y);
+    }
+  }
+  synchronizeAllServosStartAndWaitForAllServosToStop();
+}
+
+#endif // STACKCHAN_SERVO_USE_PWM
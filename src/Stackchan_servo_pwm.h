@@ -0,0 +1,30 @@
+// Copyright (c) 2022 Takao Akaki
+
+#ifndef _STACKCHAN_SERVO_PWM_H_
+#define _STACKCHAN_SERVO_PWM_H_
+
+#include "Stackchan_servo_driver.h"
+
+#ifdef STACKCHAN_SERVO_USE_PWM
+
+// コンパイル時にServoEasing.hppをIncludeしてくださいという警告が出ますが、hppにすると二重定義のリンクエラーが出ます。
+// その対処でStackchan_servo_pwm.hはh, Stackchan_servo_pwm.cppはhppをincludeしています。
+#define SUPPRESS_HPP_WARNING
+#include <ESP32Servo.h>
+#include <ServoEasing.h>
+
+// SG90等のPWMサーボ用ドライバ(ServoEasing)
+class StackchanServoPWM : public StackchanServoDriver {
+    protected:
+        ServoEasing _servo[SERVO_AXIS_MAX];              // 軸ごと(受け持つ軸のみattach)
+    public:
+        ServoType getServoType() override { return ServoType::PWM; }
+        void attach(stackchan_servo_initial_param_s *init_param) override;
+        void writeAxes(const servo_write_s *writes, uint8_t write_num) override;
+        void moveXY(bool move_x, int x, uint32_t millis_for_move_x,
+                    bool move_y, int y, uint32_t millis_for_move_y) override;
+        void setEase(uint8_t ease) override;
+};
+
+#endif // STACKCHAN_SERVO_USE_PWM
+#endif // _STACKCHAN_SERVO_PWM_H_
@@ -0,0 +1,119 @@
+// Copyright (c) Takao Akaki
+#include "Stackchan_servo_scs.h"
+
+#ifdef STACKCHAN_SERVO_USE_SCS
+
+static long convertSCS0009Pos(int16_t degree) {
+  //Serial.printf("Degree: %d\n", degree);
+  return map(degree, 0, 300, 1023, 0);
+}
+
+// 受け持つ軸のサーボがPingに応答するまで待ちます。(固定時間待つ代わりに、応答があればすぐに戻ります。)
+bool StackchanServoSCS::waitReady() {
+  bool ready[SERVO_AXIS_MAX] = { false };
+  uint8_t ready_num = 0;
+  uint32_t start = millis();
+  while (true) {
+    for (int i = 0; i < _axis_num; i++) {
+      if (!ready[i] && (_sc.Ping(_ids[i]) != -1)) {
+        ready[i] = true;
+        ready_num++;
+      }
+    }
+    if (ready_num == _axis_num) break;
+    if (millis() - start >= SERVO_READY_TIMEOUT) {
+      for (int i = 0; i < _axis_num; i++) {
+        if (!ready[i]) M5_LOGE("SCS servo not responding axis:%d id:%d", _axes[i], _ids[i]);
+      }
+      return false;
+    }
+    delay(SERVO_READY_POLL_INTERVAL);
+  }
+  M5_LOGI("SCS servo ready: %dms", millis() - start);
+  return true;
+}
+
+void StackchanServoSCS::attach(stackchan_servo_initial_param_s *init_param) {
+  // SCS0009 (バスのピンはX軸の設定を使います。)
+  Serial2.begin(1000000, SERIAL_8N1, init_param->servo[AXIS_X].pin, init_param->servo[AXIS_Y].pin);
+  _sc.pSerial = &Serial2;
+  for (int i = 0; i < _axis_num; i++) {
+    _ids[i] = servoAxisId(init_param, _axes[i]);
+  }
+  waitReady();
+  // 受け持つ軸のトルクを1回のSyncWriteでONにします。
+  setTorque(true);
+  // 初期位置への移動は待たずに戻ります。(StackchanSERVO側で完了を管理します。)
+  servo_write_s writes[SERVO_AXIS_MAX];
+  for (int i = 0; i < _axis_num; i++) {
+    uint8_t axis = _axes[i];
+    writes[i] = { axis, (int16_t)(init_param->servo[axis].start_degree + init_param->servo[axis].offset),
+                  SERVO_STARTUP_MILLIS_FOR_MOVE };
+  }
+  writeAxes(writes, _axis_num);
+}
+
+// SyncWriteはIDごとにデータを読むので、受け持つ軸の数だけ値を並べて送ります。
+// SyncWriteには応答がないので、読み返して全部の軸が切り替わったか確認します。
+bool StackchanServoSCS::setTorque(bool enable) {
+  uint8_t torque_enable[SERVO_AXIS_MAX];
+  for (int i = 0; i < _axis_num; i++) {
+    torque_enable[i] = enable ? 1 : 0;
+  }
+  _sc.syncWrite(_ids, _axis_num, SCSCL_TORQUE_ENABLE, torque_enable, 1);
+  bool result = true;
+  for (int i = 0; i < _axis_num; i++) {
+    int value = _sc.readByte(_ids[i], SCSCL_TORQUE_ENABLE);
+    if (value != torque_enable[i]) {
+      M5_LOGE("SCS torque %s failed axis:%d id:%d", enable ? "on" : "off", _axes[i], _ids[i]);
+      result = false;
+    }
+  }
+  return result;
+}
+
+// convertSCS0009Posの逆変換で受け持つ軸の現在の角度を求めます。
+bool StackchanServoSCS::readPosition(float *degree) {
+  for (int i = 0; i < _axis_num; i++) {
+    int position = _sc.ReadPos(_ids[i]);
+    if (position < 0) return false;
+    degree[_axes[i]] = (1023 - position) * 300.0f / 1023.0f;
+  }
+  return true;
+}
+
+// 目標位置と移動時間を指定した軸まとめて1回のSyncWritePosで送信します。
+void StackchanServoSCS::writeAxes(const servo_write_s *writes, uint8_t write_num) {
+  uint8_t id[SERVO_AXIS_MAX];
+  uint16_t position[SERVO_AXIS_MAX];
+  uint16_t time[SERVO_AXIS_MAX];
+  uint16_t speed[SERVO_AXIS_MAX] = { 0 };
+  uint8_t id_num = 0;
+  for (int i = 0; i < write_num; i++) {
+    int index = indexOf(writes[i].axis);
+    if (index < 0) continue;
+    id[id_num] = _ids[index];
+    position[id_num] = convertSCS0009Pos(writes[i].degree);
+    time[id_num] = writes[i].millis_for_move;
+    id_num++;
+  }
+  if (id_num == 0) return;
+  _sc.SyncWritePos(id, id_num, position, time, speed);
+}
+
+// @uint32_t speed 0〜1000
+void StackchanServoSCS::turn(uint8_t id, uint32_t speed, bool is_cw, uint32_t millis_for_move) {
+    if (speed >= 1000) {
+      speed = 1000;
+    }
+    if (is_cw) {
+      speed += 1000; // 逆回転時は+1000
+    }
+    Serial.printf("speed: %d\n", speed);
+    _sc.PWMMode(id, true); // 回転モード
+    _sc.WritePWM(id, speed);
+    vTaskDelay(millis_for_move/portTICK_PERIOD_MS);
+    _sc.PWMMode(id, false); // 位置決めモードへ戻す 
+}
+
+#endif // STACKCHAN_SERVO_USE_SCS
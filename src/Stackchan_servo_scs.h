@@ -0,0 +1,29 @@
+// Copyright (c) 2022 Takao Akaki
+
+#ifndef _STACKCHAN_SERVO_SCS_H_
+#define _STACKCHAN_SERVO_SCS_H_
+
+#include "Stackchan_servo_driver.h"
+
+#ifdef STACKCHAN_SERVO_USE_SCS
+
+#include <SCServo.h>
+
+// Feetech SCS0009用ドライバ
+class StackchanServoSCS : public StackchanServoDriver {
+    protected:
+        SCSCL _sc;
+        uint8_t _ids[SERVO_AXIS_MAX];                    // 受け持つ軸(_axesと同じ順)のID
+        bool waitReady();
+    public:
+        ServoType getServoType() override { return ServoType::SCS; }
+        void attach(stackchan_servo_initial_param_s *init_param) override;
+        void writeAxes(const servo_write_s *writes, uint8_t write_num) override;
+        bool needsSoftwareEasing() override { return true; }
+        bool setTorque(bool enable) override;
+        bool readPosition(float *degree) override;
+        void turn(uint8_t id, uint32_t speed, bool is_cw, uint32_t millis_for_move) override;
+};
+
+#endif // STACKCHAN_SERVO_USE_SCS
+#endif // _STACKCHAN_SERVO_SCS_H_
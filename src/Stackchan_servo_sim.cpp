@@ -0,0 +1,144 @@
+// Copyright (c) Takao Akaki
+#include "Stackchan_servo_sim.h"
+
+#ifdef STACKCHAN_SERVO_USE_SIM
+
+StackchanServoSIM::StackchanServoSIM(ServoType emulate) : _emulate(emulate), _torque(true), _log_count(0) {
+  memset(_axis, 0, sizeof(_axis));
+  memset(_stall, 0, sizeof(_stall));
+  memset(_temperature, SERVO_SIM_TEMPERATURE, sizeof(_temperature));
+  memset(_hardware_error, 0, sizeof(_hardware_error));
+  for (int axis = 0; axis < SERVO_AXIS_MAX; axis++) {
+    setMechanicalStop((ServoAxis)axis, -SERVO_SIM_NO_STOP, SERVO_SIM_NO_STOP);
+  }
+}
+
+void StackchanServoSIM::attach(stackchan_servo_initial_param_s *init_param) {
+  for (int i = 0; i < _axis_num; i++) {
+    uint8_t axis = _axes[i];
+    float degree = init_param->servo[axis].start_degree + init_param->servo[axis].offset;
+    _axis[axis].from_degree = degree;
+    _axis[axis].to_degree = degree;
+    _axis[axis].start_micros = micros();
+    _axis[axis].micros_for_move = 0;
+  }
+  M5_LOGI("SIM: emulate ServoType:%d", _emulate);
+}
+
+bool StackchanServoSIM::generatesProfile() {
+  return (_emulate == ServoType::DYN_XL330) || (_emulate == ServoType::RT_DYN_XL330);
+}
+
+void StackchanServoSIM::startAxis(ServoAxis axis, int degree, uint32_t millis_for_move, uint32_t now) {
+  sim_axis_s *a = &_axis[axis];
+  a->from_degree = getDegree(axis, now);
+  a->to_degree = (_stall[axis] || !_torque) ? a->from_degree : degree;
+  a->start_micros = now;
+  if (_emulate == ServoType::PWM) {
+    // PWMサーボは移動時間に関係なく最高速度で目標へ向かいます。
+    a->micros_for_move = fabsf(a->to_degree - a->from_degree) * 1000000.0f / SERVO_SIM_PWM_SPEED;
+  } else {
+    a->micros_for_move = millis_for_move * 1000;
+  }
+}
+
+void StackchanServoSIM::writeAxes(const servo_write_s *writes, uint8_t write_num) {
+  if (write_num == 0) return;
+  uint32_t now = micros();
+  servo_sim_command_s *cmd = &_log[_log_count % SERVO_SIM_LOG_SIZE];
+  cmd->micros = now;
+  cmd->write_num = (write_num > SERVO_AXIS_MAX) ? SERVO_AXIS_MAX : write_num;
+  memcpy(cmd->writes, writes, sizeof(servo_write_s) * cmd->write_num);
+  _log_count++;
+  for (int i = 0; i < cmd->write_num; i++) {
+    startAxis((ServoAxis)writes[i].axis, writes[i].degree, writes[i].millis_for_move, now);
+  }
+#ifndef ARDUINO
+  if (_emulate != ServoType::PWM) {
+    // シリアルサーボのパケット送信時間(ヘッダ8byte + 1軸6byte, 1byte = 10bit)だけ仮想時計を進めます。
+    uint32_t bytes = 8 + 6 * cmd->write_num;
+    stackchanHostAdvanceMicros(bytes * 10 * 1000000 / SERVO_SIM_BAUDRATE);
+  }
+#endif
+}
+
+float StackchanServoSIM::getDegree(ServoAxis axis, uint32_t now_micros) {
+  sim_axis_s *a = &_axis[axis];
+  uint32_t elapsed = now_micros - a->start_micros;
+  float degree = a->to_degree;
+  if ((a->micros_for_move != 0) && (elapsed < a->micros_for_move)) {
+    degree = a->from_degree + (a->to_degree - a->from_degree) * elapsed / a->micros_for_move;
+  }
+  return fmaxf(_stop_lower[axis], fminf(degree, _stop_upper[axis]));
+}
+
+// 目標が機構の端より先で、端で止まっている場合はtrue
+bool StackchanServoSIM::isPushingStop(ServoAxis axis, uint32_t now) {
+  float degree = getDegree(axis, now);
+  return ((_axis[axis].to_degree < _stop_lower[axis]) && (degree <= _stop_lower[axis]))
+      || ((_axis[axis].to_degree > _stop_upper[axis]) && (degree >= _stop_upper[axis]));
+}
+
+bool StackchanServoSIM::readFeedback(servo_feedback_s *feedback) {
+  if (!supportsFeedback()) return false;
+  uint32_t now = micros();
+  for (int i = 0; i < _axis_num; i++) {
+    uint8_t axis = _axes[i];
+    feedback->degree[axis] = getDegree((ServoAxis)axis, now);
+    feedback->moving[axis] = (now - _axis[axis].start_micros) < _axis[axis].micros_for_move;
+  }
+#ifndef ARDUINO
+  // Sync Readの送信(12byte + 軸数)と軸ごとの応答(25byte)の時間だけ仮想時計を進めます。
+  stackchanHostAdvanceMicros((12 + 26 * _axis_num) * 10 * 1000000 / SERVO_SIM_BAUDRATE);
+#endif
+  return true;
+}
+
+// 電流は移動中(止まっている軸や機構の端を押している軸を含む)に大きくなります。
+bool StackchanServoSIM::readHealth(servo_health_s *health) {
+  if (!supportsHealth()) return false;
+  uint32_t now = micros();
+  for (int i = 0; i < _axis_num; i++) {
+    uint8_t axis = _axes[i];
+    bool moving = (now - _axis[axis].start_micros) < _axis[axis].micros_for_move;
+    health->current[axis] = (_stall[axis] || isPushingStop((ServoAxis)axis, now)) ? 600 : (moving ? 150 : 20);
+    health->voltage[axis] = 50;
+    health->temperature[axis] = _temperature[axis];
+    health->hardware_error[axis] = _hardware_error[axis];
+  }
+#ifndef ARDUINO
+  // Sync Readの送信(12byte + 軸数)と軸ごとの応答(32byte)の時間だけ仮想時計を進めます。
+  stackchanHostAdvanceMicros((12 + 33 * _axis_num) * 10 * 1000000 / SERVO_SIM_BAUDRATE);
+#endif
+  return true;
+}
+
+bool StackchanServoSIM::readPosition(float *degree) {
+  if (_emulate == ServoType::PWM) return false;
+  uint32_t now = micros();
+  for (int i = 0; i < _axis_num; i++) {
+    degree[_axes[i]] = getDegree((ServoAxis)_axes[i], now);
+  }
+  return true;
+}
+
+void StackchanServoSIM::setHandDegree(ServoAxis axis, float degree) {
+  if (_torque) return;
+  _axis[axis].from_degree = degree;
+  _axis[axis].to_degree = degree;
+  _axis[axis].micros_for_move = 0;
+}
+
+float StackchanServoSIM::getPresentPosition(uint8_t id) {
+  if ((id < 1) || (id > SERVO_AXIS_MAX)) return 0.0f;
+  return getDegree((ServoAxis)(id - 1), micros());
+}
+
+const servo_sim_command_s* StackchanServoSIM::getCommand(uint32_t index) {
+  uint32_t num = getLoggedCommandNum();
+  if (index >= num) return nullptr;
+  uint32_t first = _log_count - num;
+  return &_log[(first + index) % SERVO_SIM_LOG_SIZE];
+}
+
+#endif // STACKCHAN_SERVO_USE_SIM
@@ -0,0 +1,83 @@
+// Copyright (c) 2022 Takao Akaki
+
+#ifndef _STACKCHAN_SERVO_SIM_H_
+#define _STACKCHAN_SERVO_SIM_H_
+
+#include "Stackchan_servo_driver.h"
+
+#ifdef STACKCHAN_SERVO_USE_SIM
+
+#ifndef SERVO_SIM_LOG_SIZE
+#define SERVO_SIM_LOG_SIZE      512     // 記録するコマンド数(超えた場合は古いものから上書き)
+#endif
+#define SERVO_SIM_PWM_SPEED     600     // PWMサーボ(SG90)の移動速度(deg/sec)
+#define SERVO_SIM_BAUDRATE      1000000 // シリアルサーボのボーレート(バス占有時間の計算用)
+#define SERVO_SIM_TEMPERATURE   35      // 温度の初期値(℃)
+#define SERVO_SIM_NO_STOP       10000.0f // 機構の端を設定しない場合の角度
+
+// シミュレータが受け取った1回分の書き込み(バスのパケットまたはPWMの書き込み)
+typedef struct ServoSimCommand {
+    uint32_t micros;                   // 書き込んだ時刻(usec)
+    uint8_t write_num;
+    servo_write_s writes[SERVO_AXIS_MAX];   // 角度はoffset込み
+} servo_sim_command_s;
+
+// 実機なしで動作する仮想サーボ
+// emulate()で指定したサーボの振る舞い(SCSの分割Easing、Dynamixelのプロファイル、PWMの即時移動)を模擬し、
+// 指定した移動時間どおりに位置を補間します。書き込みはすべて時刻付きで記録します。
+class StackchanServoSIM : public StackchanServoDriver {
+    protected:
+        typedef struct SimAxis {
+            float from_degree;
+            float to_degree;
+            uint32_t start_micros;
+            uint32_t micros_for_move;
+        } sim_axis_s;
+        ServoType _emulate;
+        sim_axis_s _axis[SERVO_AXIS_MAX];
+        bool _stall[SERVO_AXIS_MAX];                                  // trueの軸は書き込んでも動かない
+        uint8_t _temperature[SERVO_AXIS_MAX];                         // readHealthで返す温度(℃)
+        uint8_t _hardware_error[SERVO_AXIS_MAX];                      // readHealthで返すハードウェアエラー
+        float _stop_lower[SERVO_AXIS_MAX];                            // 機構の端(offset込みの角度)
+        float _stop_upper[SERVO_AXIS_MAX];
+        bool isPushingStop(ServoAxis axis, uint32_t now);
+        bool _torque;                                    // falseの場合は書き込んでも動かない(手で動かせる)
+        servo_sim_command_s _log[SERVO_SIM_LOG_SIZE];
+        uint32_t _log_count;                             // 記録した総数(上書きしたものも含む)
+        void startAxis(ServoAxis axis, int degree, uint32_t millis_for_move, uint32_t now);
+    public:
+        StackchanServoSIM(ServoType emulate = ServoType::SCS);
+        ServoType getServoType() override { return ServoType::SIM; }
+        void attach(stackchan_servo_initial_param_s *init_param) override;
+        void writeAxes(const servo_write_s *writes, uint8_t write_num) override;
+        bool generatesProfile() override;
+        bool needsSoftwareEasing() override { return _emulate == ServoType::SCS; }
+        bool supportsFeedback() override { return generatesProfile(); }
+        bool readFeedback(servo_feedback_s *feedback) override;
+        bool setTorque(bool enable) override { _torque = enable; return true; }
+        bool readPosition(float *degree) override;
+        bool supportsHealth() override { return generatesProfile(); }
+        bool readHealth(servo_health_s *health) override;
+        float getPresentPosition(uint8_t id) override;
+
+        void emulate(ServoType servo_type) { _emulate = servo_type; }
+        // 軸が引っかかって動かない状態を模擬します。
+        void setStall(ServoAxis axis, bool stall) { _stall[axis] = stall; }
+        // 過熱やハードウェアエラーを模擬します。
+        void setTemperature(ServoAxis axis, uint8_t temperature) { _temperature[axis] = temperature; }
+        void setHardwareError(ServoAxis axis, uint8_t hardware_error) { _hardware_error[axis] = hardware_error; }
+        // 機構の端(offset込みの角度)を模擬します。端より先へは動かず、端を押している間は電流が大きくなります。
+        void setMechanicalStop(ServoAxis axis, float lower, float upper) { _stop_lower[axis] = lower; _stop_upper[axis] = upper; }
+        // トルクOFFの状態で手で動かした位置を模擬します。
+        void setHandDegree(ServoAxis axis, float degree);
+        bool getTorque() { return _torque; }
+        float getDegree(ServoAxis axis, uint32_t now_micros);
+        uint32_t getCommandCount() { return _log_count; }
+        // index番目(0が最も古い)に記録されているコマンドを返します。
+        const servo_sim_command_s* getCommand(uint32_t index);
+        uint32_t getLoggedCommandNum() { return (_log_count < SERVO_SIM_LOG_SIZE) ? _log_count : SERVO_SIM_LOG_SIZE; }
+        void clearLog() { _log_count = 0; }
+};
+
+#endif // STACKCHAN_SERVO_USE_SIM
+#endif // _STACKCHAN_SERVO_SIM_H_
@@ -0,0 +1,112 @@
+// Copyright (c) Takao Akaki
+#include "Stackchan_servo_task.h"
+
+StackchanServoTask::StackchanServoTask() : _servo(nullptr), _idle_motion(nullptr), _interval(SERVO_TASK_INTERVAL), _dropped_count(0), _busy(false) {
+#ifdef ARDUINO
+  _task_handle = nullptr;
+#endif
+}
+
+#ifdef ARDUINO
+void StackchanServoTask::taskLoop(void *arg) {
+  StackchanServoTask *servo_task = (StackchanServoTask*)arg;
+  TickType_t last_wake_time = xTaskGetTickCount();
+  for (;;) {
+    servo_task->process(millis());
+    vTaskDelayUntil(&last_wake_time, servo_task->_interval/portTICK_PERIOD_MS);
+  }
+}
+#endif
+
+bool StackchanServoTask::begin(StackchanSERVO *servo, int core, uint32_t interval, uint32_t priority) {
+  _servo = servo;
+  _interval = (interval == 0) ? 1 : interval;
+#ifdef ARDUINO
+  if (_task_handle != nullptr) return true;
+  if (xTaskCreatePinnedToCore(taskLoop, "StackchanServo", SERVO_TASK_STACK_SIZE, this, priority,
+                              &_task_handle, core) != pdPASS) {
+    M5_LOGE("Failed to create servo task");
+    _task_handle = nullptr;
+    return false;
+  }
+  M5_LOGI("Servo task started: core:%d, interval:%dmsec", core, _interval);
+#endif
+  return true;
+}
+
+bool StackchanServoTask::push(const servo_command_s &command) {
+  if (!_commands.push(command)) {
+    _dropped_count++;
+    M5_LOGE("Servo command ring is full");
+    return false;
+  }
+  return true;
+}
+
+bool StackchanServoTask::moveX(int x, uint32_t millis_for_move) {
+  servo_command_s command = { SERVO_COMMAND_MOVE_X, (int16_t)x, 0, millis_for_move, "" };
+  return push(command);
+}
+
+bool StackchanServoTask::moveY(int y, uint32_t millis_for_move) {
+  servo_command_s command = { SERVO_COMMAND_MOVE_Y, 0, (int16_t)y, millis_for_move, "" };
+  return push(command);
+}
+
+bool StackchanServoTask::moveXY(int x, int y, uint32_t millis_for_move) {
+  servo_command_s command = { SERVO_COMMAND_MOVE_XY, (int16_t)x, (int16_t)y, millis_for_move, "" };
+  return push(command);
+}
+
+// モーション番号はxに入れて送ります。
+bool StackchanServoTask::motion(Motion motion_no) {
+  servo_command_s command = { SERVO_COMMAND_MOTION, (int16_t)motion_no, 0, 0, "" };
+  return push(command);
+}
+
+bool StackchanServoTask::motion(const char *motion_name) {
+  servo_command_s command = { SERVO_COMMAND_MOTION, 0, 0, 0, "" };
+  strncpy(command.motion_name, motion_name, MOTION_NAME_LENGTH - 1);
+  return push(command);
+}
+
+bool StackchanServoTask::stop() {
+  servo_command_s command = { SERVO_COMMAND_STOP, 0, 0, 0, "" };
+  return push(command);
+}
+
+void StackchanServoTask::process(uint32_t now) {
+  if (_servo == nullptr) return;
+  servo_command_s command;
+  if (!_commands.empty()) {
+    _busy.store(true);  // 取り出した後もisMoving()がfalseにならないよう先に設定します。
+  }
+  while (_commands.pop(&command)) {
+    switch (command.type) {
+      case SERVO_COMMAND_MOVE_X:
+        _servo->moveXAsync(command.x, command.millis_for_move);
+        break;
+      case SERVO_COMMAND_MOVE_Y:
+        _servo->moveYAsync(command.y, command.millis_for_move);
+        break;
+      case SERVO_COMMAND_MOVE_XY:
+        _servo->moveXYAsync(command.x, command.y, command.millis_for_move);
+        break;
+      case SERVO_COMMAND_MOTION:
+        if (command.motion_name[0] != '\0') {
+          _servo->startMotion(command.motion_name);
+        } else {
+          _servo->startMotion((Motion)command.x);
+        }
+        break;
+      case SERVO_COMMAND_STOP:
+        _servo->stop();
+        break;
+    }
+  }
+  if (_idle_motion != nullptr) {
+    _idle_motion->tick(now);
+  }
+  _servo->tick(now);
+  _busy.store(_servo->isMoving());
+}
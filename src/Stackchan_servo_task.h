@@ -0,0 +1,107 @@
+// Copyright (c) 2022 Takao Akaki
+
+#ifndef _STACKCHAN_SERVO_TASK_H_
+#define _STACKCHAN_SERVO_TASK_H_
+
+#include <atomic>
+#include "Stackchan_servo.h"
+#include "Stackchan_idle_motion.h"
+
+#ifndef SERVO_TASK_INTERVAL
+#define SERVO_TASK_INTERVAL         10     // サーボタスクの制御周期(msec) 10msec = 100Hz
+#endif
+#ifndef SERVO_TASK_CORE
+#define SERVO_TASK_CORE             0      // サーボタスクを動かすコア(loop()はCore1)
+#endif
+#ifndef SERVO_TASK_PRIORITY
+#define SERVO_TASK_PRIORITY         3
+#endif
+#ifndef SERVO_TASK_STACK_SIZE
+#define SERVO_TASK_STACK_SIZE       4096
+#endif
+#define SERVO_COMMAND_RING_SIZE     16     // コマンドのリングバッファの大きさ(2のべき乗)
+
+// 1つのタスクが書き込み、別の1つのタスクが読み出すロックフリーのリングバッファ(SPSC)
+// SIZEは2のべき乗にしてください。
+template <typename T, uint16_t SIZE>
+class StackchanSpscRing {
+    static_assert((SIZE & (SIZE - 1)) == 0, "SIZE must be a power of 2");
+    protected:
+        T _buf[SIZE];
+        std::atomic<uint16_t> _head;                     // 次に書き込む位置(書き込み側のみ更新)
+        std::atomic<uint16_t> _tail;                     // 次に読み出す位置(読み出し側のみ更新)
+    public:
+        StackchanSpscRing() : _head(0), _tail(0) {}
+        // 満杯の場合はfalse
+        bool push(const T &item) {
+            uint16_t head = _head.load(std::memory_order_relaxed);
+            if ((uint16_t)(head - _tail.load(std::memory_order_acquire)) >= SIZE) return false;
+            _buf[head & (SIZE - 1)] = item;
+            _head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+        // 空の場合はfalse
+        bool pop(T *item) {
+            uint16_t tail = _tail.load(std::memory_order_relaxed);
+            if (tail == _head.load(std::memory_order_acquire)) return false;
+            *item = _buf[tail & (SIZE - 1)];
+            _tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+        bool empty() { return _tail.load(std::memory_order_acquire) == _head.load(std::memory_order_acquire); }
+};
+
+enum ServoCommandType {
+    SERVO_COMMAND_MOVE_X,
+    SERVO_COMMAND_MOVE_Y,
+    SERVO_COMMAND_MOVE_XY,
+    SERVO_COMMAND_MOTION,
+    SERVO_COMMAND_STOP
+};
+
+// サーボタスクへ送るコマンド
+typedef struct ServoCommand {
+    uint8_t type;                      // ServoCommandType
+    int16_t x;
+    int16_t y;
+    uint32_t millis_for_move;
+    char motion_name[MOTION_NAME_LENGTH];
+} servo_command_s;
+
+// サーボの制御を専用のFreeRTOSタスクで一定周期で行うクラス(任意)
+// loop()からはコマンドをリングバッファへ積むだけなので、描画やJSONの解析に時間がかかってもサーボの更新周期は乱れません。
+// コマンドを送るタスクは1つだけにしてください。begin()した後はStackchanSERVOを直接操作しないでください。
+class StackchanServoTask {
+    protected:
+        StackchanSERVO *_servo;
+        StackchanIdleMotion *_idle_motion;               // nullptrの場合は見回し動作なし
+        StackchanSpscRing<servo_command_s, SERVO_COMMAND_RING_SIZE> _commands;
+        uint32_t _interval;                              // 制御周期(msec)
+        uint32_t _dropped_count;                         // リングバッファが満杯で捨てたコマンド数
+        std::atomic<bool> _busy;                         // コマンドの実行中または移動中
+#ifdef ARDUINO
+        TaskHandle_t _task_handle;
+        static void taskLoop(void *arg);
+#endif
+        bool push(const servo_command_s &command);
+    public:
+        StackchanServoTask();
+        // サーボタスクを開始します。(ホストではタスクを作らないので、process()を呼び出してください。)
+        bool begin(StackchanSERVO *servo, int core = SERVO_TASK_CORE, uint32_t interval = SERVO_TASK_INTERVAL,
+                   uint32_t priority = SERVO_TASK_PRIORITY);
+        // 以下はStackchanSERVOの非同期版と同じです。満杯で積めなかった場合はfalse
+        bool moveX(int x, uint32_t millis_for_move = 0);
+        bool moveY(int y, uint32_t millis_for_move = 0);
+        bool moveXY(int x, int y, uint32_t millis_for_move);
+        bool motion(Motion motion_no);
+        bool motion(const char *motion_name);
+        bool stop();
+        // 積まれたコマンドを実行し、tickを1回進めます。(サーボタスクから制御周期ごとに呼び出します。)
+        void process(uint32_t now);
+        bool isMoving() { return _busy.load() || !_commands.empty(); }
+        // 見回し動作をサーボタスクで動かします。begin()の前に設定してください。
+        void setIdleMotion(StackchanIdleMotion *idle_motion) { _idle_motion = idle_motion; }
+        uint32_t getDroppedCount() { return _dropped_count; }
+};
+
+#endif // _STACKCHAN_SERVO_TASK_H_
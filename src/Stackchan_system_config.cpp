@@ -2,25 +2,157 @@
 #define STACKCHAN_SYSTEM_CONFIG_CPP
 #include "Stackchan_system_config.h"
 
-StackchanSystemConfig::StackchanSystemConfig() {
+// モードごとの間隔の初期値(StackchanIdleMotionの初期値と同じです)
+static const servo_interval_s default_servo_interval[AVATAR_MODE_NUM] = {
+    { "normal", 5000, 10000, 500, 1500 },
+    { "sing_mode", 1000, 2000, 500, 1500 }
+};
+static const char *const default_lyrics[] = { "こんにちは", "Hello", "你好", "Bonjour" };
+
+StackchanSystemConfig::StackchanSystemConfig() : _servo_interval(_fallback_interval), _mode_num(AVATAR_MODE_NUM),
+                                                 _lyrics(nullptr), _lyric_strings(nullptr), _lyrics_num(0),
+                                                 _config_doc(&_config_allocator),
+                                                 _config_read_error(false),
+                                                 _cache_fs(nullptr), _cache_filename(SYSTEM_CONFIG_CACHE_FILE),
+                                                 _cache_loaded(false),
+                                                 _load_fs(nullptr), _app_yaml_filesize(0), _secret_yaml_filesize(0),
+                                                 _basic_yaml_filesize(0), _change_callback_num(0) {
+    memcpy(_fallback_interval, default_servo_interval, sizeof(_fallback_interval));
 
 };
 
 StackchanSystemConfig::~StackchanSystemConfig() {
+    releaseConfigDocument();
+    delete[] _lyric_strings;
+}
+
+const JsonDocument* StackchanSystemConfig::readConfigFile(fs::FS& fs, const char* yaml_filename,
+                                                          DeserializationError* error) {
+    fs::File file = fs.open(yaml_filename);
+    if (!file) return nullptr;
+    // 前のファイルの内容を消して同じドキュメントに読み込みます。
+    _config_doc.clear();
+    DeserializationError err = deserializeYml(_config_doc, file);
+    file.close();
+    // メモリが足りずに抜けたキーや値は、エラーにならないことがあります。(overflowed)
+    if (!err && _config_doc.overflowed()) err = DeserializationError::NoMemory;
+    if (error != nullptr) *error = err;
+    if (err == DeserializationError::NoMemory) {
+        // 一部の項目が抜けた設定は使いません。
+        M5_LOGE("yaml file read error: %s (not enough memory, used:%u byte)", yaml_filename,
+                (unsigned)_config_allocator.getUsed());
+        _config_read_error = true;
+        releaseConfigDocument();
+        return nullptr;
+    }
+    M5_LOGI("%s: document used:%u byte", yaml_filename, (unsigned)_config_allocator.getUsed());
+    if (err) {
+        M5_LOGE("yaml file read error: %s\n", yaml_filename);
+        M5_LOGE("error%s\n", err.c_str());
+        _config_read_error = true;
+    }
+    return &_config_doc;
+}
 
+void StackchanSystemConfig::releaseConfigDocument() {
+    // ArduinoJson 7ではclear()で確保した領域を全て解放します。
+    _config_doc.clear();
 }
 
+// 設定ファイルの項目の表(キーのパス, 型, 構造体の中の位置, 初期値, 範囲)
+#define SERVO_XY_FIELDS(key, lower_limit_default, upper_limit_default) \
+    CONFIG_FIELD("servo.pin." key, CONFIG_UINT8, CONFIG_REQUIRED, servo_initial_param_s, pin, 0, 0, 48), \
+    CONFIG_FIELD("servo.offset." key, CONFIG_INT16, 0, servo_initial_param_s, offset, 0, -360, 360), \
+    CONFIG_FIELD("servo.center." key, CONFIG_INT16, CONFIG_REQUIRED, servo_initial_param_s, start_degree, 90, -360, 720), \
+    CONFIG_FIELD("servo.lower_limit." key, CONFIG_INT16, 0, servo_initial_param_s, lower_limit, lower_limit_default, -360, 720), \
+    CONFIG_FIELD("servo.upper_limit." key, CONFIG_INT16, 0, servo_initial_param_s, upper_limit, upper_limit_default, -360, 720), \
+    CONFIG_FIELD("servo.max_velocity." key, CONFIG_FLOAT, 0, servo_initial_param_s, max_velocity, 0, 0, 36000), \
+    CONFIG_FIELD("servo.max_acceleration." key, CONFIG_FLOAT, 0, servo_initial_param_s, max_acceleration, 0, 0, 360000), \
+    CONFIG_FIELD("servo.id." key, CONFIG_UINT8, 0, servo_initial_param_s, id, 0, 0, 253)
+
+static constexpr config_field_s servo_x_fields[] = { SERVO_XY_FIELDS("x", 0, 180) };
+static constexpr config_field_s servo_y_fields[] = { SERVO_XY_FIELDS("y", 50, 90) };
+
+// servo.extra_axesの1軸分(typeは別に読み込みます)
+static constexpr config_field_s servo_extra_axis_fields[] = {
+    CONFIG_FIELD("pin", CONFIG_UINT8, 0, servo_initial_param_s, pin, 0, 0, 48),
+    CONFIG_FIELD("id", CONFIG_UINT8, 0, servo_initial_param_s, id, 0, 0, 253),
+    CONFIG_FIELD("offset", CONFIG_INT16, 0, servo_initial_param_s, offset, 0, -360, 360),
+    CONFIG_FIELD("center", CONFIG_INT16, CONFIG_REQUIRED, servo_initial_param_s, start_degree, 90, -360, 720),
+    CONFIG_FIELD("lower_limit", CONFIG_INT16, 0, servo_initial_param_s, lower_limit, 0, -360, 720),
+    CONFIG_FIELD("upper_limit", CONFIG_INT16, 0, servo_initial_param_s, upper_limit, 0, -360, 720),
+    CONFIG_FIELD("max_velocity", CONFIG_FLOAT, 0, servo_initial_param_s, max_velocity, 0, 0, 36000),
+    CONFIG_FIELD("max_acceleration", CONFIG_FLOAT, 0, servo_initial_param_s, max_acceleration, 0, 0, 360000),
+};
+
+static constexpr config_field_s bluetooth_fields[] = {
+    CONFIG_STRING_FIELD("bluetooth.device_name", CONFIG_REQUIRED, bluetooth_s, device_name, "M5Stack_BTSPK"),
+    CONFIG_FIELD("bluetooth.starting_state", CONFIG_BOOL, 0, bluetooth_s, starting_state, 1, 0, 0),
+    CONFIG_FIELD("bluetooth.start_volume", CONFIG_UINT8, 0, bluetooth_s, start_volume, 150, 0, 255),
+};
+
+static constexpr config_field_s basic_fields[] = {
+    CONFIG_FIELD("auto_power_off_time", CONFIG_UINT32, 0, basic_config_s, auto_power_off_time, 0, 0, 0),
+    CONFIG_STRING_FIELD("balloon.font_language", 0, basic_config_s, font_language_code, "JA"),
+    CONFIG_FIELD("led_lr", CONFIG_UINT8, 0, basic_config_s, led_lr, 0, 0, 2),
+    CONFIG_FIELD("led_pin", CONFIG_INT32, 0, basic_config_s, led_pin, -1, -1, 48),
+    CONFIG_FIELD("takao_base", CONFIG_BOOL, 0, basic_config_s, takao_base, 0, 0, 0),
+    CONFIG_STRING_FIELD("servo_type", CONFIG_REQUIRED, basic_config_s, servo_type_str, "PWM"),
+    CONFIG_FIELD("secret_config_show", CONFIG_BOOL, 0, basic_config_s, secret_config_show, 0, 0, 0),
+};
+
+#define POWER_LIMIT_FIELDS(key, limit, velocity_scale_default, acceleration_scale_default, current_budget_default) \
+    CONFIG_FIELD("power." key ".velocity_scale", CONFIG_FLOAT, 0, power_governor_config_s, limit.velocity_scale, \
+                 velocity_scale_default, 0.05f, 1.0f), \
+    CONFIG_FIELD("power." key ".acceleration_scale", CONFIG_FLOAT, 0, power_governor_config_s, limit.acceleration_scale, \
+                 acceleration_scale_default, 0.05f, 1.0f), \
+    CONFIG_FIELD("power." key ".current_budget", CONFIG_UINT16, 0, power_governor_config_s, limit.current_budget, \
+                 current_budget_default, 0, 10000)
+
+static constexpr config_field_s power_fields[] = {
+    POWER_LIMIT_FIELDS("side_power", limit[SidePower], 1.0f, 1.0f, 0),
+    POWER_LIMIT_FIELDS("back_power", limit[BackPower], 1.0f, 1.0f, 0),
+    POWER_LIMIT_FIELDS("battery", limit[Battery], POWER_GOVERNOR_BATTERY_VELOCITY_SCALE,
+                       POWER_GOVERNOR_BATTERY_ACCELERATION_SCALE, POWER_GOVERNOR_BATTERY_CURRENT_BUDGET),
+    POWER_LIMIT_FIELDS("battery_low", battery_low, POWER_GOVERNOR_BATTERY_LOW_VELOCITY_SCALE,
+                       POWER_GOVERNOR_BATTERY_LOW_ACCELERATION_SCALE, POWER_GOVERNOR_BATTERY_LOW_CURRENT_BUDGET),
+    CONFIG_FIELD("power.battery_low_level", CONFIG_UINT8, 0, power_governor_config_s, battery_low_level,
+                 POWER_GOVERNOR_BATTERY_LOW_LEVEL, 0, 100),
+};
+
+static constexpr config_field_s secret_fields[] = {
+    CONFIG_STRING_FIELD("wifi.ssid", 0, secret_config_s, wifi_info.ssid, ""),
+    CONFIG_STRING_FIELD("wifi.password", 0, secret_config_s, wifi_info.password, ""),
+    CONFIG_STRING_FIELD("apikey.stt", 0, secret_config_s, api_key.stt, ""),
+    CONFIG_STRING_FIELD("apikey.aiservice", 0, secret_config_s, api_key.ai_service, ""),
+    CONFIG_STRING_FIELD("apikey.tts", 0, secret_config_s, api_key.tts, ""),
+};
+
+static const config_schema_table_s servo_x_table = CONFIG_TABLE(servo_x_fields);
+static const config_schema_table_s servo_y_table = CONFIG_TABLE(servo_y_fields);
+static const config_schema_table_s servo_extra_axis_table = CONFIG_TABLE(servo_extra_axis_fields);
+static const config_schema_table_s bluetooth_table = CONFIG_TABLE(bluetooth_fields);
+static const config_schema_table_s basic_table = CONFIG_TABLE(basic_fields);
+static const config_schema_table_s power_table = CONFIG_TABLE(power_fields);
+static const config_schema_table_s secret_table = CONFIG_TABLE(secret_fields);
+
 void StackchanSystemConfig::setDefaultParameters() {
-    // 設定ファイルが存在しないときはデフォルトパラメータを使用します。
-    // PWM サーボでPort.Aを想定しています。
+    // 設定ファイルが存在しないときはデフォルトパラメータ(項目の表の初期値)を使用します。
+    StackchanConfigSchema::setDefaults(&servo_x_table, &_servo[AXIS_X]);
+    StackchanConfigSchema::setDefaults(&servo_y_table, &_servo[AXIS_Y]);
+    StackchanConfigSchema::setDefaults(&bluetooth_table, &_bluetooth);
+    StackchanConfigSchema::setDefaults(&basic_table, &_basic_config);
+    StackchanConfigSchema::setDefaults(&power_table, &_power);
+    // PWM サーボでPort.Aを想定しています。(ホストではM5Stackのピン)
+    _servo[AXIS_X].pin = 22;
+    _servo[AXIS_Y].pin = 21;
+#ifdef ARDUINO
     switch(M5.getBoard()) {
         case m5::board_t::board_M5StackCore2:
             _servo[AXIS_X].pin = 33;
             _servo[AXIS_Y].pin = 32;
             break;
         case m5::board_t::board_M5Stack:
-            _servo[AXIS_X].pin = 22;
-            _servo[AXIS_Y].pin = 21;
             break;
         case m5::board_t::board_M5StackCoreS3:
         case m5::board_t::board_M5StackCoreS3SE:
@@ -29,47 +161,18 @@ void StackchanSystemConfig::setDefaultParameters() {
             break;
         default:
             M5_LOGI("UnknownBoard:%d\n", M5.getBoard());
-            _servo[AXIS_X].pin = 22;
-            _servo[AXIS_Y].pin = 21;
             break;
     }
-    _servo[AXIS_X].offset = 0;
-    _servo[AXIS_X].lower_limit = 0;
-    _servo[AXIS_X].upper_limit = 180;
-    _servo[AXIS_X].start_degree = 90;
-    _servo[AXIS_Y].offset = 0;
-    _servo[AXIS_Y].lower_limit = 50;
-    _servo[AXIS_Y].upper_limit = 90;
-    _servo[AXIS_Y].start_degree = 90;
-    _servo_interval[0].mode_name = "normal";
-    _servo_interval[0].interval_min = 5000;
-    _servo_interval[0].interval_max = 10000;
-    _servo_interval[0].move_min = 500;
-    _servo_interval[0].move_max = 1500;
-    _servo_interval[1].mode_name = "sing_mode";
-    _servo_interval[1].interval_min = 1000;
-    _servo_interval[1].interval_max = 2000;
-    _servo_interval[1].move_min = 500;
-    _servo_interval[1].move_max = 1500;
-    _mode_num = 2;
-    _bluetooth.device_name = "M5Stack_BTSPK";
-    _bluetooth.starting_state = true;
-    _bluetooth.start_volume = 150;
-    _auto_power_off_time = 0;
-    _font_language_code = "JA";
-    _lyrics[0] = "こんにちは";
-    _lyrics[1] = "Hello";
-    _lyrics[2] = "你好";
-    _lyrics[3] = "Bonjour";
-    _lyrics_num = 4;
-    _led_lr = 0;
-    _led_pin = -1;
-    _takao_base = false;
+#endif
+    _servo_axis_num = SERVO_AXIS_XY_NUM;
+    // 初期値の文字列は定数なので、領域にはコピーせずに指します。
+    uint16_t lyrics_num = sizeof(default_lyrics) / sizeof(default_lyrics[0]);
+    if (allocateCollections(0, lyrics_num, 0)) {
+        for (int i = 0; i < lyrics_num; i++) {
+            _lyrics[i] = default_lyrics[i];
+        }
+    }
     _servo_type = ServoType::PWM;
-    _servo[AXIS_X].start_degree = 90;
-    _servo[AXIS_Y].start_degree = 90;
-    _secret_config_show = false;
-
 }
 
 void StackchanSystemConfig::loadConfig(fs::FS& fs, const char *app_yaml_filename, uint32_t app_yaml_filesize,
@@ -77,51 +180,477 @@ void StackchanSystemConfig::loadConfig(fs::FS& fs, const char *app_yaml_filename
                                         const char* basic_yaml_filename, uint32_t basic_yaml_filesize) {
     M5_LOGI("----- StackchanSystemConfig::loadConfig:%s\n", basic_yaml_filename);
     M5_LOGI("----- app_yaml_filename:%s\n", app_yaml_filename);
-    fs::File file = fs.open(basic_yaml_filename);
-    DynamicJsonDocument doc(basic_yaml_filesize);
-    if (file) {
-        DeserializationError err = deserializeYml(doc, file);
-        if (err) {
-            M5_LOGI("yaml file read error: %s\n", basic_yaml_filename);
-            M5_LOGI("error%s\n", err.c_str());
+    _load_fs = &fs;
+    _app_yaml_filename = app_yaml_filename;
+    _app_yaml_filesize = app_yaml_filesize;
+    _secret_yaml_filename = secret_yaml_filename;
+    _secret_yaml_filesize = secret_yaml_filesize;
+    _basic_yaml_filename = basic_yaml_filename;
+    _basic_yaml_filesize = basic_yaml_filesize;
+    uint32_t heap_before = ESP.getFreeHeap();
+    uint32_t start_micros = micros();
+    // 個人情報(WiFiのパスワード, APIキー)はSDを外した後も残らないように、キャッシュには含めません。
+    config_cache_source_s source[2] = {};
+    uint8_t source_num = sizeof(source) / sizeof(source[0]);
+    _cache_loaded = false;
+    if (_cache_fs != nullptr) {
+        StackchanConfigCache::getSource(fs, basic_yaml_filename, &source[0]);
+        StackchanConfigCache::getSource(fs, SERVO_CALIBRATION_YAML, &source[1]);
+        if (readConfigCache(source, source_num)) {
+            M5_LOGI("config cache loaded: %s (%u us)", _cache_filename, micros() - start_micros);
+            _cache_loaded = true;
+            _config_allocator.resetPeak();
+            if (secret_yaml_filesize > 0) {
+                loadSecretConfig(fs, secret_yaml_filename);
+            }
+            if (app_yaml_filesize > 0) {
+                loadExtendConfig(fs, app_yaml_filename, app_yaml_filesize);
+            }
+            releaseConfigDocument();
+            printAllParameters();
+            return;
         }
-        serializeJsonPretty(doc, Serial);
-        setSystemConfig(doc);
+    }
+    // 全てのファイルを同じドキュメントに読み込み、最後に解放します。
+    releaseConfigDocument();
+    _config_allocator.resetPeak();
+    _config_read_error = false;
+    DeserializationError err;
+    const JsonDocument *doc = readConfigFile(fs, basic_yaml_filename, &err);
+    if (doc != nullptr) {
+        serializeJsonPretty(*doc, Serial);
+        setSystemConfig(*doc);
+    } else if (err == DeserializationError::NoMemory) {
+        M5_LOGE("%s: not enough memory. Default Parameters used.", basic_yaml_filename);
+        setDefaultParameters();
     } else {
         Serial.println("ConfigFile Not Found. Default Parameters used.");
         // YAMLファイルが見つからない場合はデフォルト値を利用します。
         setDefaultParameters();
         basicConfigNotFoundCallback();
     }
+    loadServoCalibration(fs, SERVO_CALIBRATION_YAML);
     if (secret_yaml_filesize > 0) {
-        loadSecretConfig(fs, secret_yaml_filename, secret_yaml_filesize);
+        loadSecretConfig(fs, secret_yaml_filename);
     }
     if (app_yaml_filesize > 0) {
         loadExtendConfig(fs, app_yaml_filename, app_yaml_filesize);
     }
+    releaseConfigDocument();
+    M5_LOGI("config parsed: %u us", micros() - start_micros);
+    // 設定ファイルが見つからない場合(コールバックを毎回呼ぶため)と解析できなかった場合はキャッシュしません。
+    // (個人情報はキャッシュしないので、見つからなくてもキャッシュします)
+    bool cacheable = (source[0].size > 0) && !_config_read_error;
+    if (_cache_fs != nullptr) {
+        if (cacheable) {
+            writeConfigCache(source, source_num);
+        } else {
+            clearConfigCache();
+        }
+    }
+    M5_LOGI("config document: peak:%u byte allocs:%u, heap free:%u(before:%u) min_free:%u max_alloc:%u",
+            (unsigned)_config_allocator.getPeak(), (unsigned)_config_allocator.getAllocCount(), ESP.getFreeHeap(),
+            heap_before, ESP.getMinFreeHeap(), ESP.getMaxAllocHeap());
     printAllParameters();
 }
 
-void StackchanSystemConfig::loadSecretConfig(fs::FS& fs, const char* yaml_filename, uint32_t yaml_size) {
-    M5_LOGI("----- StackchanSecretConfig::loadConfig:%s\n", yaml_filename);
-    File file = fs.open(yaml_filename);
-    if (file) {
-        DynamicJsonDocument doc(yaml_size);
-        auto err = deserializeYml( doc, file);
-        if (err) {
-            M5_LOGE("yaml file read error: %s\n", yaml_filename);
-            M5_LOGE("error%s\n", err.c_str());
+// 項目ごとに値をつないだハッシュです。構造体の隙間やStringの中身のポインタは含めません。
+static uint32_t hashValue(uint32_t hash, const void *value, uint32_t size) {
+    return StackchanConfigCache::checksum(hash, (const uint8_t *)value, size);
+}
+
+static uint32_t hashString(uint32_t hash, const char *str) {
+    if (str == nullptr) str = "";
+    return StackchanConfigCache::checksum(hash, (const uint8_t *)str, strlen(str) + 1);
+}
+
+// hash[i]はConfigChangeの(1 << i)の項目です。
+void StackchanSystemConfig::hashConfig(uint32_t *hash) {
+    const uint32_t seed = 2166136261u;
+    for (int i = 0; i < CONFIG_CHANGE_NUM; i++) hash[i] = seed;
+    uint32_t *servo = &hash[0];
+    uint32_t *servo_hardware = &hash[1];
+    *servo_hardware = hashValue(*servo_hardware, &_servo_axis_num, sizeof(_servo_axis_num));
+    *servo_hardware = hashValue(*servo_hardware, &_servo_type, sizeof(_servo_type));
+    for (int i = 0; i < _servo_axis_num; i++) {
+        const servo_initial_param_s *p = &_servo[i];
+        *servo = hashValue(*servo, &p->offset, sizeof(p->offset));
+        *servo = hashValue(*servo, &p->lower_limit, sizeof(p->lower_limit));
+        *servo = hashValue(*servo, &p->upper_limit, sizeof(p->upper_limit));
+        *servo = hashValue(*servo, &p->start_degree, sizeof(p->start_degree));
+        *servo = hashValue(*servo, &p->max_velocity, sizeof(p->max_velocity));
+        *servo = hashValue(*servo, &p->max_acceleration, sizeof(p->max_acceleration));
+        *servo_hardware = hashValue(*servo_hardware, &p->pin, sizeof(p->pin));
+        *servo_hardware = hashValue(*servo_hardware, &p->id, sizeof(p->id));
+        *servo_hardware = hashValue(*servo_hardware, &p->servo_type, sizeof(p->servo_type));
+    }
+    hash[2] = hashValue(hash[2], &_mode_num, sizeof(_mode_num));
+    for (int i = 0; i < _mode_num; i++) {
+        const servo_interval_s *interval = &_servo_interval[i];
+        hash[2] = hashString(hash[2], interval->mode_name);
+        hash[2] = hashValue(hash[2], &interval->interval_min, sizeof(interval->interval_min));
+        hash[2] = hashValue(hash[2], &interval->interval_max, sizeof(interval->interval_max));
+        hash[2] = hashValue(hash[2], &interval->move_min, sizeof(interval->move_min));
+        hash[2] = hashValue(hash[2], &interval->move_max, sizeof(interval->move_max));
+    }
+    hash[3] = hashValue(hash[3], &_lyrics_num, sizeof(_lyrics_num));
+    for (int i = 0; i < _lyrics_num; i++) {
+        hash[3] = hashString(hash[3], _lyrics[i]);
+    }
+    hash[4] = hashValue(hash[4], &_basic_config.led_lr, sizeof(_basic_config.led_lr));
+    hash[4] = hashValue(hash[4], &_basic_config.led_pin, sizeof(_basic_config.led_pin));
+    for (int i = 0; i < POWER_STATUS_NUM + 1; i++) {
+        const servo_power_limit_s *limit = (i < POWER_STATUS_NUM) ? &_power.limit[i] : &_power.battery_low;
+        hash[5] = hashValue(hash[5], &limit->velocity_scale, sizeof(limit->velocity_scale));
+        hash[5] = hashValue(hash[5], &limit->acceleration_scale, sizeof(limit->acceleration_scale));
+        hash[5] = hashValue(hash[5], &limit->current_budget, sizeof(limit->current_budget));
+    }
+    hash[5] = hashValue(hash[5], &_power.battery_low_level, sizeof(_power.battery_low_level));
+    hash[6] = hashString(hash[6], _bluetooth.device_name.c_str());
+    hash[6] = hashValue(hash[6], &_bluetooth.starting_state, sizeof(_bluetooth.starting_state));
+    hash[6] = hashValue(hash[6], &_bluetooth.start_volume, sizeof(_bluetooth.start_volume));
+    hash[7] = hashString(hash[7], _secret_config.wifi_info.ssid.c_str());
+    hash[7] = hashString(hash[7], _secret_config.wifi_info.password.c_str());
+    hash[7] = hashString(hash[7], _secret_config.api_key.stt.c_str());
+    hash[7] = hashString(hash[7], _secret_config.api_key.ai_service.c_str());
+    hash[7] = hashString(hash[7], _secret_config.api_key.tts.c_str());
+    hash[8] = hashValue(hash[8], &_basic_config.auto_power_off_time, sizeof(_basic_config.auto_power_off_time));
+    hash[8] = hashString(hash[8], _basic_config.font_language_code.c_str());
+    hash[8] = hashValue(hash[8], &_basic_config.takao_base, sizeof(_basic_config.takao_base));
+    hash[8] = hashValue(hash[8], &_basic_config.secret_config_show, sizeof(_basic_config.secret_config_show));
+    hash[9] = hashExtendConfig();
+}
+
+void StackchanSystemConfig::holdCollections(config_collections_s *previous) {
+    previous->arena.swap(_arena);
+    previous->servo_interval = _servo_interval;
+    previous->mode_num = _mode_num;
+    previous->lyrics = _lyrics;
+    previous->lyrics_num = _lyrics_num;
+    previous->lyric_strings = _lyric_strings;
+    // allocateCollectionsで解放されないように外しておきます。
+    _lyric_strings = nullptr;
+}
+
+void StackchanSystemConfig::restoreCollections(config_collections_s *previous) {
+    // 新しく読み込んだ領域はpreviousと一緒に解放されます。
+    _arena.swap(previous->arena);
+    delete[] _lyric_strings;
+    _servo_interval = previous->servo_interval;
+    _mode_num = previous->mode_num;
+    _lyrics = previous->lyrics;
+    _lyrics_num = previous->lyrics_num;
+    _lyric_strings = previous->lyric_strings;
+    previous->lyric_strings = nullptr;
+}
+
+uint16_t StackchanSystemConfig::notifyChanges(const uint32_t *hash_before, config_collections_s *previous) {
+    uint32_t hash[CONFIG_CHANGE_NUM];
+    hashConfig(hash);
+    uint16_t changes = 0;
+    for (int i = 0; i < CONFIG_CHANGE_NUM; i++) {
+        if (hash[i] != hash_before[i]) changes |= (1 << i);
+    }
+    const uint16_t collections = CONFIG_CHANGE_INTERVAL | CONFIG_CHANGE_LYRICS;
+    if (changes & collections) {
+        // 間隔とセリフは同じ領域にあるので、どちらかが変わった場合は両方のポインタが変わります。
+        changes |= collections;
+        delete[] previous->lyric_strings;
+        previous->lyric_strings = nullptr;
+    } else {
+        restoreCollections(previous);
+    }
+    M5_LOGI("config reloaded: changes:0x%03x", changes);
+    if (changes & CONFIG_CHANGE_SERVO_HARDWARE) {
+        M5_LOGW("servo pin/id/type changed: restart to apply");
+    }
+    if (changes == 0) return 0;
+    for (int i = 0; i < _change_callback_num; i++) {
+        const config_change_callback_s *cb = &_change_callback[i];
+        if (changes & cb->mask) cb->callback(this, changes, cb->user_data);
+    }
+    return changes;
+}
+
+uint16_t StackchanSystemConfig::reloadConfig() {
+    if (_load_fs == nullptr) return 0;
+    uint32_t hash_before[CONFIG_CHANGE_NUM];
+    hashConfig(hash_before);
+    config_collections_s previous;
+    holdCollections(&previous);
+    // キャッシュはファイルのサイズと更新日時で確認するので、変わっていなければそのまま読み込まれます。
+    loadConfig(*_load_fs, _app_yaml_filename.c_str(), _app_yaml_filesize,
+               _secret_yaml_filename.c_str(), _secret_yaml_filesize,
+               _basic_yaml_filename.c_str(), _basic_yaml_filesize);
+    return notifyChanges(hash_before, &previous);
+}
+
+uint16_t StackchanSystemConfig::reloadConfig(Stream& stream) {
+    uint32_t hash_before[CONFIG_CHANGE_NUM];
+    hashConfig(hash_before);
+    releaseConfigDocument();
+    DeserializationError err = deserializeYml(_config_doc, stream);
+    if (err || _config_doc.overflowed()) {
+        // 一部の項目が抜けた設定は反映しません。
+        M5_LOGE("yaml stream read error: %s", err ? err.c_str() : "overflowed");
+        releaseConfigDocument();
+        return 0;
+    }
+    config_collections_s previous;
+    holdCollections(&previous);
+    setSystemConfig(_config_doc);
+    _cache_loaded = false;
+    if (_load_fs != nullptr) {
+        loadServoCalibration(*_load_fs, SERVO_CALIBRATION_YAML);
+    }
+    releaseConfigDocument();
+    // ファイルとは内容が違うので、次回の起動時にキャッシュを使わないようにします。
+    clearConfigCache();
+    return notifyChanges(hash_before, &previous);
+}
+
+bool StackchanSystemConfig::addChangeCallback(config_change_callback_t callback, uint16_t mask, void *user_data) {
+    if ((callback == nullptr) || (_change_callback_num >= CONFIG_CHANGE_CALLBACK_MAX)) return false;
+    config_change_callback_s *cb = &_change_callback[_change_callback_num++];
+    cb->callback = callback;
+    cb->mask = mask;
+    cb->user_data = user_data;
+    return true;
+}
+
+void StackchanSystemConfig::applyServoParam(StackchanSERVO *servo) {
+    uint8_t axis_num = min(_servo_axis_num, servo->getAxisNum());
+    for (int i = 0; i < axis_num; i++) {
+        servo->setOffset((ServoAxis)i, _servo[i].offset);
+        servo->setLimit((ServoAxis)i, _servo[i].lower_limit, _servo[i].upper_limit);
+        servo->setMotionLimit((ServoAxis)i, _servo[i].max_velocity, _servo[i].max_acceleration);
+    }
+}
+
+// キャリブレーションの結果がある場合は、offsetと可動範囲を上書きします。
+void StackchanSystemConfig::loadServoCalibration(fs::FS& fs, const char* yaml_filename) {
+    if (!fs.exists(yaml_filename)) return;
+    DeserializationError err;
+    const JsonDocument *doc = readConfigFile(fs, yaml_filename, &err);
+    if ((doc == nullptr) || err) return;
+    M5_LOGI("----- servo calibration:%s\n", yaml_filename);
+    setServoCalibration(*doc);
+}
+
+// 値が指定されている場合のみ上書きします。
+static void overrideServoValue(JsonVariantConst value, int16_t *param) {
+    if (!value.isNull()) *param = value.as<int16_t>();
+}
+
+void StackchanSystemConfig::setServoCalibration(const JsonDocument& doc) {
+    JsonObjectConst servo = doc["servo"];
+    const char *axis_key[SERVO_AXIS_XY_NUM] = { "x", "y" };
+    for (int i = 0; i < SERVO_AXIS_XY_NUM; i++) {
+        overrideServoValue(servo["offset"][axis_key[i]], &_servo[i].offset);
+        overrideServoValue(servo["lower_limit"][axis_key[i]], &_servo[i].lower_limit);
+        overrideServoValue(servo["upper_limit"][axis_key[i]], &_servo[i].upper_limit);
+    }
+    int i = SERVO_AXIS_XY_NUM;
+    for (JsonObjectConst extra_axis : servo["extra_axes"].as<JsonArrayConst>()) {
+        if (i >= _servo_axis_num) break;
+        overrideServoValue(extra_axis["offset"], &_servo[i].offset);
+        overrideServoValue(extra_axis["lower_limit"], &_servo[i].lower_limit);
+        overrideServoValue(extra_axis["upper_limit"], &_servo[i].upper_limit);
+        i++;
+    }
+}
+
+bool StackchanSystemConfig::saveServoCalibration(fs::FS& fs, StackchanServoCalibration *calibration, const char* yaml_filename) {
+    if ((calibration == nullptr) || !calibration->isDone()) return false;
+    // 更新日時が取れない(時刻が未設定の)場合も次回は解析し直すように、キャッシュを消しておきます。
+    clearConfigCache();
+    for (int i = 0; i < _servo_axis_num; i++) {
+        const servo_calibration_s *r = calibration->getResult((ServoAxis)i);
+        _servo[i].offset      = r->offset;
+        _servo[i].lower_limit = r->lower_limit;
+        _servo[i].upper_limit = r->upper_limit;
+    }
+    File file = fs.open(yaml_filename, FILE_WRITE);
+    if (!file) {
+        M5_LOGE("file open error: %s", yaml_filename);
+        return false;
+    }
+    // SC_BasicConfig.yamlと同じ形式で、offsetと可動範囲のみを書き込みます。
+    file.printf("# StackchanServoCalibration result (overrides servo in SC_BasicConfig.yaml)\n");
+    file.printf("servo:\n");
+    file.printf("  offset:\n    x: %d\n    y: %d\n", _servo[AXIS_X].offset, _servo[AXIS_Y].offset);
+    file.printf("  lower_limit:\n    x: %d\n    y: %d\n", _servo[AXIS_X].lower_limit, _servo[AXIS_Y].lower_limit);
+    file.printf("  upper_limit:\n    x: %d\n    y: %d\n", _servo[AXIS_X].upper_limit, _servo[AXIS_Y].upper_limit);
+    if (_servo_axis_num > SERVO_AXIS_XY_NUM) {
+        file.printf("  extra_axes:\n");
+        for (int i = SERVO_AXIS_XY_NUM; i < _servo_axis_num; i++) {
+            file.printf("  - offset: %d\n    lower_limit: %d\n    upper_limit: %d\n",
+                        _servo[i].offset, _servo[i].lower_limit, _servo[i].upper_limit);
         }
-        else{
-            setSecretConfig(doc);
+    }
+    file.close();
+    M5_LOGI("servo calibration saved: %s", yaml_filename);
+    return true;
+}
+
+void StackchanSystemConfig::setConfigCache(fs::FS& cache_fs, const char* cache_filename) {
+    _cache_fs = &cache_fs;
+    _cache_filename = cache_filename;
+}
+
+void StackchanSystemConfig::clearConfigCache() {
+    if ((_cache_fs != nullptr) && _cache_fs->exists(_cache_filename)) {
+        _cache_fs->remove(_cache_filename);
+    }
+}
+
+// 構造体のサイズが変わった場合(SERVO_AXIS_MAXの変更など)も読み込まないようにします。
+static const uint16_t config_cache_layout = sizeof(servo_initial_param_s) * SERVO_AXIS_MAX
+                                           + sizeof(power_governor_config_s) + sizeof(servo_interval_s);
+
+bool StackchanSystemConfig::allocateCollections(uint8_t mode_num, uint16_t lyrics_num, size_t string_size) {
+    // 足りないモードは初期値で埋めるので、getServoInterval(AvatarMode)は常に使えます。
+    uint8_t interval_num = max(mode_num, (uint8_t)AVATAR_MODE_NUM);
+    size_t size = StackchanConfigArena::arraySize<servo_interval_s>(interval_num)
+                + StackchanConfigArena::arraySize<const char*>(lyrics_num) + string_size;
+    _servo_interval = nullptr;
+    _lyrics = nullptr;
+    delete[] _lyric_strings;
+    _lyric_strings = nullptr;
+    if (_arena.reserve(size)) {
+        _servo_interval = _arena.allocateArray<servo_interval_s>(interval_num);
+        _lyrics = _arena.allocateArray<const char*>(lyrics_num);
+    }
+    if ((_servo_interval == nullptr) || ((lyrics_num > 0) && (_lyrics == nullptr))) {
+        M5_LOGE("config: failed to allocate %u bytes", (unsigned)size);
+        _arena.release();
+        memcpy(_fallback_interval, default_servo_interval, sizeof(_fallback_interval));
+        _servo_interval = _fallback_interval;
+        _mode_num = AVATAR_MODE_NUM;
+        _lyrics = nullptr;
+        _lyrics_num = 0;
+        return false;
+    }
+    for (int i = 0; i < interval_num; i++) {
+        _servo_interval[i] = default_servo_interval[min(i, AVATAR_MODE_NUM - 1)];
+    }
+    _mode_num = interval_num;
+    _lyrics_num = lyrics_num;
+    for (int i = 0; i < lyrics_num; i++) {
+        _lyrics[i] = "";
+    }
+    return true;
+}
+
+// 項目の順序はreadConfigCacheと同じにしてください。
+bool StackchanSystemConfig::writeConfigCache(const config_cache_source_s *source, uint8_t source_num) {
+    StackchanConfigCache cache;
+    cache.put(_servo_axis_num);
+    cache.write(_servo, sizeof(_servo));
+    // 読み込む側で領域を1回で確保できるように、リストの数と文字列の合計を先に書き込みます。
+    uint32_t string_size = 0;
+    for (int i = 0; i < _mode_num; i++) {
+        string_size += StackchanConfigArena::stringSize(_servo_interval[i].mode_name);
+    }
+    for (int i = 0; i < _lyrics_num; i++) {
+        string_size += StackchanConfigArena::stringSize(_lyrics[i]);
+    }
+    cache.put(_mode_num);
+    cache.put(_lyrics_num);
+    cache.put(string_size);
+    for (int i = 0; i < _mode_num; i++) {
+        cache.putString(_servo_interval[i].mode_name);
+        cache.put(_servo_interval[i].interval_min);
+        cache.put(_servo_interval[i].interval_max);
+        cache.put(_servo_interval[i].move_min);
+        cache.put(_servo_interval[i].move_max);
+    }
+    for (int i = 0; i < _lyrics_num; i++) {
+        cache.putString(_lyrics[i]);
+    }
+    cache.putString(_bluetooth.device_name);
+    cache.put(_bluetooth.starting_state);
+    cache.put(_bluetooth.start_volume);
+    cache.put(_basic_config.auto_power_off_time);
+    cache.putString(_basic_config.font_language_code);
+    cache.put(_basic_config.led_lr);
+    cache.put(_basic_config.led_pin);
+    cache.put(_basic_config.takao_base);
+    cache.put(_power);
+    cache.putString(_basic_config.servo_type_str);
+    cache.put(_servo_type);
+    cache.put(_basic_config.secret_config_show);
+    if (!cache.save(*_cache_fs, _cache_filename, SYSTEM_CONFIG_CACHE_VERSION, config_cache_layout, source, source_num)) {
+        M5_LOGE("config cache write error: %s", _cache_filename);
+        return false;
+    }
+    M5_LOGI("config cache saved: %s", _cache_filename);
+    return true;
+}
+
+bool StackchanSystemConfig::readConfigCache(const config_cache_source_s *source, uint8_t source_num) {
+    StackchanConfigCache cache;
+    if (!cache.load(*_cache_fs, _cache_filename, SYSTEM_CONFIG_CACHE_VERSION, config_cache_layout, source, source_num)) {
+        return false;
+    }
+    cache.get(&_servo_axis_num);
+    cache.read(_servo, sizeof(_servo));
+    uint8_t mode_num = 0;
+    uint16_t lyrics_num = 0;
+    uint32_t string_size = 0;
+    cache.get(&mode_num);
+    cache.get(&lyrics_num);
+    cache.get(&string_size);
+    if (cache.isError() || (string_size > CONFIG_CACHE_MAX_SIZE)
+        || !allocateCollections(mode_num, lyrics_num, string_size)) return false;
+    for (int i = 0; i < mode_num; i++) {
+        const char *mode_name = cache.getCString();
+        if (mode_name == nullptr) return false;
+        _servo_interval[i].mode_name = _arena.copyString(mode_name);
+        cache.get(&_servo_interval[i].interval_min);
+        cache.get(&_servo_interval[i].interval_max);
+        cache.get(&_servo_interval[i].move_min);
+        cache.get(&_servo_interval[i].move_max);
+    }
+    for (int i = 0; i < lyrics_num; i++) {
+        const char *lyric = cache.getCString();
+        if (lyric == nullptr) return false;
+        _lyrics[i] = _arena.copyString(lyric);
+    }
+    cache.getString(&_bluetooth.device_name);
+    cache.get(&_bluetooth.starting_state);
+    cache.get(&_bluetooth.start_volume);
+    cache.get(&_basic_config.auto_power_off_time);
+    cache.getString(&_basic_config.font_language_code);
+    cache.get(&_basic_config.led_lr);
+    cache.get(&_basic_config.led_pin);
+    cache.get(&_basic_config.takao_base);
+    cache.get(&_power);
+    cache.getString(&_basic_config.servo_type_str);
+    cache.get(&_servo_type);
+    cache.get(&_basic_config.secret_config_show);
+    if (cache.isError() || (_servo_axis_num > SERVO_AXIS_MAX)) {
+        M5_LOGE("config cache is broken: %s", _cache_filename);
+        return false;
+    }
+    return true;
+}
+
+void StackchanSystemConfig::loadSecretConfig(fs::FS& fs, const char* yaml_filename) {
+    M5_LOGI("----- StackchanSecretConfig::loadConfig:%s\n", yaml_filename);
+    DeserializationError err;
+    const JsonDocument *doc = readConfigFile(fs, yaml_filename, &err);
+    if (doc != nullptr) {
+        if (!err) {
+            setSecretConfig(*doc);
         }
 
-        if (_secret_config_show) {
+        if (_basic_config.secret_config_show) {
             // 個人的な情報をログに表示する。
             M5_LOGI("=======================================================================================");
             M5_LOGI("下記の情報は公開してはいけません。(The following information must not be disclosed.)");
             M5_LOGI("");
-            serializeJsonPretty(doc, Serial);
+            serializeJsonPretty(*doc, Serial);
             M5_LOGI("");
             printSecretParameters();
             M5_LOGI("");
@@ -129,105 +658,164 @@ void StackchanSystemConfig::loadSecretConfig(fs::FS& fs, const char* yaml_filena
             M5_LOGI("=======================================================================================");
         }
     }
-    else{
+    else if (err != DeserializationError::NoMemory) {
         secretConfigNotFoundCallback();
     }
 }
 
-void StackchanSystemConfig::setSystemConfig(DynamicJsonDocument doc) {
-    JsonObject servo = doc["servo"];
-    _servo[AXIS_X].pin = servo["pin"]["x"];
-    _servo[AXIS_Y].pin = servo["pin"]["y"];
+// servo_typeの文字列をServoTypeに変換します。
+static uint8_t parseServoType(const String &servo_type_str) {
+    if (servo_type_str.indexOf("SCS") != -1) {
+        // SCS0009
+        return ServoType::SCS;
+    } else if (servo_type_str.indexOf("RT_DYN_XL330") != -1) {
+        // Dynamixel XL330 for RT Version
+        return ServoType::RT_DYN_XL330;
+    } else if (servo_type_str.indexOf("DYN_XL330") != -1) {
+        // Dynamixel XL330
+        return ServoType::DYN_XL330;
+    }
+    // PWMサーボ
+    return ServoType::PWM;
+}
+
+void StackchanSystemConfig::getServoInitialParam(stackchan_servo_initial_param_s *init_param) {
+    memset(init_param, 0, sizeof(stackchan_servo_initial_param_s));
+    init_param->axis_num = _servo_axis_num;
+    for (int i = 0; i < _servo_axis_num; i++) {
+        servo_param_s *servo = &init_param->servo[i];
+        servo->pin          = _servo[i].pin;
+        servo->start_degree = _servo[i].start_degree;
+        servo->offset       = _servo[i].offset;
+        servo->lower_limit  = _servo[i].lower_limit;
+        servo->upper_limit  = _servo[i].upper_limit;
+        servo->id           = _servo[i].id;
+        servo->servo_type   = _servo[i].servo_type;
+    }
+}
+
+
+// 項目の表の外で読み込むキーと、アプリケーションが使用するキー
+static const char *const basic_handled_paths[] = {
+    "servo.speed", "servo.extra_axes", "balloon.lyrics",
+    "extend_config_filename", "extend_config_filesize", "secret_config_filename", "secret_config_filesize",
+    nullptr
+};
 
-    _servo[AXIS_X].offset = servo["offset"]["x"];
-    _servo[AXIS_Y].offset = servo["offset"]["y"];
+// セリフの文字列を返します。数値とtrue/false(YAMLの - 123 など)は文字列に変換してbufferに置きます。
+// null, リスト, オブジェクトの場合はnullptr
+static const char* lyricText(JsonVariantConst lyric, String *buffer) {
+    if (lyric.is<const char*>()) return lyric.as<const char*>();
+    if (lyric.is<bool>() || lyric.is<double>()) {
+        *buffer = lyric.as<String>();
+        return buffer->c_str();
+    }
+    return nullptr;
+}
 
-    _servo[AXIS_X].start_degree = servo["center"]["x"];
-    _servo[AXIS_Y].start_degree = servo["center"]["y"];
+void StackchanSystemConfig::setSystemConfig(const JsonDocument& doc) {
+    StackchanConfigSchema::load(doc.as<JsonVariantConst>(), &servo_x_table, &_servo[AXIS_X]);
+    StackchanConfigSchema::load(doc.as<JsonVariantConst>(), &servo_y_table, &_servo[AXIS_Y]);
+    StackchanConfigSchema::load(doc.as<JsonVariantConst>(), &bluetooth_table, &_bluetooth);
+    StackchanConfigSchema::load(doc.as<JsonVariantConst>(), &basic_table, &_basic_config);
+    StackchanConfigSchema::load(doc.as<JsonVariantConst>(), &power_table, &_power);
+    const config_schema_table_s tables[] = { servo_x_table, servo_y_table, bluetooth_table, basic_table, power_table };
+    StackchanConfigSchema::reportUnknownKeys(doc.as<JsonObjectConst>(), tables, sizeof(tables) / sizeof(tables[0]),
+                                             basic_handled_paths);
+    _servo_type = parseServoType(_basic_config.servo_type_str);
 
-    _servo[AXIS_X].lower_limit = servo["lower_limit"]["x"];
-    _servo[AXIS_X].upper_limit = servo["upper_limit"]["x"];
-    _servo[AXIS_Y].lower_limit = servo["lower_limit"]["y"];
-    _servo[AXIS_Y].upper_limit = servo["upper_limit"]["y"];
+    JsonObjectConst servo = doc["servo"];
+    // X, Y以外の軸(体のロール、耳など)
+    _servo_axis_num = SERVO_AXIS_XY_NUM;
+    for (JsonObjectConst extra_axis : servo["extra_axes"].as<JsonArrayConst>()) {
+        if (_servo_axis_num >= SERVO_AXIS_MAX) {
+            M5_LOGW("servo.extra_axes: up to %d axes", SERVO_AXIS_MAX - SERVO_AXIS_XY_NUM);
+            break;
+        }
+        servo_initial_param_s *axis = &_servo[_servo_axis_num++];
+        axis->servo_type = parseServoType(extra_axis["type"].as<String>());
+        StackchanConfigSchema::load(extra_axis, &servo_extra_axis_table, axis, "servo.extra_axes[].");
+    }
+    // モードごとの間隔とセリフは、数と文字列の合計から領域を1回だけ確保してコピーします。
+    // (読み込んだドキュメントは解放されるので、キーの文字列も指したままにはしません。)
+    JsonObjectConst servo_speed = servo["speed"];
+    JsonArrayConst balloon_lyrics = doc["balloon"]["lyrics"];
+    size_t string_size = 0;
+    for (JsonPairConst servo_speed_item : servo_speed) {
+        string_size += StackchanConfigArena::stringSize(servo_speed_item.key().c_str());
+    }
+    uint16_t lyrics_num = 0;
+    int lyric_index = 0;
+    String lyric_buffer;
+    for (JsonVariantConst lyric : balloon_lyrics) {
+        const char *text = lyricText(lyric, &lyric_buffer);
+        if (text == nullptr) {
+            M5_LOGW("balloon.lyrics[%d]: not a string, skipped", lyric_index);
+        } else if (lyrics_num < UINT16_MAX) {
+            string_size += StackchanConfigArena::stringSize(text);
+            lyrics_num++;
+        }
+        lyric_index++;
+    }
+    uint8_t mode_num = min(servo_speed.size(), (size_t)UINT8_MAX);
+    if (!allocateCollections(mode_num, lyrics_num, string_size)) return;
     int i = 0;
-    for (JsonPair servo_speed_item : servo["speed"].as<JsonObject>()) {
-        _servo_interval[i].mode_name = servo_speed_item.key().c_str();
+    for (JsonPairConst servo_speed_item : servo_speed) {
+        if (i >= mode_num) break;
+        _servo_interval[i].mode_name = _arena.copyString(servo_speed_item.key().c_str());
         _servo_interval[i].interval_min = servo_speed_item.value()["interval_min"];
         _servo_interval[i].interval_max = servo_speed_item.value()["interval_max"];
         _servo_interval[i].move_min = servo_speed_item.value()["move_min"];
         _servo_interval[i].move_max = servo_speed_item.value()["move_max"];
         i++;
     }
-    _mode_num = i;
-
-    _bluetooth.device_name = doc["bluetooth"]["device_name"].as<String>();
-    _bluetooth.starting_state = doc["bluetooth"]["starting_state"];//.as<bool>();
-    _bluetooth.start_volume = doc["bluetooth"]["start_volume"];
-
-    _auto_power_off_time = doc["auto_power_off_time"];
-    _font_language_code = doc["balloon"]["font_language"].as<String>();
-    
-    JsonArray balloon_lyrics = doc["balloon"]["lyrics"];
-        
-    _lyrics_num = balloon_lyrics.size();
-    M5_LOGI("lyrics_num:%d\n", _lyrics_num);
-    for (int j=0;j<_lyrics_num;j++) {
-        _lyrics[j] = balloon_lyrics[j].as<String>();
-    }
-    _led_lr = doc["led_lr"];
-    _led_pin = doc["led_pin"];
-    _takao_base = doc["takao_base"];
-    _servo_type_str = doc["servo_type"].as<String>();
-    if (_servo_type_str.indexOf("SCS") != -1) {
-        // SCS0009
-        _servo_type = ServoType::SCS;
-    } else if (_servo_type_str.indexOf("RT_DYN_XL330") != -1) {
-        // Dynamixel XL330 for RT Version
-        _servo_type = ServoType::RT_DYN_XL330;
-    } else if (_servo_type_str.indexOf("DYN_XL330") != -1) {
-        // Dynamixel XL330
-        _servo_type = ServoType::DYN_XL330;
-    } else  {
-        // PWMサーボ
-        _servo_type = ServoType::PWM;
+    int j = 0;
+    for (JsonVariantConst lyric : balloon_lyrics) {
+        if (j >= lyrics_num) break;
+        const char *text = lyricText(lyric, &lyric_buffer);
+        if (text != nullptr) _lyrics[j++] = _arena.copyString(text);
     }
-    _secret_config_show     = doc["secret_config_show"].as<bool>(); 
-    
+    M5_LOGI("lyrics_num:%d mode_num:%d config arena:%u/%u byte\n", _lyrics_num, _mode_num,
+            (unsigned)_arena.getUsed(), (unsigned)_arena.getCapacity());
 }
 
-void StackchanSystemConfig::setSecretConfig(DynamicJsonDocument doc) {
-
-    _secret_config.wifi_info.ssid     = doc["wifi"]["ssid"].as<String>();
-    _secret_config.wifi_info.password = doc["wifi"]["password"].as<String>();
-    
-    _secret_config.api_key.stt        = doc["apikey"]["stt"].as<String>();
-    _secret_config.api_key.ai_service = doc["apikey"]["aiservice"].as<String>();
-    _secret_config.api_key.tts        = doc["apikey"]["tts"].as<String>();
+String* StackchanSystemConfig::getLyric(uint8_t no) {
+    // 使わない場合にStringの分のメモリを確保しないように、初めて呼ばれたときに作ります。
+    // 最後の1つは範囲外の場合に返す空の文字列です。
+    if (_lyric_strings == nullptr) {
+        _lyric_strings = new String[_lyrics_num + 1];
+        for (int i = 0; i < _lyrics_num; i++) {
+            _lyric_strings[i] = _lyrics[i];
+        }
+    }
+    return &_lyric_strings[(no < _lyrics_num) ? no : _lyrics_num];
+}
 
+void StackchanSystemConfig::setSecretConfig(const JsonDocument& doc) {
+    StackchanConfigSchema::load(doc.as<JsonVariantConst>(), &secret_table, &_secret_config);
+    StackchanConfigSchema::reportUnknownKeys(doc.as<JsonObjectConst>(), &secret_table, 1, nullptr);
 }
 
 const lgfx::IFont* StackchanSystemConfig::getFont() {
-    if (_font_language_code.compareTo("JA")) {
+    if (_basic_config.font_language_code.compareTo("JA")) {
         return &fonts::efontJA_16;
-    } else if (_font_language_code.compareTo("CN")) {
+    } else if (_basic_config.font_language_code.compareTo("CN")) {
         return &fonts::efontCN_16;
     } else {
-        M5_LOGI("FontCodeError:%s\n", _font_language_code);
+        M5_LOGI("FontCodeError:%s\n", _basic_config.font_language_code.c_str());
         return &fonts::Font0;
     }
 } 
 
 void StackchanSystemConfig::printAllParameters() {
-    M5_LOGI("servo:pin_x:%d", _servo[AXIS_X].pin);
-    M5_LOGI("servo:pin_y:%d", _servo[AXIS_Y].pin);
-    M5_LOGI("servo:offset_x:%d", _servo[AXIS_X].offset);
-    M5_LOGI("servo:offset_y:%d", _servo[AXIS_Y].offset);
-    M5_LOGI("servo.start_degree_x:%d", _servo[AXIS_X].start_degree);
-    M5_LOGI("servo.start_degree_y:%d", _servo[AXIS_Y].start_degree);
-    M5_LOGI("servo.lower_limit_x:%d", _servo[AXIS_X].lower_limit);
-    M5_LOGI("servo.lower_limit_y:%d", _servo[AXIS_Y].lower_limit);
-    M5_LOGI("servo.upper_limit_x:%d", _servo[AXIS_X].upper_limit);
-    M5_LOGI("servo.upper_limit_y:%d", _servo[AXIS_Y].upper_limit);
+    StackchanConfigSchema::print(&servo_x_table, &_servo[AXIS_X]);
+    StackchanConfigSchema::print(&servo_y_table, &_servo[AXIS_Y]);
+    for (int i = SERVO_AXIS_XY_NUM; i < _servo_axis_num; i++) {
+        char prefix[32];
+        snprintf(prefix, sizeof(prefix), "servo.extra_axes[%d].", i - SERVO_AXIS_XY_NUM);
+        M5_LOGI("%stype:%d", prefix, _servo[i].servo_type);
+        StackchanConfigSchema::print(&servo_extra_axis_table, &_servo[i], prefix);
+    }
     for (int i=0;i<_mode_num;i++) {
         M5_LOGI("mode:%s", _servo_interval[i].mode_name);
         M5_LOGI("interval_min:%d", _servo_interval[i].interval_min);
@@ -236,33 +824,22 @@ void StackchanSystemConfig::printAllParameters() {
         M5_LOGI("move_max:%d", _servo_interval[i].move_max);
     }
     M5_LOGI("mode_num:%d", _mode_num);
-    M5_LOGI("Bluetooth_device_name:%s", _bluetooth.device_name.c_str());
-    M5_LOGI("Bluetooth_starting_state:%s", _bluetooth.starting_state ? "true":"false");
-    M5_LOGI("Bluetooth_start_volume:%d", _bluetooth.start_volume);
-    M5_LOGI("auto_power_off_time:%d", _auto_power_off_time);
-    M5_LOGI("font_language:%s", _font_language_code);
+    StackchanConfigSchema::print(&bluetooth_table, &_bluetooth);
     for (int i=0;i<_lyrics_num;i++) {
-        M5_LOGI("lyrics:%d:%s", i, _lyrics[i].c_str());
+        M5_LOGI("lyrics:%d:%s", i, _lyrics[i]);
     }
-    M5_LOGI("led_lr:%d", _led_lr);
-    M5_LOGI("led_pin:%d", _led_pin);
-    M5_LOGI("use takao_base:%s", _takao_base ? "true":"false");
-    M5_LOGI("ServoTypeStr:%s", _servo_type_str.c_str());
+    StackchanConfigSchema::print(&basic_table, &_basic_config);
     M5_LOGI("ServoType: %d", _servo_type);
-    M5_LOGI("secret_config_show:%s", _secret_config_show ? "true":"false");
+    StackchanConfigSchema::print(&power_table, &_power);
 
     printExtParameters();
 }
 
 void StackchanSystemConfig::printSecretParameters() {
-    M5_LOGI("wifi_ssid: %s", _secret_config.wifi_info.ssid.c_str());
-    M5_LOGI("wifi_passws: %s", _secret_config.wifi_info.password.c_str());
-    M5_LOGI("apikey_stt: %s", _secret_config.api_key.stt.c_str());
-    M5_LOGI("apikey_aiservice: %s", _secret_config.api_key.ai_service.c_str());
-    M5_LOGI("apikey_tts: %s", _secret_config.api_key.tts.c_str());
+    StackchanConfigSchema::print(&secret_table, &_secret_config);
 }
 void StackchanSystemConfig::loadExtendConfig(fs::FS& fs, const char* filename, uint32_t yaml_size) {  };
-void StackchanSystemConfig::setExtendSettings(DynamicJsonDocument doc) {  };
+void StackchanSystemConfig::setExtendSettings(const JsonDocument& doc) {  };
 void StackchanSystemConfig::printExtParameters(void) {};
 
 void StackchanSystemConfig::basicConfigNotFoundCallback(void) {};
@@ -1,20 +1,57 @@
 #ifndef __STACKCHAN_SYSTEM_CONFIG_H__
 #define __STACKCHAN_SYSTEM_CONFIG_H__
 
+#include "Stackchan_platform.h"
 #include <ArduinoJson.h>
-#include <M5Unified.h>
 #include <YAMLDuino.h>
+#ifdef ARDUINO
 #include <FS.h>
+#endif
 #include "Stackchan_servo.h"
+#include "Stackchan_idle_motion.h"       // servo_interval_s, AvatarMode
+#include "Stackchan_servo_calibration.h"
+#include "Stackchan_power_governor.h"
+#include "Stackchan_config_cache.h"
+#include "Stackchan_config_schema.h"
+#include "Stackchan_config_arena.h"
+#include "Stackchan_config_allocator.h"
+
+#ifndef SERVO_CALIBRATION_YAML
+#define SERVO_CALIBRATION_YAML "/yaml/SC_Calibration.yaml"   // キャリブレーションの結果(SC_BasicConfig.yamlのservoを上書き)
+#endif
+#ifndef SYSTEM_CONFIG_CACHE_FILE
+#define SYSTEM_CONFIG_CACHE_FILE "/SC_ConfigCache.bin"      // 解析した設定のキャッシュ(setConfigCacheで指定したファイルシステムに保存)
+#endif
+#define SYSTEM_CONFIG_CACHE_VERSION 3                        // キャッシュに書き込む項目を変えた場合は上げてください
+
+#ifndef CONFIG_CHANGE_CALLBACK_MAX
+#define CONFIG_CHANGE_CALLBACK_MAX 8                         // 登録できる変更のコールバックの数
+#endif
+
+// reloadConfigで変わった項目(ビットの組み合わせ)
+enum ConfigChange {
+    CONFIG_CHANGE_SERVO          = 0x0001,                   // offset, 可動範囲, 初期位置, 最大速度・加速度
+    CONFIG_CHANGE_SERVO_HARDWARE = 0x0002,                   // ピン, ID, サーボの種類, 軸の数(反映には再起動が必要)
+    CONFIG_CHANGE_INTERVAL       = 0x0004,                   // モードごとの間隔(servo.speed)
+    CONFIG_CHANGE_LYRICS         = 0x0008,
+    CONFIG_CHANGE_LED            = 0x0010,                   // led_lr, led_pin
+    CONFIG_CHANGE_POWER          = 0x0020,
+    CONFIG_CHANGE_BLUETOOTH      = 0x0040,
+    CONFIG_CHANGE_SECRET         = 0x0080,
+    CONFIG_CHANGE_OTHER          = 0x0100,                   // フォント, auto_power_off_time, takao_baseなど
+    CONFIG_CHANGE_EXTEND         = 0x0200,                   // 拡張設定(hashExtendConfigを実装した場合)
+    CONFIG_CHANGE_ALL            = 0x03ff
+};
+#define CONFIG_CHANGE_NUM 10
+
+class StackchanSystemConfig;
+typedef void (*config_change_callback_t)(StackchanSystemConfig *config, uint16_t changes, void *user_data);
 
-typedef struct ServoInterval {
-    // 下記のminとmaxの間でランダムの値を取ります。
-    const char *mode_name;
-    uint32_t interval_min; // サーボが停止する間隔（最小）
-    uint32_t interval_max; // サーボが停止する間隔（最大）
-    uint32_t move_min;     // サーボが移動する時間（最小）
-    uint32_t move_max;     // サーボが移動する時間（最大）
-} servo_interval_s;
+typedef struct ConfigChangeCallback {
+    config_change_callback_t callback;
+    uint16_t mask;                                           // 呼び出す変更(ConfigChangeの組み合わせ)
+    void *user_data;
+} config_change_callback_s;
 
 typedef struct Bluetooth {
     String device_name;
@@ -39,68 +76,157 @@ typedef struct SecretItems {
     api_keys_s api_key;
 } secret_config_s;
 
+// SC_BasicConfig.yamlのサーボ以外の項目
+typedef struct BasicItems {
+    uint32_t auto_power_off_time;                        // USB給電が停止後、電源OFF
+    String font_language_code;                           // フォントコード()
+    uint8_t led_lr;                                      // LEDを光らせる音源を指定（0:stereo, 1:left_only, 2:right_only)
+    int32_t led_pin;
+    bool takao_base;                                     // Takao_Baseを使い後ろから給電する場合にtrue
+    String servo_type_str;
+    bool secret_config_show;                             // 個人情報をログに出すかどうか
+} basic_config_s;
+
 typedef struct ServoInitialParam {
         uint8_t pin;
         int16_t offset;
         int16_t upper_limit;
         int16_t lower_limit;
         int16_t start_degree;
+        float max_velocity;          // 最大速度(deg/sec) 0の場合は制限なし
+        float max_acceleration;      // 最大加速度(deg/sec^2) 0の場合は制限なし
+        uint8_t id;                  // シリアルサーボのID(0の場合は軸の番号+1)
+        uint8_t servo_type;          // 追加の軸のサーボの種類(ServoType)
 } servo_initial_param_s;
 
-enum AvatarMode {
-    NORMAL,
-    SINGING
-};
+// 読み込み直す前のモードごとの間隔とセリフ(内容が変わらなかった場合に戻します)
+typedef struct ConfigCollections {
+    StackchanConfigArena arena;
+    servo_interval_s *servo_interval;
+    uint8_t mode_num;
+    const char **lyrics;
+    uint16_t lyrics_num;
+    String *lyric_strings;
+} config_collections_s;
 
 class StackchanSystemConfig {
     protected:
-        servo_initial_param_s _servo[2];
-        servo_interval_s _servo_interval[2];
+        servo_initial_param_s _servo[SERVO_AXIS_MAX];         // X, Yと追加の軸(servo.extra_axes)
+        uint8_t _servo_axis_num;                             // 使用する軸の数
+        StackchanConfigArena _arena;                         // 文字列とリスト(モードごとの間隔, セリフ)を置く領域
+        servo_interval_s *_servo_interval;                   // モードごとの間隔(少なくともAVATAR_MODE_NUM個)
+        servo_interval_s _fallback_interval[AVATAR_MODE_NUM]; // 領域を確保できない場合の間隔
         uint8_t _mode_num;
         bluetooth_s _bluetooth;
-        uint32_t _auto_power_off_time;                       // USB給電が停止後、電源OFF
-        String _font_language_code;                          // フォントコード()
-        String _lyrics[10];                                  // 吹き出しに表示するセリフ
-        uint8_t _lyrics_num;                                 // 吹き出しに表示するセリフの数
-        uint8_t _led_lr;                                     // LEDを光らせる音源を指定（0:stereo, 1:left_only, 2:right_only)
-        int _led_pin;
-        bool _takao_base;                                    // Takao_Baseを使い後ろから給電する場合にtrue
-        String _servo_type_str;
+        basic_config_s _basic_config;
+        const char **_lyrics;                                // 吹き出しに表示するセリフ
+        String *_lyric_strings;                              // getLyric(uint8_t)が返すセリフ(初めて呼ばれたときに作ります)
+        uint16_t _lyrics_num;                                // 吹き出しに表示するセリフの数
+        power_governor_config_s _power;                      // 給電状態ごとのサーボの制限
         uint8_t _servo_type;                                 // サーボの種類 (0: PWMサーボ, 1: Feetech SCS0009)
         secret_config_s _secret_config;                      // 個人情報の構造体
-        bool _secret_config_show;                            // 個人情報をログに出すかどうか
+        StackchanConfigAllocator _config_allocator;          // _config_docが確保した量を数えます
+        JsonDocument _config_doc;                            // 設定ファイルを読み込むドキュメント(全てのファイルで共有し、読み込むたびにclear)
+        bool _config_read_error;                             // 読み込んだファイルに解析できないものがあった
+        fs::FS* _cache_fs;                                   // キャッシュを保存するファイルシステム(nullptrの場合は使用しない)
+        const char* _cache_filename;
+        bool _cache_loaded;                                  // 直前のloadConfigでキャッシュから読み込んだ
+        fs::FS* _load_fs;                                    // loadConfigで読み込んだファイル(reloadConfigで使用)
+        String _app_yaml_filename;
+        String _secret_yaml_filename;
+        String _basic_yaml_filename;
+        uint32_t _app_yaml_filesize;
+        uint32_t _secret_yaml_filesize;
+        uint32_t _basic_yaml_filesize;
+        config_change_callback_s _change_callback[CONFIG_CHANGE_CALLBACK_MAX];
+        uint8_t _change_callback_num;
+        // 項目(ConfigChangeの各ビット)ごとの値のハッシュ
+        void hashConfig(uint32_t *hash);
+        // 読み込み直す前に間隔とセリフの領域を預け、変わらなかった場合は戻して取得済みのポインタを有効なままにします。
+        void holdCollections(config_collections_s *previous);
+        void restoreCollections(config_collections_s *previous);
+        uint16_t notifyChanges(const uint32_t *hash_before, config_collections_s *previous);
+        bool readConfigCache(const config_cache_source_s *source, uint8_t source_num);
+        bool writeConfigCache(const config_cache_source_s *source, uint8_t source_num);
         void setDefaultParameters();
-        void setSystemConfig(DynamicJsonDocument doc);
+        // モードごとの間隔とセリフの領域を確保し、間隔を初期値にします。string_sizeは全ての文字列の合計(StackchanConfigArena::stringSize)
+        bool allocateCollections(uint8_t mode_num, uint16_t lyrics_num, size_t string_size);
+        void setSystemConfig(const JsonDocument& doc);
+
+        // 設定ファイルを共有のドキュメントに読み込みます。次に読み込むまで有効です。
+        // ファイルが開けない場合と、メモリが足りずに全ては読み込めなかった場合(NoMemory)はnullptr
+        const JsonDocument* readConfigFile(fs::FS& fs, const char* yaml_filename, DeserializationError* error = nullptr);
+        void releaseConfigDocument();
+
+        void loadServoCalibration(fs::FS& fs, const char* yaml_filename);
+        void setServoCalibration(const JsonDocument& doc);
 
-        void loadSecretConfig(fs::FS& fs, const char* yaml_filename, uint32_t yaml_size);
-        void setSecretConfig(DynamicJsonDocument doc);
+        void loadSecretConfig(fs::FS& fs, const char* yaml_filename);
+        void setSecretConfig(const JsonDocument& doc);
         void printSecretParameters(void);
     public:
         StackchanSystemConfig();
         ~StackchanSystemConfig();
-        void loadConfig(fs::FS& fs, const char *app_yaml_filename, uint32_t app_yaml_filesize=2048,
-                        const char* secret_yaml_filename = "/yaml/SC_SecConfig.yaml", uint32_t secret_yaml_filesize=2048,
-                        const char* basic_yaml_filename = "/yaml/SC_BasicConfig.yaml", uint32_t basic_yaml_filesize=2048);
+        // ドキュメントは必要なだけ広がるので、*_filesizeは領域の大きさには使いません。(app, secretは0の場合は読み込みません)
+        void loadConfig(fs::FS& fs, const char *app_yaml_filename, uint32_t app_yaml_filesize = 2048,
+                        const char* secret_yaml_filename = "/yaml/SC_SecConfig.yaml", uint32_t secret_yaml_filesize = 2048,
+                        const char* basic_yaml_filename = "/yaml/SC_BasicConfig.yaml", uint32_t basic_yaml_filesize = 2048);
+
+        // loadConfigと同じファイルを読み込み直し、変わった項目(ConfigChange)を返します。
+        // 変わった項目があれば、addChangeCallbackで登録したコールバックを呼び出します。
+        uint16_t reloadConfig();
+        // シリアルなどから受け取ったSC_BasicConfig.yamlの内容で読み込み直します。(キャリブレーションの結果は再度上書きします)
+        // 解析できなかった場合と、メモリが足りなかった場合は何も変更せずに0を返します。
+        uint16_t reloadConfig(Stream& stream);
+        // maskの項目が変わった場合に呼び出すコールバックを登録します。
+        bool addChangeCallback(config_change_callback_t callback, uint16_t mask = CONFIG_CHANGE_ALL,
+                               void *user_data = nullptr);
+        // offset, 可動範囲, 最大速度・加速度をStackchanSERVOに反映します。(ピンやサーボの種類は再起動が必要です)
+        void applyServoParam(StackchanSERVO *servo);
 
         void printAllParameters();
+        // loadConfigで解析した設定をバイナリでcache_fs(SPIFFSなど)に保存し、次回からYAMLを解析せずに読み込みます。
+        // SC_BasicConfig.yaml, SC_Calibration.yamlのサイズと更新日時が変わった場合は解析し直します。
+        // 個人情報(SC_SecConfig.yaml)と拡張設定(loadExtendConfig)はキャッシュせずに毎回読み込みます。
+        void setConfigCache(fs::FS& cache_fs, const char* cache_filename = SYSTEM_CONFIG_CACHE_FILE);
+        void clearConfigCache();
+        // 直前のloadConfigでキャッシュから読み込んだ(YAMLを解析しなかった)場合にtrue
+        bool isConfigCacheLoaded() { return _cache_loaded; }
+        // 直前のloadConfigで設定ファイルの読み込みに使ったメモリの最大値(byte, StackchanConfigAllocatorで測った値)
+        size_t getConfigMemoryPeak() { return _config_allocator.getPeak(); }
 
         servo_initial_param_s* getServoInfo(uint8_t servo_axis_no) { return &_servo[servo_axis_no]; }
+        uint8_t getServoAxisNum() { return _servo_axis_num; }
+        // StackchanSERVO::beginに渡す全軸の初期パラメータを作成します。
+        void getServoInitialParam(stackchan_servo_initial_param_s *init_param);
+        // キャリブレーションの結果(offset, 可動範囲)を設定に反映し、ファイルに保存します。
+        // 保存した値は次回からloadConfigでSC_BasicConfig.yamlの値を上書きします。
+        bool saveServoCalibration(fs::FS& fs, StackchanServoCalibration *calibration,
+                                  const char* yaml_filename = SERVO_CALIBRATION_YAML);
         servo_interval_s* getServoInterval(AvatarMode avatar_mode) { return &_servo_interval[avatar_mode]; }
+        // servo.speedの全てのモード(先頭のAVATAR_MODE_NUM個がAvatarModeに対応します)
+        StackchanConfigSpan<servo_interval_s> getServoIntervals() { return { _servo_interval, _mode_num }; }
         bluetooth_s* getBluetoothSetting() { return &_bluetooth; }
         wifi_s* getWiFiSetting() { return &_secret_config.wifi_info; }
         api_keys_s* getAPISetting() { return &_secret_config.api_key; }
         secret_config_s* getSecretSetting() { return &_secret_config; }
-        String* getLyric(uint8_t no) { return &_lyrics[no]; }
-        uint8_t getLyrics_num() { return _lyrics_num; }
-        uint32_t getAutoPowerOffTime() { return _auto_power_off_time; }
+        // 以前のバージョンと同じString*を返します。(範囲外の場合は空の文字列)
+        String* getLyric(uint8_t no);
+        const char* getLyricCStr(uint16_t no) { return (no < _lyrics_num) ? _lyrics[no] : ""; }
+        uint16_t getLyrics_num() { return _lyrics_num; }
+        StackchanConfigSpan<const char*> getLyrics() { return { _lyrics, _lyrics_num }; }
+        uint32_t getAutoPowerOffTime() { return _basic_config.auto_power_off_time; }
         const lgfx::IFont* getFont();
-        uint8_t getLedLR() { return _led_lr; }
-        int getLedPin() { return _led_pin; }
-        bool getUseTakaoBase() { return _takao_base; }
+        uint8_t getLedLR() { return _basic_config.led_lr; }
+        int getLedPin() { return _basic_config.led_pin; }
+        bool getUseTakaoBase() { return _basic_config.takao_base; }
+        const power_governor_config_s* getPowerGovernorConfig() { return &_power; }
         uint8_t getServoType() { return _servo_type; }
         virtual void loadExtendConfig(fs::FS& fs, const char* yaml_filename, uint32_t yaml_size);
-        virtual void setExtendSettings(DynamicJsonDocument doc);
+        virtual void setExtendSettings(const JsonDocument& doc);
         virtual void printExtParameters(void);
+        // 拡張設定の値のハッシュ(StackchanConfigCache::checksum)を返すと、reloadConfigでCONFIG_CHANGE_EXTENDを判定します。
+        virtual uint32_t hashExtendConfig(void) { return 0; }
 
         virtual void basicConfigNotFoundCallback(void);
         virtual void secretConfigNotFoundCallback(void);
@@ -0,0 +1,104 @@
+#include "MotionController.h"
+
+MotionController::MotionController() {
+    servos[MOTION_AXIS_X] = nullptr;
+    servos[MOTION_AXIS_Y] = nullptr;
+    memset(axes, 0, sizeof(axes));
+    min_angle = 0;
+    max_angle = 180;
+}
+
+void MotionController::begin(Servo* servo_x, Servo* servo_y, int home_x, int home_y, int min_angle, int max_angle) {
+    servos[MOTION_AXIS_X] = servo_x;
+    servos[MOTION_AXIS_Y] = servo_y;
+    this->min_angle = min_angle;
+    this->max_angle = max_angle;
+    axes[MOTION_AXIS_X].angle = axes[MOTION_AXIS_X].target_angle = home_x;
+    axes[MOTION_AXIS_Y].angle = axes[MOTION_AXIS_Y].target_angle = home_y;
+    servos[MOTION_AXIS_X]->write(home_x);
+    servos[MOTION_AXIS_Y]->write(home_y);
+}
+
+void MotionController::moveTo(uint8_t axis, int target, unsigned long duration, uint8_t ease) {
+    if (target < min_angle) target = min_angle;
+    if (target > max_angle) target = max_angle;
+
+    unsigned long now = millis();
+    updateAxis(axis, now);  // 現在の補間位置・速度を求めてから引き継ぐ
+
+    axis_timeline_s* t = &axes[axis];
+    t->start_angle = t->angle;
+    t->start_velocity = t->is_moving ? t->velocity : 0.0f;
+    t->target_angle = target;
+    t->start_time = now;
+    t->duration = duration;
+    t->ease = ease;
+    t->is_moving = true;
+
+    Serial.printf("Starting %c movement: %d -> %d degrees in %lu ms\n",
+                  (axis == MOTION_AXIS_X) ? 'X' : 'Y', (int)t->start_angle, target, duration);
+    if (duration == 0) {
+        updateAxis(axis, now);
+    }
+}
+
+// 開始位置から目標へのイージング（Q15のテーブル）に、開始時の速度を0へ減衰させる項（エルミート基底 s^3 - 2s^2 + s）を加えます。
+// 移動中に再指示しても位置と速度が連続するので、途中で急に止まったり跳んだりしません。
+void MotionController::updateAxis(uint8_t axis, unsigned long now) {
+    axis_timeline_s* t = &axes[axis];
+    if (!t->is_moving) {
+        return;
+    }
+    unsigned long elapsed = now - t->start_time;
+    if (elapsed >= t->duration) {
+        // Movement complete
+        t->angle = t->target_angle;
+        t->velocity = 0.0f;
+        t->is_moving = false;
+        servos[axis]->write((int)t->target_angle);
+        Serial.printf("%c movement complete at %d degrees\n", (axis == MOTION_AXIS_X) ? 'X' : 'Y', (int)t->target_angle);
+        return;
+    }
+
+    int32_t p = servoEaseProgressQ15(elapsed, t->duration);
+    float s = (float)p / SERVO_EASE_Q15_ONE;
+    float span = t->start_velocity * (float)t->duration;
+    float delta = t->target_angle - t->start_angle;
+    float angle = t->start_angle + delta * servoEaseQ15(t->ease, p) / SERVO_EASE_Q15_ONE
+                + span * (s * s * s - 2 * s * s + s);
+    t->velocity = (delta * servoEaseSlopeQ15(t->ease, p) / SERVO_EASE_Q15_ONE) / (float)t->duration
+                + t->start_velocity * (3 * s * s - 4 * s + 1);
+
+    if (angle < min_angle) angle = min_angle;
+    if (angle > max_angle) angle = max_angle;
+    t->angle = angle;
+    servos[axis]->write((int)(angle + 0.5f));
+}
+
+void MotionController::startStep() {
+    const motion_step_s* step = &steps[step_index];
+    step_index++;
+    moveTo(step->axis, step->target, step->duration, step->ease);
+}
+
+void MotionController::play(const motion_step_s* motion_steps, int count) {
+    if (count > MOTION_STEP_MAX) count = MOTION_STEP_MAX;
+    memcpy(steps, motion_steps, sizeof(motion_step_s) * count);
+    step_count = count;
+    step_index = 0;
+    if (step_count > 0) {
+        startStep();
+    }
+}
+
+bool MotionController::update() {
+    unsigned long now = millis();
+    updateAxis(MOTION_AXIS_X, now);
+    updateAxis(MOTION_AXIS_Y, now);
+
+    // 前のステップの軸が止まったら次のステップへ
+    while ((step_index < step_count) && !axes[steps[step_index - 1].axis].is_moving) {
+        startStep();
+    }
+    return isMoving();
+}
@@ -0,0 +1,69 @@
+#ifndef MOTION_CONTROLLER_H
+#define MOTION_CONTROLLER_H
+
+#include <Arduino.h>
+#include <ESP32Servo.h>
+#include <Stackchan_easing.h>
+
+#define MOTION_AXIS_X 0
+#define MOTION_AXIS_Y 1
+#define MOTION_STEP_MAX 16
+
+// 1軸分のタイムライン（軸ごとに開始時刻・移動時間を持つ）
+typedef struct AxisTimeline {
+    float start_angle;         // 開始角度
+    float target_angle;        // 目標角度
+    float start_velocity;      // 開始時の速度（deg/ms）
+    float angle;               // 現在の補間角度
+    float velocity;            // 現在の速度（deg/ms）
+    unsigned long start_time;  // 開始時刻
+    unsigned long duration;    // 移動時間
+    uint8_t ease;              // ServoEase
+    bool is_moving;
+} axis_timeline_s;
+
+// ジェスチャーの1ステップ（前のステップの軸が止まったら次へ進む）
+typedef struct MotionStep {
+    uint8_t axis;              // MOTION_AXIS_X / MOTION_AXIS_Y
+    int target;                // 目標角度
+    unsigned long duration;    // 移動時間
+    uint8_t ease;              // ServoEase
+} motion_step_s;
+
+class MotionController {
+private:
+    Servo* servos[2];
+    axis_timeline_s axes[2];
+    int min_angle, max_angle;
+
+    // 再生中のジェスチャー
+    motion_step_s steps[MOTION_STEP_MAX];
+    int step_count = 0;
+    int step_index = 0;
+
+    void updateAxis(uint8_t axis, unsigned long now);
+    void startStep();
+
+public:
+    MotionController();
+
+    // 初期化（ホームポジションへ移動）
+    void begin(Servo* servo_x, Servo* servo_y, int home_x, int home_y, int min_angle = 0, int max_angle = 180);
+
+    // 移動開始。移動中でも現在の補間位置・速度から滑らかにつないで新しい目標へ向かう
+    void moveTo(uint8_t axis, int target, unsigned long duration, uint8_t ease = SERVO_EASE_CUBIC);
+
+    // ジェスチャーを開始（再生中のジェスチャーは中断して現在位置から引き継ぐ）
+    void play(const motion_step_s* motion_steps, int count);
+
+    // 定期的に呼び出す。移動中の軸があればtrue
+    bool update();
+
+    // 状態確認
+    bool isMoving(uint8_t axis) { return axes[axis].is_moving; }
+    bool isMoving() { return axes[MOTION_AXIS_X].is_moving || axes[MOTION_AXIS_Y].is_moving; }
+    bool isPlaying() { return (step_index < step_count) || isMoving(); }
+    int getAngle(uint8_t axis) { return (int)(axes[axis].angle + 0.5f); }
+};
+
+#endif // MOTION_CONTROLLER_H
@@ -3,15 +3,6 @@
 SG90Handler::SG90Handler() : is_moving(false), last_x(90), last_y(90) {
 }
 
-// 参考ファイルのイージング関数を実装
-float SG90Handler::quadraticEaseInOut(float p) {
-    if(p < 0.5) {
-        return 2 * p * p;
-    } else {
-        return (-2 * p * p) + (4 * p) - 1;
-    }
-}
-
 void SG90Handler::begin(int pin_x, int pin_y, int home_x, int home_y) {
     this->pin_x = pin_x;
     this->pin_y = pin_y;
@@ -70,9 +61,9 @@ void SG90Handler::moveX(int angle, uint32_t duration) {
                       last_x, angle, increase_degree, SERIAL_EASE_DIVISION, division_time);
         
         for (int i = 0; i <= SERIAL_EASE_DIVISION; i++) {
-            float f = (float)i / (float)SERIAL_EASE_DIVISION;
-            int target_angle = last_x + increase_degree * quadraticEaseInOut(f);
-            Serial.printf("Step %d: f=%.2f, target_angle=%d\n", i, f, target_angle);
+            int32_t e = servoEaseQ15(SERVO_EASE_QUAD, i * SERVO_EASE_Q15_ONE / SERIAL_EASE_DIVISION);
+            int target_angle = servoEaseLerp(last_x, last_x + increase_degree, e);
+            Serial.printf("Step %d: target_angle=%d\n", i, target_angle);
             servo_x.write(target_angle);
             delay(division_time);
         }
@@ -105,9 +96,9 @@ void SG90Handler::moveY(int angle, uint32_t duration) {
                       last_y, angle, increase_degree, SERIAL_EASE_DIVISION, division_time);
         
         for (int i = 0; i <= SERIAL_EASE_DIVISION; i++) {
-            float f = (float)i / (float)SERIAL_EASE_DIVISION;
-            int target_angle = last_y + increase_degree * quadraticEaseInOut(f);
-            Serial.printf("Step %d: f=%.2f, target_angle=%d\n", i, f, target_angle);
+            int32_t e = servoEaseQ15(SERVO_EASE_QUAD, i * SERVO_EASE_Q15_ONE / SERIAL_EASE_DIVISION);
+            int target_angle = servoEaseLerp(last_y, last_y + increase_degree, e);
+            Serial.printf("Step %d: target_angle=%d\n", i, target_angle);
             servo_y.write(target_angle);
             delay(division_time);
         }
@@ -145,10 +136,10 @@ void SG90Handler::moveXY(int x, int y, uint32_t duration) {
                       last_x, last_y, x, y, increase_x, increase_y);
         
         for (int i = 0; i <= SERIAL_EASE_DIVISION; i++) {
-            float f = (float)i / (float)SERIAL_EASE_DIVISION;
-            int target_x = last_x + increase_x * quadraticEaseInOut(f);
-            int target_y = last_y + increase_y * quadraticEaseInOut(f);
-            Serial.printf("XY Step %d: f=%.2f, target=(%d,%d)\n", i, f, target_x, target_y);
+            int32_t e = servoEaseQ15(SERVO_EASE_QUAD, i * SERVO_EASE_Q15_ONE / SERIAL_EASE_DIVISION);
+            int target_x = servoEaseLerp(last_x, last_x + increase_x, e);
+            int target_y = servoEaseLerp(last_y, last_y + increase_y, e);
+            Serial.printf("XY Step %d: target=(%d,%d)\n", i, target_x, target_y);
             servo_x.write(target_x);
             servo_y.write(target_y);
             delay(division_time);
@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include <ESP32Servo.h>
+#include <Stackchan_easing.h>
 
 class SG90Handler {
 private:
@@ -13,9 +14,6 @@ private:
     bool is_moving;
     int last_x, last_y;   // 前回の位置を記録
     
-    // 参考ファイルのイージング関数
-    float quadraticEaseInOut(float p);
-    
 public:
     SG90Handler();
     
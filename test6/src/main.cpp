@@ -8,6 +8,7 @@
 #include "NarrowEye.h"
 #include "PoetFace.h"
 #include "PhoneticMouth.h"
+#include "MotionController.h"
 
 using namespace m5avatar;
 
@@ -43,19 +44,26 @@ Servo ServoY;  // Y軸（上下）
 #define SHAKE_RIGHT_POSITION SERVO_SHAKE_RIGHT
 #define SHAKE_LEFT_POSITION SERVO_SHAKE_LEFT
 
-// Easing parameters
-#define REFRESH_INTERVAL_MILLIS 20
+// X/Yそれぞれ独立したタイムラインで動かすモーション制御
+// 動作中に次のモーションを受けても現在の位置・速度から滑らかにつなぐ
+MotionController motionController;
 
-// Current servo positions
-int currentX = HOME_POSITION_X;
-int currentY = HOME_POSITION_Y;
+// うなずき動作（1秒で下に15度、1秒で戻る）
+const motion_step_s NOD_STEPS[] = {
+  {MOTION_AXIS_Y, NOD_DOWN_POSITION, 1000, SERVO_EASE_CUBIC},
+  {MOTION_AXIS_Y, HOME_POSITION_Y, 1000, SERVO_EASE_CUBIC},
+};
 
-// Movement state
-bool isMovingX = false;
-bool isMovingY = false;
-unsigned long moveStartTime = 0;
-int startAngleX, targetAngleX, startAngleY, targetAngleY;
-unsigned long moveDuration = 0;
+// 首振り動作（0.5秒で右20度、1秒で左20度、0.5秒でセンター）
+const motion_step_s HEAD_SHAKE_STEPS[] = {
+  {MOTION_AXIS_X, SHAKE_RIGHT_POSITION, 500, SERVO_EASE_CUBIC},
+  {MOTION_AXIS_X, SHAKE_LEFT_POSITION, 1000, SERVO_EASE_CUBIC},
+  {MOTION_AXIS_X, HOME_POSITION_X, 500, SERVO_EASE_CUBIC},
+};
+
+// モーション名の吹き出しをモーション終了の1秒後に消去するための状態
+bool isMotionBalloonShown = false;
+unsigned long motionBalloonTime = 0;
 
 Avatar avatar;
 TextAnimator textAnimator(&avatar);
@@ -124,139 +132,31 @@ String lastProcessedMessage = "";  // 最後に処理したメッセージ
 unsigned long lastProcessedTime = 0;  // 最後に処理した時刻
 const unsigned long MESSAGE_COOLDOWN = 3000;  // 3秒間のクールダウン
 
-// Cubic easing function (based on ServoEasing library)
-float easeCubicInOut(float t) {
-  if (t < 0.5) {
-    return 4 * t * t * t;
-  } else {
-    float f = ((2 * t) - 2);
-    return 1 + f * f * f / 2;
-  }
-}
-
-// Start easing movement for X servo
+// Start easing movement for X servo（移動中でも現在の位置・速度から引き継ぐ）
 void startEaseToX(int targetAngle, unsigned long duration) {
-  if (targetAngle < 0) targetAngle = 0;
-  if (targetAngle > 180) targetAngle = 180;
-  
-  startAngleX = currentX;
-  targetAngleX = targetAngle;
-  moveDuration = duration;
-  moveStartTime = millis();
-  isMovingX = true;
-  
-  Serial.printf("Starting X movement: %d -> %d degrees in %lu ms\n", 
-                startAngleX, targetAngleX, duration);
+  motionController.moveTo(MOTION_AXIS_X, targetAngle, duration);
 }
 
-// Start easing movement for Y servo
+// Start easing movement for Y servo（移動中でも現在の位置・速度から引き継ぐ）
 void startEaseToY(int targetAngle, unsigned long duration) {
-  if (targetAngle < 0) targetAngle = 0;
-  if (targetAngle > 180) targetAngle = 180;
-  
-  startAngleY = currentY;
-  targetAngleY = targetAngle;
-  moveDuration = duration;
-  moveStartTime = millis();
-  isMovingY = true;
-  
-  Serial.printf("Starting Y movement: %d -> %d degrees in %lu ms\n", 
-                startAngleY, targetAngleY, duration);
+  motionController.moveTo(MOTION_AXIS_Y, targetAngle, duration);
 }
 
 // Update servo positions (call this regularly in loop)
 bool updateServos() {
-  bool anyMoving = false;
-  unsigned long currentTime = millis();
-  unsigned long elapsed = currentTime - moveStartTime;
-  
-  if (isMovingX && elapsed < moveDuration) {
-    float progress = (float)elapsed / (float)moveDuration;
-    float easedProgress = easeCubicInOut(progress);
-    int newAngle = startAngleX + (targetAngleX - startAngleX) * easedProgress;
-    
-    ServoX.write(newAngle);
-    currentX = newAngle;
-    anyMoving = true;
-  } else if (isMovingX) {
-    // Movement complete
-    ServoX.write(targetAngleX);
-    currentX = targetAngleX;
-    isMovingX = false;
-    Serial.printf("X movement complete at %d degrees\n", targetAngleX);
-  }
-  
-  if (isMovingY && elapsed < moveDuration) {
-    float progress = (float)elapsed / (float)moveDuration;
-    float easedProgress = easeCubicInOut(progress);
-    int newAngle = startAngleY + (targetAngleY - startAngleY) * easedProgress;
-    
-    ServoY.write(newAngle);
-    currentY = newAngle;
-    anyMoving = true;
-  } else if (isMovingY) {
-    // Movement complete
-    ServoY.write(targetAngleY);
-    currentY = targetAngleY;
-    isMovingY = false;
-    Serial.printf("Y movement complete at %d degrees\n", targetAngleY);
-  }
-  
-  return anyMoving;
+  return motionController.update();
 }
 
-// うなずき動作（1秒で下に15度、1秒で戻る）
+// うなずき動作（再生中のモーションは中断して引き継ぐ）
 void performNod() {
   Serial.println("=== Starting Nod Movement ===");
-  
-  // Step 1: 下に15度（1秒）
-  Serial.println("Nodding down 15 degrees");
-  startEaseToY(NOD_DOWN_POSITION, 1000); // 1秒でイージング
-  while (isMovingY) {
-    updateServos();
-    delay(REFRESH_INTERVAL_MILLIS);
-  }
-  
-  // Step 2: 元の位置に戻る（1秒）
-  Serial.println("Nodding back to center");
-  startEaseToY(HOME_POSITION_Y, 1000); // 1秒でイージング
-  while (isMovingY) {
-    updateServos();
-    delay(REFRESH_INTERVAL_MILLIS);
-  }
-  
-  Serial.println("=== Nod Movement Complete ===");
+  motionController.play(NOD_STEPS, sizeof(NOD_STEPS) / sizeof(NOD_STEPS[0]));
 }
 
-// 首振り動作（0.5秒で右20度、1秒で左20度、0.5秒でセンター）
+// 首振り動作（再生中のモーションは中断して引き継ぐ）
 void performHeadShake() {
   Serial.println("=== Starting Head Shake Movement ===");
-  
-  // Step 1: 右に20度（0.5秒）
-  Serial.println("Shaking right 20 degrees");
-  startEaseToX(SHAKE_RIGHT_POSITION, 500); // 0.5秒でイージング
-  while (isMovingX) {
-    updateServos();
-    delay(REFRESH_INTERVAL_MILLIS);
-  }
-  
-  // Step 2: 左に20度（1秒）
-  Serial.println("Shaking left 20 degrees");
-  startEaseToX(SHAKE_LEFT_POSITION, 1000); // 1秒でイージング
-  while (isMovingX) {
-    updateServos();
-    delay(REFRESH_INTERVAL_MILLIS);
-  }
-  
-  // Step 3: センターに戻る（0.5秒）
-  Serial.println("Shaking back to center");
-  startEaseToX(HOME_POSITION_X, 500); // 0.5秒でイージング
-  while (isMovingX) {
-    updateServos();
-    delay(REFRESH_INTERVAL_MILLIS);
-  }
-  
-  Serial.println("=== Head Shake Movement Complete ===");
+  motionController.play(HEAD_SHAKE_STEPS, sizeof(HEAD_SHAKE_STEPS) / sizeof(HEAD_SHAKE_STEPS[0]));
 }
 
 // 表情を名前で設定する関数
@@ -329,19 +229,16 @@ void setExpressionByName(const String& expressionName) {
 void performMotionByName(const String& motionName) {
   Serial.println("Performing motion: " + motionName);
   
-  if (!isMovingX && !isMovingY) {
-    if (motionName == "nod" || motionName == "うなずき") {
-      performNod();
-    } else if (motionName == "shake" || motionName == "首振り") {
-      performHeadShake();
-    } else {
-      Serial.println("Unknown motion: " + motionName);
-      return;
-    }
-    Serial.println("Motion completed: " + motionName);
+  // 動作中でも待たずに現在の姿勢から新しいモーションへ切り替える
+  if (motionName == "nod" || motionName == "うなずき") {
+    performNod();
+  } else if (motionName == "shake" || motionName == "首振り") {
+    performHeadShake();
   } else {
-    Serial.println("Servo is moving, motion skipped: " + motionName);
+    Serial.println("Unknown motion: " + motionName);
+    return;
   }
+  Serial.println("Motion started: " + motionName);
 }
 
 // 単一JSONメッセージを処理する関数
@@ -563,8 +460,7 @@ void setup() {
   }
   
   // Move to home position
-  ServoX.write(HOME_POSITION_X);
-  ServoY.write(HOME_POSITION_Y);
+  motionController.begin(&ServoX, &ServoY, HOME_POSITION_X, HOME_POSITION_Y);
   
   // Avatar initialization
   avatar.init();
@@ -615,6 +511,18 @@ void loop() {
   
   // サーボ位置を常に更新
   updateServos();
+
+  // モーション終了の1秒後に吹き出しを消去
+  if (isMotionBalloonShown) {
+    if (motionController.isPlaying()) {
+      motionBalloonTime = millis();
+    } else if (textAnimator.isAnimating()) {
+      isMotionBalloonShown = false;
+    } else if (millis() - motionBalloonTime >= 1000) {
+      avatar.setSpeechText("");
+      isMotionBalloonShown = false;
+    }
+  }
   
   // TextAnimatorの更新処理（常に呼び出す）
   textAnimator.update();
@@ -1014,28 +922,25 @@ void loop() {
   }
   
   // Bボタンが押されたらうなずき・首振りを交互に実行
+  // 動作中に押された場合も現在の姿勢から次の動作へつなぐ
   if (M5.BtnB.wasPressed()) {
-    if (!isMovingX && !isMovingY) {
-      if (isNodTurn) {
-        // うなずき動作
-        Serial.println("Button B pressed - Performing Nod");
-        avatar.setSpeechText("うなずき");
-        performNod();
-        isNodTurn = false;  // 次は首振り
-      } else {
-        // 首振り動作
-        Serial.println("Button B pressed - Performing Head Shake");
-        avatar.setSpeechText("首振り");
-        performHeadShake();
-        isNodTurn = true;   // 次はうなずき
-      }
-      
-      // 動作完了後、吹き出しを消去
-      delay(1000);
-      avatar.setSpeechText("");
+    if (isNodTurn) {
+      // うなずき動作
+      Serial.println("Button B pressed - Performing Nod");
+      avatar.setSpeechText("うなずき");
+      performNod();
+      isNodTurn = false;  // 次は首振り
     } else {
-      Serial.println("Servo is moving, please wait");
+      // 首振り動作
+      Serial.println("Button B pressed - Performing Head Shake");
+      avatar.setSpeechText("首振り");
+      performHeadShake();
+      isNodTurn = true;   // 次はうなずき
     }
+
+    // 動作完了の1秒後に吹き出しを消去（loopで処理）
+    isMotionBalloonShown = true;
+    motionBalloonTime = millis();
   }
   
   // Cボタンが押されたら表情を順次変更